@@ -22,10 +22,175 @@
 
 #include "Software.h"
 
+#include "ink/core/Error.h"
+#include "ink/core/WorkerPool.h"
+#include "ink/math/Color.h"
+#include "ink/math/Constants.h"
+
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFT_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(SOFT_USE_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define SOFT_USE_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(SOFT_USE_AVX2) && (defined(__GNUC__) || defined(__clang__))
+#define SOFT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SOFT_TARGET_AVX2
+#endif
+
+#if defined(SOFT_USE_AVX2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SOFT_FORCE_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define SOFT_FORCE_INLINE __forceinline
+#else
+#define SOFT_FORCE_INLINE inline
+#endif
 
 namespace ink::soft {
 
+constexpr uint32_t FULL_MASK = 0xFFFFFFFF;
+
+constexpr int TILE_SIZE = 8;
+
+constexpr int SUBPIXEL_BITS = 4;
+
+constexpr int SUBPIXEL_SCALE = 1 << SUBPIXEL_BITS;
+
+constexpr float MAX_COORDINATE = 65536.f;
+
+constexpr int64_t SNAPPING_OFFSET = int64_t(1) << 22;
+
+constexpr double SNAPPING_BIAS = SNAPPING_OFFSET + 0.5;
+
+struct TileSetup {
+	int edges[3] = {};          /**< the edge functions at the first pixel of tile */
+	int edge_steps_x[3] = {};   /**< the increments of edge functions per column */
+	int edge_steps_y[3] = {};   /**< the increments of edge functions per row */
+	bool full = false;          /**< whether the tile is completely covered */
+	float depth = 0;            /**< the depth at the first pixel of tile */
+	float depth_step_x = 0;     /**< the increment of depth per column */
+	float depth_step_y = 0;     /**< the increment of depth per row */
+	int first_column = 0;       /**< the first column inside viewport */
+	int last_column = 0;        /**< the last column inside viewport (exclusive) */
+	int first_row = 0;          /**< the first row inside viewport */
+	int last_row = 0;           /**< the last row inside viewport (exclusive) */
+};
+
+constexpr int CULL_BATCH_SIZE = 4;
+
+constexpr float SAMPLE_MARGIN = 1.f / SUBPIXEL_SCALE;
+
+struct TriangleBatch {
+	float x[3][CULL_BATCH_SIZE] = {};           /**< the X-coordinates in clip space */
+	float y[3][CULL_BATCH_SIZE] = {};           /**< the Y-coordinates in clip space */
+	float z[3][CULL_BATCH_SIZE] = {};           /**< the Z-coordinates in clip space */
+	float w[3][CULL_BATCH_SIZE] = {};           /**< the W-coordinates in clip space */
+	float screen_x[3][CULL_BATCH_SIZE] = {};    /**< the X-coordinates in screen space if not clipped */
+	float screen_y[3][CULL_BATCH_SIZE] = {};    /**< the Y-coordinates in screen space if not clipped */
+	float screen_z[3][CULL_BATCH_SIZE] = {};    /**< the depths in screen space if not clipped */
+	int visible_mask = 0;                       /**< the triangles which may cover any sample */
+	int clip_mask = 0;                          /**< the triangles crossing the near or far plane */
+};
+
+constexpr int BIN_SIZE = 64;
+
+constexpr int PARALLEL_RENDER_THRESHOLD = 1024;
+
+template <typename Triangle>
+struct TriangleBins {
+	std::vector<std::vector<Triangle>> triangles;          /**< the triangles binned by each task */
+	std::vector<std::vector<std::vector<int>>> indices;    /**< the indices of triangles in each bin of each task */
+};
+
+constexpr float MIN_ROUGHNESS = .02f;
+
+constexpr float SHADING_EPSILON = 1e-6f;
+
+struct ShadingMaterial {
+	const Material* material = nullptr;        /**< the material */
+	const Texture* normal_map = nullptr;       /**< the texture of normal map */
+	const Texture* color_map = nullptr;        /**< the texture of color map */
+	const Texture* alpha_map = nullptr;        /**< the texture of alpha map */
+	const Texture* roughness_map = nullptr;    /**< the texture of roughness map */
+	const Texture* metalness_map = nullptr;    /**< the texture of metalness map */
+	const Texture* specular_map = nullptr;     /**< the texture of specular map */
+	const Texture* emissive_map = nullptr;     /**< the texture of emissive map */
+	const Texture* ao_map = nullptr;           /**< the texture of ambient occlusion map */
+	bool use_textures = false;                 /**< whether any texture is sampled */
+};
+
+struct ShadingVertex {
+	Vec4 position;          /**< the position in clip space */
+	Vec3 world_position;    /**< the position in world space */
+	Vec3 normal;            /**< the normal in world space */
+	Vec3 tangent;           /**< the tangent in world space */
+	Vec3 bitangent;         /**< the bitangent in world space */
+	Vec2 uv;                /**< the UV coordinate */
+	Vec3 color;             /**< the vertex color */
+};
+
+struct ShadingTriangle {
+	ShadingVertex vertices[3];                    /**< the vertices after clipping */
+	Vec3 coords[3];                               /**< the positions in screen space */
+	float inverse_w[3] = {};                      /**< the reciprocals of the clip W */
+	bool front = true;                            /**< whether the triangle is front facing */
+	bool use_tangent = false;                     /**< whether the vertices have tangents */
+	const Mat3* normal_matrix = nullptr;          /**< the normal matrix of the instance */
+	const ShadingMaterial* material = nullptr;    /**< the material and its textures */
+};
+
+struct ShadingLights {
+	struct Point {
+		Vec3 position;
+		Vec3 color;
+		float distance = 0;
+		float decay = 0;
+	};
+	
+	struct Spot {
+		Vec3 position;
+		Vec3 direction;
+		Vec3 color;
+		float distance = 0;
+		float decay = 0;
+		float angle = 0;
+		float penumbra = 0;
+	};
+	
+	struct Directional {
+		Vec3 direction;
+		Vec3 color;
+	};
+	
+	struct Hemisphere {
+		Vec3 direction;
+		Vec3 sky_color;
+		Vec3 ground_color;
+	};
+	
+	Vec3 camera_position;                            /**< the position of camera */
+	std::vector<Point> point_lights;                 /**< the visible point lights */
+	std::vector<Spot> spot_lights;                   /**< the visible spot lights */
+	std::vector<Directional> directional_lights;     /**< the visible directional lights */
+	std::vector<Hemisphere> hemisphere_lights;       /**< the visible hemisphere lights */
+};
+
+using TriangleRasterizer = void (*)(const State& s, const Vec3& v1, const Vec3& v2, const Vec3& v3, Image& b);
+
 void clear(Image& b, float d) {
 	float* buffer = reinterpret_cast<float*>(b.data.data());
 	std::fill_n(buffer, b.width * b.height, d);
@@ -61,104 +226,1700 @@ void clip_near_plane(const PointList& i, PointList& o) {
 	}
 }
 
-void rasterize(const State& s, const Vec3* v, int n, Image& b) {
+void clip_far_plane(const PointList& i, PointList& o) {
+	for (int l = 0; l < i.size; ++l) {
+		auto& vertex_1 = i.vertices[l];
+		auto& vertex_2 = i.vertices[(l + 1) % i.size];
+		
+		/* vertices are both outside */
+		if (vertex_1.z > vertex_1.w && vertex_2.z > vertex_2.w) {
+			continue;
+		}
+		
+		/* vertices are both inside */
+		if (vertex_1.z <= vertex_1.w && vertex_2.z <= vertex_2.w) {
+			o.vertices[o.size++] = vertex_2;
+			continue;
+		}
+		
+		/* traveling from inside to outside */
+		float weight_1 = fabsf(vertex_1.w - vertex_1.z);
+		float weight_2 = fabsf(vertex_2.w - vertex_2.z);
+		float factor_1 = weight_2 / (weight_1 + weight_2);
+		float factor_2 = weight_1 / (weight_1 + weight_2);
+		o.vertices[o.size++] = vertex_1 * factor_1 + vertex_2 * factor_2;
+		
+		/* traveling from outside to inside */
+		if (vertex_1.z > vertex_1.w && vertex_2.z <= vertex_2.w) {
+			o.vertices[o.size++] = vertex_2;
+		}
+	}
+}
+
+static void rasterize_scanline(const State& s, const Vec3& vertex_1, const Vec3& vertex_2, const Vec3& vertex_3, Image& b) {
 	float min_x = fmaxf(0.f, s.viewport_x);
 	float max_x = fminf(b.width, s.viewport_x + s.viewport_width);
 	float min_y = fmaxf(0.f, s.viewport_y);
 	float max_y = fminf(b.height, s.viewport_y + s.viewport_height);
 	float* buffer = reinterpret_cast<float*>(b.data.data());
+	DVec2 v1 = {vertex_3.x - vertex_1.x, vertex_3.y - vertex_1.y};
+	DVec2 v2 = {vertex_2.x - vertex_1.x, vertex_2.y - vertex_1.y};
+	DVec2 v3 = {};
+	double v11 = v1.dot(v1);
+	double v12 = v1.dot(v2);
+	double v22 = v2.dot(v2);
+	double inv = 1. / (v11 * v22 - v12 * v12);
+	double v11_inv = v11 * inv;
+	double v12_inv = v12 * inv;
+	double v22_inv = v22 * inv;
+	Vec3 vertex_l = vertex_1;
+	Vec3 vertex_m = vertex_2;
+	Vec3 vertex_u = vertex_3;
+	if (vertex_l.y > vertex_m.y) std::swap(vertex_l, vertex_m);
+	if (vertex_m.y > vertex_u.y) std::swap(vertex_m, vertex_u);
+	if (vertex_l.y > vertex_m.y) std::swap(vertex_l, vertex_m);
+	float weight_1 = vertex_l.x / (vertex_m.y - vertex_l.y);
+	float weight_2 = vertex_m.x / (vertex_m.y - vertex_l.y);
+	float weight_3 = vertex_m.x / (vertex_u.y - vertex_m.y);
+	float weight_4 = vertex_u.x / (vertex_u.y - vertex_m.y);
+	float weight_5 = vertex_l.x / (vertex_u.y - vertex_l.y);
+	float weight_6 = vertex_u.x / (vertex_u.y - vertex_l.y);
+	float lower = fmaxf(floorf(vertex_l.y + 0.5f) + 0.5f, min_y + 0.5f);
+	float upper = fminf(floorf(vertex_u.y + 0.5f) - 0.5f, max_y - 0.5f);
+	for (float y = lower; y <= upper; y += 1.f) {
+		int offset_y = static_cast<int>(y) * b.width;
+		float left = y < vertex_m.y ?
+			(vertex_m.y - y) * weight_1 + (y - vertex_l.y) * weight_2 :
+			(vertex_u.y - y) * weight_3 + (y - vertex_m.y) * weight_4;
+		float right =
+			(vertex_u.y - y) * weight_5 + (y - vertex_l.y) * weight_6;
+		if (left > right) std::swap(left, right);
+		left = fmaxf(floorf(left + 0.5f) + 0.5f, min_x + 0.5f);
+		right = fminf(floorf(right + 0.5f) - 0.5f, max_x - 0.5f);
+		for (float x = left; x <= right; x += 1.f) {
+			v3.x = x - vertex_1.x;
+			v3.y = y - vertex_1.y;
+			double v13 = v1.dot(v3);
+			double v23 = v2.dot(v3);
+			double u = v22_inv * v13 - v12_inv * v23;
+			double v = v11_inv * v23 - v12_inv * v13;
+			float z = vertex_1.z * (1. - u - v) + vertex_2.z * v + vertex_3.z * u;
+			float& buffer_z = buffer[offset_y + static_cast<int>(x)];
+			if (z < buffer_z) buffer_z = z;
+		}
+	}
+}
+
+static void rasterize_tile(const TileSetup& t, float* b, int w) {
+	for (int y = t.first_row; y < t.last_row; ++y) {
+		float* row = b + y * w;
+		for (int x = t.first_column; x < t.last_column; ++x) {
+			bool inside = t.full;
+			if (!inside) {
+				int e0 = t.edges[0] + t.edge_steps_x[0] * x + t.edge_steps_y[0] * y;
+				int e1 = t.edges[1] + t.edge_steps_x[1] * x + t.edge_steps_y[1] * y;
+				int e2 = t.edges[2] + t.edge_steps_x[2] * x + t.edge_steps_y[2] * y;
+				inside = (e0 | e1 | e2) >= 0;
+			}
+			/* the SIMD kernels evaluate the depth plane in the same order */
+			float z = (t.depth + t.depth_step_x * x) + t.depth_step_y * y;
+			if (inside && z < row[x]) row[x] = z;
+		}
+	}
+}
+
+#ifdef SOFT_USE_SSE2
+static void rasterize_tile_sse2(const TileSetup& t, float* b, int w) {
+	/* the lanes of two halves of tile row */
+	__m128i lanes[2] = {_mm_setr_epi32(0, 1, 2, 3), _mm_setr_epi32(4, 5, 6, 7)};
+	__m128i first = _mm_set1_epi32(t.first_column - 1);
+	__m128i last = _mm_set1_epi32(t.last_column);
+	__m128i columns[2];
+	__m128i edges[3][2];
+	__m128i edge_steps[3];
+	__m128 depths[2];
+	for (int h = 0; h < 2; ++h) {
+		columns[h] = _mm_and_si128(_mm_cmpgt_epi32(lanes[h], first), _mm_cmplt_epi32(lanes[h], last));
+		for (int k = 0; k < 3; ++k) {
+			int e = t.edges[k] + t.edge_steps_y[k] * t.first_row + t.edge_steps_x[k] * h * 4;
+			int s = t.edge_steps_x[k];
+			edges[k][h] = _mm_setr_epi32(e, e + s, e + s * 2, e + s * 3);
+		}
+		
+		/* evaluate the depth plane in the same order as the scalar kernel */
+		__m128 x = _mm_cvtepi32_ps(lanes[h]);
+		depths[h] = _mm_add_ps(_mm_set1_ps(t.depth), _mm_mul_ps(_mm_set1_ps(t.depth_step_x), x));
+	}
+	for (int k = 0; k < 3; ++k) edge_steps[k] = _mm_set1_epi32(t.edge_steps_y[k]);
+	
+	for (int y = t.first_row; y < t.last_row; ++y) {
+		float* row = b + y * w;
+		__m128 depth_y = _mm_set1_ps(t.depth_step_y * y);
+		for (int h = 0; h < 2; ++h) {
+			/* the pixel is covered if no edge function is negative */
+			__m128i coverage = columns[h];
+			if (!t.full) {
+				__m128i sign = _mm_or_si128(_mm_or_si128(edges[0][h], edges[1][h]), edges[2][h]);
+				coverage = _mm_andnot_si128(_mm_srai_epi32(sign, 31), coverage);
+			}
+			
+			/* depth test & write */
+			__m128 z = _mm_add_ps(depths[h], depth_y);
+			__m128 dst = _mm_loadu_ps(row + h * 4);
+			__m128 pass = _mm_and_ps(_mm_castsi128_ps(coverage), _mm_cmplt_ps(z, dst));
+			_mm_storeu_ps(row + h * 4, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, dst)));
+			
+			/* step to the next row */
+			for (int k = 0; k < 3; ++k) edges[k][h] = _mm_add_epi32(edges[k][h], edge_steps[k]);
+		}
+	}
+}
+#endif
+
+#ifdef SOFT_USE_AVX2
+SOFT_TARGET_AVX2 static void rasterize_tile_avx2(const TileSetup& t, float* b, int w) {
+	/* the lanes of a whole tile row */
+	__m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i first = _mm256_set1_epi32(t.first_column - 1);
+	__m256i last = _mm256_set1_epi32(t.last_column);
+	__m256i columns = _mm256_and_si256(_mm256_cmpgt_epi32(lanes, first), _mm256_cmpgt_epi32(last, lanes));
+	__m256i edges[3];
+	__m256i edge_steps[3];
+	for (int k = 0; k < 3; ++k) {
+		__m256i e = _mm256_set1_epi32(t.edges[k] + t.edge_steps_y[k] * t.first_row);
+		__m256i s = _mm256_set1_epi32(t.edge_steps_x[k]);
+		edges[k] = _mm256_add_epi32(e, _mm256_mullo_epi32(s, lanes));
+		edge_steps[k] = _mm256_set1_epi32(t.edge_steps_y[k]);
+	}
+	
+	/* evaluate the depth plane in the same order as the scalar kernel */
+	__m256 x = _mm256_cvtepi32_ps(lanes);
+	__m256 depths = _mm256_add_ps(_mm256_set1_ps(t.depth), _mm256_mul_ps(_mm256_set1_ps(t.depth_step_x), x));
+	
+	for (int y = t.first_row; y < t.last_row; ++y) {
+		float* row = b + y * w;
+		__m256 z = _mm256_add_ps(depths, _mm256_set1_ps(t.depth_step_y * y));
+		
+		/* the pixel is covered if no edge function is negative */
+		__m256i coverage = columns;
+		if (!t.full) {
+			__m256i sign = _mm256_or_si256(_mm256_or_si256(edges[0], edges[1]), edges[2]);
+			coverage = _mm256_andnot_si256(_mm256_srai_epi32(sign, 31), coverage);
+		}
+		
+		/* depth test & write */
+		__m256 dst = _mm256_loadu_ps(row);
+		__m256 pass = _mm256_and_ps(_mm256_castsi256_ps(coverage), _mm256_cmp_ps(z, dst, _CMP_LT_OQ));
+		_mm256_storeu_ps(row, _mm256_blendv_ps(dst, z, pass));
+		
+		/* step to the next row */
+		for (int k = 0; k < 3; ++k) edges[k] = _mm256_add_epi32(edges[k], edge_steps[k]);
+	}
+}
+#endif
+
+static int get_task_count(int n, int t) {
+	if (t < PARALLEL_RENDER_THRESHOLD) return 1;
+	return n > 0 ? n : WorkerPool::get_thread_count();
+}
+
+template <typename Triangle>
+static TriangleBins<Triangle>& get_bins(int t, int n) {
+	/* keep the memory of bins for the next call on the same thread */
+	thread_local TriangleBins<Triangle> bins;
+	bins.triangles.resize(t);
+	bins.indices.resize(t);
+	for (int i = 0; i < t; ++i) {
+		bins.triangles[i].clear();
+		bins.indices[i].resize(n);
+		for (auto& indices : bins.indices[i]) indices.clear();
+	}
+	return bins;
+}
+
+static bool supports_avx2() {
+#if defined(SOFT_USE_AVX2) && (defined(__GNUC__) || defined(__clang__))
+	return __builtin_cpu_supports("avx2");
+#elif defined(SOFT_USE_AVX2) && defined(_MSC_VER)
+	/* check the CPU feature and whether the OS saves the YMM registers */
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool os_support = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+	__cpuidex(info, 7, 0);
+	return os_support && (info[1] & (1 << 5)) != 0;
+#else
+	return false;
+#endif
+}
+
+template <void (*Kernel)(const TileSetup&, float*, int)>
+static SOFT_FORCE_INLINE void rasterize_tiled(const State& s, const Vec3& v1, const Vec3& v2, const Vec3& v3, Image& b) {
+	/* snap the vertices to fixed-point subpixels */
+	const Vec3* vertices[3] = {&v1, &v2, &v3};
+	int64_t x[3];
+	int64_t y[3];
+	for (int k = 0; k < 3; ++k) {
+		x[k] = static_cast<int64_t>(vertices[k]->x * SUBPIXEL_SCALE + SNAPPING_BIAS) - SNAPPING_OFFSET;
+		y[k] = static_cast<int64_t>(vertices[k]->y * SUBPIXEL_SCALE + SNAPPING_BIAS) - SNAPPING_OFFSET;
+	}
+	
+	/* make the triangle counter-clockwise */
+	int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0) return;
+	if (area < 0) {
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+	}
+	
+	/* find the pixels inside the bounding box and the viewport */
+	int min_x = std::max({s.viewport_x, 0, static_cast<int>(std::min({x[0], x[1], x[2]}) >> SUBPIXEL_BITS)});
+	int max_x = std::min({s.viewport_x + s.viewport_width, b.width, static_cast<int>(std::max({x[0], x[1], x[2]}) >> SUBPIXEL_BITS) + 1});
+	int min_y = std::max({s.viewport_y, 0, static_cast<int>(std::min({y[0], y[1], y[2]}) >> SUBPIXEL_BITS)});
+	int max_y = std::min({s.viewport_y + s.viewport_height, b.height, static_cast<int>(std::max({y[0], y[1], y[2]}) >> SUBPIXEL_BITS) + 1});
+	if (min_x >= max_x || min_y >= max_y) return;
+	
+	/* calculate the edge functions with the top-left fill rule */
+	int64_t edge_x[3];
+	int64_t edge_y[3];
+	int64_t edge_bias[3];
+	for (int k = 0; k < 3; ++k) {
+		int l = (k + 1) % 3;
+		edge_x[k] = y[k] - y[l];
+		edge_y[k] = x[l] - x[k];
+		bool top_left = edge_x[k] > 0 || (edge_x[k] == 0 && edge_y[k] > 0);
+		edge_bias[k] = top_left ? 0 : -1;
+	}
+	
+	/* calculate the depth plane in pixels */
+	double dx_1 = v2.x - v1.x;
+	double dy_1 = v2.y - v1.y;
+	double dx_2 = v3.x - v1.x;
+	double dy_2 = v3.y - v1.y;
+	double det = dx_1 * dy_2 - dy_1 * dx_2;
+	if (det == 0) return;
+	double depth_x = ((v2.z - v1.z) * dy_2 - (v3.z - v1.z) * dy_1) / det;
+	double depth_y = ((v3.z - v1.z) * dx_1 - (v2.z - v1.z) * dx_2) / det;
+	
+	/* evaluate the edge functions at the first pixel of the first tile */
+	int first_x = min_x / TILE_SIZE * TILE_SIZE;
+	int first_y = min_y / TILE_SIZE * TILE_SIZE;
+	int64_t center_x = (static_cast<int64_t>(first_x) << SUBPIXEL_BITS) + SUBPIXEL_SCALE / 2;
+	int64_t center_y = (static_cast<int64_t>(first_y) << SUBPIXEL_BITS) + SUBPIXEL_SCALE / 2;
+	int64_t edge_rows[3];
+	int64_t tile_steps_x[3];
+	int64_t tile_steps_y[3];
+	int64_t max_offsets[3];
+	int64_t min_offsets[3];
+	for (int k = 0; k < 3; ++k) {
+		edge_rows[k] = edge_x[k] * (center_x - x[k]) + edge_y[k] * (center_y - y[k]) + edge_bias[k];
+		tile_steps_x[k] = edge_x[k] * SUBPIXEL_SCALE * TILE_SIZE;
+		tile_steps_y[k] = edge_y[k] * SUBPIXEL_SCALE * TILE_SIZE;
+		int64_t step_x = edge_x[k] * SUBPIXEL_SCALE * (TILE_SIZE - 1);
+		int64_t step_y = edge_y[k] * SUBPIXEL_SCALE * (TILE_SIZE - 1);
+		max_offsets[k] = std::max<int64_t>(step_x, 0) + std::max<int64_t>(step_y, 0);
+		min_offsets[k] = std::min<int64_t>(step_x, 0) + std::min<int64_t>(step_y, 0);
+	}
+	double depth_row = v1.z + depth_x * (first_x + 0.5 - v1.x) + depth_y * (first_y + 0.5 - v1.y);
+	
+	/* rasterize the tiles overlapped by the bounding box */
+	float* buffer = reinterpret_cast<float*>(b.data.data());
+	TileSetup tile;
+	tile.depth_step_x = static_cast<float>(depth_x);
+	tile.depth_step_y = static_cast<float>(depth_y);
+	for (int tile_y = first_y; tile_y < max_y; tile_y += TILE_SIZE) {
+		int64_t edges[3] = {edge_rows[0], edge_rows[1], edge_rows[2]};
+		double depth = depth_row;
+		for (int tile_x = first_x; tile_x < max_x; tile_x += TILE_SIZE) {
+			
+			/* classify the tile against each edge at the corners */
+			bool outside = false;
+			bool full = true;
+			for (int k = 0; k < 3; ++k) {
+				bool inside = edges[k] + min_offsets[k] >= 0;
+				outside = outside || edges[k] + max_offsets[k] < 0;
+				full = full && inside;
+				
+				/* the edges completely inside are not evaluated */
+				tile.edges[k] = inside ? 0 : static_cast<int>(edges[k]);
+				tile.edge_steps_x[k] = inside ? 0 : static_cast<int>(edge_x[k] * SUBPIXEL_SCALE);
+				tile.edge_steps_y[k] = inside ? 0 : static_cast<int>(edge_y[k] * SUBPIXEL_SCALE);
+				edges[k] += tile_steps_x[k];
+			}
+			float tile_depth = static_cast<float>(depth);
+			depth += depth_x * TILE_SIZE;
+			
+			/* trivially reject the tile outside of any edge */
+			if (outside) continue;
+			tile.full = full;
+			tile.depth = tile_depth;
+			
+			/* clip the tile with the viewport */
+			tile.first_column = std::max(min_x - tile_x, 0);
+			tile.last_column = std::min(max_x - tile_x, TILE_SIZE);
+			tile.first_row = std::max(min_y - tile_y, 0);
+			tile.last_row = std::min(max_y - tile_y, TILE_SIZE);
+			
+			/* the tile crossing the right side of buffer is rasterized in scalar */
+			float* origin = buffer + tile_y * b.width + tile_x;
+			if (tile_x + TILE_SIZE <= b.width) {
+				Kernel(tile, origin, b.width);
+			} else {
+				rasterize_tile(tile, origin, b.width);
+			}
+		}
+		for (int k = 0; k < 3; ++k) edge_rows[k] += tile_steps_y[k];
+		depth_row += depth_y * TILE_SIZE;
+	}
+}
+
+static void rasterize_scalar(const State& s, const Vec3& v1, const Vec3& v2, const Vec3& v3, Image& b) {
+	rasterize_tiled<rasterize_tile>(s, v1, v2, v3, b);
+}
+
+#ifdef SOFT_USE_SSE2
+static void rasterize_sse2(const State& s, const Vec3& v1, const Vec3& v2, const Vec3& v3, Image& b) {
+	rasterize_tiled<rasterize_tile_sse2>(s, v1, v2, v3, b);
+}
+#endif
+
+#ifdef SOFT_USE_AVX2
+SOFT_TARGET_AVX2 static void rasterize_avx2(const State& s, const Vec3& v1, const Vec3& v2, const Vec3& v3, Image& b) {
+	rasterize_tiled<rasterize_tile_avx2>(s, v1, v2, v3, b);
+}
+#endif
+
+static TriangleRasterizer select_rasterizer(RasterizerType r) {
+	switch (r) {
+		case RASTERIZER_SCANLINE:
+			return rasterize_scanline;
+		case RASTERIZER_SCALAR:
+			return rasterize_scalar;
+#ifdef SOFT_USE_SSE2
+		case RASTERIZER_SSE2:
+			return rasterize_sse2;
+#endif
+#ifdef SOFT_USE_AVX2
+		case RASTERIZER_AVX2:
+			if (supports_avx2()) return rasterize_avx2;
+			break;
+#endif
+		default:
+			break;
+	}
+	
+	/* select the widest instruction set supported at runtime */
+#ifdef SOFT_USE_AVX2
+	if (supports_avx2()) return rasterize_avx2;
+#endif
+#ifdef SOFT_USE_SSE2
+	return rasterize_sse2;
+#else
+	/* the scalar tiles are slower than scanlines without vectors */
+	return rasterize_scanline;
+#endif
+}
+
+bool is_supported(RasterizerType r) {
+	if (r == RASTERIZER_SSE2) {
+#ifdef SOFT_USE_SSE2
+		return true;
+#else
+		return false;
+#endif
+	}
+	if (r == RASTERIZER_AVX2) return supports_avx2();
+	return true;
+}
+
+void rasterize(const State& s, const Vec3* v, int n, Image& b) {
+	static const TriangleRasterizer rasterize_auto = select_rasterizer(RASTERIZER_AUTO);
+	TriangleRasterizer rasterize_triangle = rasterize_auto;
+	if (s.rasterizer != RASTERIZER_AUTO) rasterize_triangle = select_rasterizer(s.rasterizer);
 	for (int i = 2; i < n; ++i) {
 		auto& vertex_1 = v[0];
 		auto& vertex_2 = v[i - 1];
 		auto& vertex_3 = v[i];
-		DVec2 v1 = {vertex_3.x - vertex_1.x, vertex_3.y - vertex_1.y};
-		DVec2 v2 = {vertex_2.x - vertex_1.x, vertex_2.y - vertex_1.y};
-		DVec2 v3 = {};
-		double v11 = v1.dot(v1);
-		double v12 = v1.dot(v2);
-		double v22 = v2.dot(v2);
-		double inv = 1. / (v11 * v22 - v12 * v12);
-		double v11_inv = v11 * inv;
-		double v12_inv = v12 * inv;
-		double v22_inv = v22 * inv;
-		Vec3 vertex_l = vertex_1;
-		Vec3 vertex_m = vertex_2;
-		Vec3 vertex_u = vertex_3;
-		if (vertex_l.y > vertex_m.y) std::swap(vertex_l, vertex_m);
-		if (vertex_m.y > vertex_u.y) std::swap(vertex_m, vertex_u);
-		if (vertex_l.y > vertex_m.y) std::swap(vertex_l, vertex_m);
-		float weight_1 = vertex_l.x / (vertex_m.y - vertex_l.y);
-		float weight_2 = vertex_m.x / (vertex_m.y - vertex_l.y);
-		float weight_3 = vertex_m.x / (vertex_u.y - vertex_m.y);
-		float weight_4 = vertex_u.x / (vertex_u.y - vertex_m.y);
-		float weight_5 = vertex_l.x / (vertex_u.y - vertex_l.y);
-		float weight_6 = vertex_u.x / (vertex_u.y - vertex_l.y);
-		float lower = fmaxf(floorf(vertex_l.y + 0.5f) + 0.5f, min_y + 0.5f);
-		float upper = fminf(floorf(vertex_u.y + 0.5f) - 0.5f, max_y + 0.5f);
-		for (float y = lower; y <= upper; y += 1.f) {
-			int offset_y = static_cast<int>(y) * b.width;
-			float left = y < vertex_m.y ?
-				(vertex_m.y - y) * weight_1 + (y - vertex_l.y) * weight_2 :
-				(vertex_u.y - y) * weight_3 + (y - vertex_m.y) * weight_4;
-			float right =
-				(vertex_u.y - y) * weight_5 + (y - vertex_l.y) * weight_6;
-			if (left > right) std::swap(left, right);
-			left = fmaxf(floorf(left + 0.5f) + 0.5f, min_x + 0.5f);
-			right = fminf(floorf(right + 0.5f) - 0.5f, max_x + 0.5f);
-			for (float x = left; x <= right; x += 1.f) {
-				v3.x = x - vertex_1.x;
-				v3.y = y - vertex_1.y;
-				double v13 = v1.dot(v3);
-				double v23 = v2.dot(v3);
-				double u = v22_inv * v13 - v12_inv * v23;
-				double v = v11_inv * v23 - v12_inv * v13;
-				float z = vertex_1.z * (1. - u - v) + vertex_2.z * v + vertex_3.z * u;
-				float& buffer_z = buffer[offset_y + static_cast<int>(x)];
-				if (z < buffer_z) buffer_z = z;
-			}
+		
+		/* fall back to scanlines if out of the fixed-point range */
+		bool in_range = true;
+		for (auto* vertex : {&vertex_1, &vertex_2, &vertex_3}) {
+			in_range = in_range && fabsf(vertex->x) <= MAX_COORDINATE && fabsf(vertex->y) <= MAX_COORDINATE;
+		}
+		if (in_range) {
+			rasterize_triangle(s, vertex_1, vertex_2, vertex_3, b);
+		} else {
+			rasterize_scanline(s, vertex_1, vertex_2, vertex_3, b);
 		}
 	}
 }
 
+#ifndef SOFT_USE_SSE2
+static void cull_triangles_scalar(const State& s, int n, TriangleBatch& b) {
+	b.visible_mask = 0;
+	b.clip_mask = 0;
+	for (int l = 0; l < n; ++l) {
+		/* reject the triangle outside of any clip plane */
+		int outside = 0x3F;
+		int crossing = 0;
+		for (int k = 0; k < 3; ++k) {
+			float x = b.x[k][l];
+			float y = b.y[k][l];
+			float z = b.z[k][l];
+			float w = b.w[k][l];
+			int code = (x > w) | (x < -w) << 1 | (y > w) << 2 | (y < -w) << 3 | (z > w) << 4 | (z < -w) << 5;
+			outside &= code;
+			crossing |= code;
+		}
+		if (outside != 0) continue;
+		
+		/* cull the faces with the determinant in homogeneous coordinates */
+		float det = b.x[0][l] * (b.y[1][l] * b.w[2][l] - b.y[2][l] * b.w[1][l]) -
+					b.y[0][l] * (b.x[1][l] * b.w[2][l] - b.x[2][l] * b.w[1][l]) +
+					b.w[0][l] * (b.x[1][l] * b.y[2][l] - b.x[2][l] * b.y[1][l]);
+		if (det == 0 || (s.side == FRONT_SIDE && det < 0) || (s.side == BACK_SIDE && det > 0)) continue;
+		
+		/* the triangle crossing the near or far plane needs clipping */
+		if ((crossing & 0x30) != 0) {
+			b.visible_mask |= 1 << l;
+			b.clip_mask |= 1 << l;
+			continue;
+		}
+		
+		/* project the vertices to screen space */
+		float width = s.viewport_width * 0.5f;
+		float height = s.viewport_height * 0.5f;
+		for (int k = 0; k < 3; ++k) {
+			float inverse_w = 1 / b.w[k][l];
+			b.screen_x[k][l] = b.x[k][l] * inverse_w * width + (width + s.viewport_x);
+			b.screen_y[k][l] = b.y[k][l] * inverse_w * height + (height + s.viewport_y);
+			b.screen_z[k][l] = b.z[k][l] * inverse_w * 0.5f + 0.5f;
+		}
+		
+		/* reject the triangle if no sample center is in the bounding box */
+		float lower_x = std::min({b.screen_x[0][l], b.screen_x[1][l], b.screen_x[2][l]}) - SAMPLE_MARGIN;
+		float upper_x = std::max({b.screen_x[0][l], b.screen_x[1][l], b.screen_x[2][l]}) + SAMPLE_MARGIN;
+		float lower_y = std::min({b.screen_y[0][l], b.screen_y[1][l], b.screen_y[2][l]}) - SAMPLE_MARGIN;
+		float upper_y = std::max({b.screen_y[0][l], b.screen_y[1][l], b.screen_y[2][l]}) + SAMPLE_MARGIN;
+		bool in_range = fabsf(lower_x) <= MAX_COORDINATE && fabsf(upper_x) <= MAX_COORDINATE &&
+						fabsf(lower_y) <= MAX_COORDINATE && fabsf(upper_y) <= MAX_COORDINATE;
+		if (in_range && (floorf(lower_x - 0.5f) == floorf(upper_x - 0.5f) ||
+						 floorf(lower_y - 0.5f) == floorf(upper_y - 0.5f))) continue;
+		b.visible_mask |= 1 << l;
+	}
+}
+#endif
+
+#ifdef SOFT_USE_SSE2
+static void cull_triangles_sse2(const State& s, int n, TriangleBatch& b) {
+	/* reject the triangles outside of any clip plane */
+	__m128 zero = _mm_setzero_ps();
+	__m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	__m128 outside_planes[6] = {all, all, all, all, all, all};
+	__m128 crossing = zero;
+	__m128 x[3];
+	__m128 y[3];
+	__m128 z[3];
+	__m128 w[3];
+	for (int k = 0; k < 3; ++k) {
+		x[k] = _mm_loadu_ps(b.x[k]);
+		y[k] = _mm_loadu_ps(b.y[k]);
+		z[k] = _mm_loadu_ps(b.z[k]);
+		w[k] = _mm_loadu_ps(b.w[k]);
+		__m128 negative_w = _mm_sub_ps(zero, w[k]);
+		__m128 outside_far = _mm_cmpgt_ps(z[k], w[k]);
+		__m128 outside_near = _mm_cmplt_ps(z[k], negative_w);
+		outside_planes[0] = _mm_and_ps(outside_planes[0], _mm_cmpgt_ps(x[k], w[k]));
+		outside_planes[1] = _mm_and_ps(outside_planes[1], _mm_cmplt_ps(x[k], negative_w));
+		outside_planes[2] = _mm_and_ps(outside_planes[2], _mm_cmpgt_ps(y[k], w[k]));
+		outside_planes[3] = _mm_and_ps(outside_planes[3], _mm_cmplt_ps(y[k], negative_w));
+		outside_planes[4] = _mm_and_ps(outside_planes[4], outside_far);
+		outside_planes[5] = _mm_and_ps(outside_planes[5], outside_near);
+		crossing = _mm_or_ps(crossing, _mm_or_ps(outside_far, outside_near));
+	}
+	__m128 outside = _mm_or_ps(_mm_or_ps(outside_planes[0], outside_planes[1]),
+							   _mm_or_ps(_mm_or_ps(outside_planes[2], outside_planes[3]),
+										 _mm_or_ps(outside_planes[4], outside_planes[5])));
+	
+	/* cull the faces with the determinant in homogeneous coordinates */
+	__m128 det = _mm_mul_ps(x[0], _mm_sub_ps(_mm_mul_ps(y[1], w[2]), _mm_mul_ps(y[2], w[1])));
+	det = _mm_sub_ps(det, _mm_mul_ps(y[0], _mm_sub_ps(_mm_mul_ps(x[1], w[2]), _mm_mul_ps(x[2], w[1]))));
+	det = _mm_add_ps(det, _mm_mul_ps(w[0], _mm_sub_ps(_mm_mul_ps(x[1], y[2]), _mm_mul_ps(x[2], y[1]))));
+	__m128 facing = s.side == FRONT_SIDE ? _mm_cmpgt_ps(det, zero) :
+		s.side == BACK_SIDE ? _mm_cmplt_ps(det, zero) : _mm_cmpneq_ps(det, zero);
+	__m128 visible = _mm_andnot_ps(outside, facing);
+	
+	/* project the vertices to screen space */
+	__m128 half = _mm_set1_ps(0.5f);
+	__m128 width = _mm_set1_ps(s.viewport_width * 0.5f);
+	__m128 height = _mm_set1_ps(s.viewport_height * 0.5f);
+	__m128 offset_x = _mm_set1_ps(s.viewport_width * 0.5f + s.viewport_x);
+	__m128 offset_y = _mm_set1_ps(s.viewport_height * 0.5f + s.viewport_y);
+	__m128 screen_x[3];
+	__m128 screen_y[3];
+	for (int k = 0; k < 3; ++k) {
+		__m128 inverse_w = _mm_div_ps(_mm_set1_ps(1), w[k]);
+		screen_x[k] = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(x[k], inverse_w), width), offset_x);
+		screen_y[k] = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(y[k], inverse_w), height), offset_y);
+		_mm_storeu_ps(b.screen_x[k], screen_x[k]);
+		_mm_storeu_ps(b.screen_y[k], screen_y[k]);
+		_mm_storeu_ps(b.screen_z[k], _mm_add_ps(_mm_mul_ps(_mm_mul_ps(z[k], inverse_w), half), half));
+	}
+	
+	/* reject the triangles if no sample center is in the bounding box */
+	__m128 margin = _mm_set1_ps(SAMPLE_MARGIN);
+	__m128 lower_x = _mm_sub_ps(_mm_min_ps(_mm_min_ps(screen_x[0], screen_x[1]), screen_x[2]), margin);
+	__m128 upper_x = _mm_add_ps(_mm_max_ps(_mm_max_ps(screen_x[0], screen_x[1]), screen_x[2]), margin);
+	__m128 lower_y = _mm_sub_ps(_mm_min_ps(_mm_min_ps(screen_y[0], screen_y[1]), screen_y[2]), margin);
+	__m128 upper_y = _mm_add_ps(_mm_max_ps(_mm_max_ps(screen_y[0], screen_y[1]), screen_y[2]), margin);
+	__m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	__m128 max_coordinate = _mm_set1_ps(MAX_COORDINATE);
+	__m128 in_range = _mm_and_ps(
+		_mm_and_ps(_mm_cmple_ps(_mm_and_ps(lower_x, abs_mask), max_coordinate),
+				   _mm_cmple_ps(_mm_and_ps(upper_x, abs_mask), max_coordinate)),
+		_mm_and_ps(_mm_cmple_ps(_mm_and_ps(lower_y, abs_mask), max_coordinate),
+				   _mm_cmple_ps(_mm_and_ps(upper_y, abs_mask), max_coordinate)));
+	
+	/* floor with truncation after shifting the coordinates to positive */
+	__m128 shift = _mm_set1_ps(MAX_COORDINATE * 2 - 0.5f);
+	__m128i same_x = _mm_cmpeq_epi32(_mm_cvttps_epi32(_mm_add_ps(lower_x, shift)),
+									 _mm_cvttps_epi32(_mm_add_ps(upper_x, shift)));
+	__m128i same_y = _mm_cmpeq_epi32(_mm_cvttps_epi32(_mm_add_ps(lower_y, shift)),
+									 _mm_cvttps_epi32(_mm_add_ps(upper_y, shift)));
+	__m128 small = _mm_and_ps(in_range, _mm_castsi128_ps(_mm_or_si128(same_x, same_y)));
+	visible = _mm_andnot_ps(_mm_andnot_ps(crossing, small), visible);
+	
+	int lanes = (1 << n) - 1;
+	b.visible_mask = _mm_movemask_ps(visible) & lanes;
+	b.clip_mask = _mm_movemask_ps(_mm_and_ps(visible, crossing)) & lanes;
+}
+#endif
+
+static void cull_triangles(const State& s, int n, TriangleBatch& b) {
+#ifdef SOFT_USE_SSE2
+	cull_triangles_sse2(s, n, b);
+#else
+	cull_triangles_scalar(s, n, b);
+#endif
+}
+
 void render(const State& s, const Instance& i, const Camera& c, Image& b) {
 	Mesh* mesh = i.mesh;
-	size_t length = mesh->vertex.size();
+	bool has_indices = !mesh->indices.empty();
+	size_t length = has_indices ? mesh->indices.size() : mesh->vertex.size();
+	int triangle_count = static_cast<int>(length / 3);
 	
-	/* prepare resources for rendering */
+	/* find the bins of viewport aligned to the tiles */
+	int min_x = std::max(s.viewport_x, 0);
+	int max_x = std::min(s.viewport_x + s.viewport_width, b.width);
+	int min_y = std::max(s.viewport_y, 0);
+	int max_y = std::min(s.viewport_y + s.viewport_height, b.height);
+	if (min_x >= max_x || min_y >= max_y || triangle_count == 0) return;
+	int first_bin_x = min_x / BIN_SIZE;
+	int first_bin_y = min_y / BIN_SIZE;
+	int bin_x = (max_x - 1) / BIN_SIZE - first_bin_x + 1;
+	int bin_y = (max_y - 1) / BIN_SIZE - first_bin_y + 1;
+	int bin_count = bin_x * bin_y;
+	
+	/* decide the number of tasks by the number of triangles */
+	int task_count = get_task_count(s.thread_count, triangle_count);
+	
+	/* transform, clip and cull the triangles in range, then output the polygons */
+	Mat4 model_view_proj = c.projection * c.viewing * i.matrix_global;
+	auto transform_triangles = [&](int start, int end, const auto& output) -> void {
+		TriangleBatch batch;
+		PointList primitives;
+		PointList near_clipped;
+		PointList clipped;
+		Vec3 device_coords[5];
+		for (int k = start; k < end; k += CULL_BATCH_SIZE) {
+			int number = std::min(CULL_BATCH_SIZE, end - k);
+			
+			/* model-view-projection transform into the batch */
+			for (int l = 0; l < number; ++l) {
+				for (int j = 0; j < 3; ++j) {
+					int index = has_indices ? mesh->indices[(k + l) * 3 + j] : (k + l) * 3 + j;
+					Vec4 vertex = model_view_proj * Vec4(mesh->vertex[index], 1);
+					batch.x[j][l] = vertex.x;
+					batch.y[j][l] = vertex.y;
+					batch.z[j][l] = vertex.z;
+					batch.w[j][l] = vertex.w;
+				}
+			}
+			
+			/* cull the batch by clip planes, facing and size */
+			cull_triangles(s, number, batch);
+			
+			for (int l = 0; l < number; ++l) {
+				if ((batch.visible_mask & (1 << l)) == 0) continue;
+				
+				/* output the projected triangle without clipping */
+				if ((batch.clip_mask & (1 << l)) == 0) {
+					for (int j = 0; j < 3; ++j) {
+						device_coords[j] = {batch.screen_x[j][l], batch.screen_y[j][l], batch.screen_z[j][l]};
+					}
+					output(device_coords, 3);
+					continue;
+				}
+				
+				/* clip near plane and far plane */
+				primitives.size = 3;
+				for (int j = 0; j < 3; ++j) {
+					primitives.vertices[j] = {batch.x[j][l], batch.y[j][l], batch.z[j][l], batch.w[j][l]};
+				}
+				near_clipped.size = 0;
+				clip_near_plane(primitives, near_clipped);
+				clipped.size = 0;
+				clip_far_plane(near_clipped, clipped);
+				
+				/* perspective division & viewport transform */
+				int size = clipped.size;
+				for (int j = 0; j < size; ++j) {
+					auto& vertex = clipped.vertices[j];
+					device_coords[j].x = (vertex.x / vertex.w * 0.5f + 0.5f) * s.viewport_width + s.viewport_x;
+					device_coords[j].y = (vertex.y / vertex.w * 0.5f + 0.5f) * s.viewport_height + s.viewport_y;
+					device_coords[j].z = vertex.z / vertex.w * 0.5f + 0.5f;
+				}
+				output(device_coords, size);
+			}
+		}
+	};
+	
+	/* rasterize the triangles directly if there is only one task */
+	if (task_count == 1) {
+		transform_triangles(0, triangle_count, [&](const Vec3* v, int n) -> void {
+			rasterize(s, v, n, b);
+		});
+		return;
+	}
+	
+	/* transform, clip and bin the triangles in parallel */
+	auto& bins = get_bins<Vec3>(task_count, bin_count);
+	WorkerPool::run(task_count, [&](int t) -> void {
+		auto& triangles = bins.triangles[t];
+		auto& indices = bins.indices[t];
+		int start = static_cast<int>(static_cast<int64_t>(triangle_count) * t / task_count);
+		int end = static_cast<int>(static_cast<int64_t>(triangle_count) * (t + 1) / task_count);
+		
+		/* add the triangles of polygon to the bins they overlap */
+		transform_triangles(start, end, [&](const Vec3* v, int n) -> void {
+			for (int j = 2; j < n; ++j) {
+				auto& v1 = v[0];
+				auto& v2 = v[j - 1];
+				auto& v3 = v[j];
+				float lower_x = std::max(std::min({v1.x, v2.x, v3.x}), static_cast<float>(min_x));
+				float upper_x = std::min(std::max({v1.x, v2.x, v3.x}), static_cast<float>(max_x - 1));
+				float lower_y = std::max(std::min({v1.y, v2.y, v3.y}), static_cast<float>(min_y));
+				float upper_y = std::min(std::max({v1.y, v2.y, v3.y}), static_cast<float>(max_y - 1));
+				if (!(lower_x <= upper_x && lower_y <= upper_y)) continue;
+				int triangle = static_cast<int>(triangles.size() / 3);
+				triangles.insert(triangles.end(), {v1, v2, v3});
+				int start_x = static_cast<int>(lower_x) / BIN_SIZE - first_bin_x;
+				int end_x = static_cast<int>(upper_x) / BIN_SIZE - first_bin_x;
+				int start_y = static_cast<int>(lower_y) / BIN_SIZE - first_bin_y;
+				int end_y = static_cast<int>(upper_y) / BIN_SIZE - first_bin_y;
+				for (int y = start_y; y <= end_y; ++y) {
+					for (int x = start_x; x <= end_x; ++x) indices[y * bin_x + x].emplace_back(triangle);
+				}
+			}
+		});
+	});
+	
+	/* rasterize the bins in parallel, the bins never share a tile */
+	std::atomic<int> next_bin = 0;
+	WorkerPool::run(task_count, [&](int) -> void {
+		for (int bin = next_bin++; bin < bin_count; bin = next_bin++) {
+			int x = (first_bin_x + bin % bin_x) * BIN_SIZE;
+			int y = (first_bin_y + bin / bin_x) * BIN_SIZE;
+			State bin_state = s;
+			bin_state.viewport_x = std::max(x, min_x);
+			bin_state.viewport_y = std::max(y, min_y);
+			bin_state.viewport_width = std::min(x + BIN_SIZE, max_x) - bin_state.viewport_x;
+			bin_state.viewport_height = std::min(y + BIN_SIZE, max_y) - bin_state.viewport_y;
+			
+			/* rasterize the triangles in the order of submission */
+			for (int t = 0; t < task_count; ++t) {
+				auto& triangles = bins.triangles[t];
+				for (int triangle : bins.indices[t][bin]) {
+					rasterize(bin_state, triangles.data() + triangle * 3, 3, b);
+				}
+			}
+		}
+	});
+}
+
+OcclusionBuffer::OcclusionBuffer(int w, int h) : width(w), height(h) {
+	tile_x = (w + TILE_WIDTH - 1) / TILE_WIDTH;
+	tile_y = (h + TILE_HEIGHT - 1) / TILE_HEIGHT;
+	masks.resize(tile_x * tile_y);
+	reference_depths.resize(tile_x * tile_y);
+	working_depths.resize(tile_x * tile_y);
+	clear();
+}
+
+int OcclusionBuffer::get_width() const {
+	return width;
+}
+
+int OcclusionBuffer::get_height() const {
+	return height;
+}
+
+void OcclusionBuffer::clear() {
+	std::fill(masks.begin(), masks.end(), 0);
+	std::fill(reference_depths.begin(), reference_depths.end(), 1.f);
+	std::fill(working_depths.begin(), working_depths.end(), 0.f);
+}
+
+void OcclusionBuffer::render(const Instance& i, const Camera& c) {
+	Mesh* mesh = i.mesh;
+	if (mesh == nullptr) return;
+	bool has_indices = !mesh->indices.empty();
+	size_t length = has_indices ? mesh->indices.size() : mesh->vertex.size();
+	
+	/* transform each vertex once for indexed meshes */
 	Mat4 model_view_proj = c.projection * c.viewing * i.matrix_global;
+	size_t vertex_count = mesh->vertex.size();
+	std::vector<Vec4> clip_coords(vertex_count);
+	for (int k = 0; k < vertex_count; ++k) {
+		clip_coords[k] = model_view_proj * Vec4(mesh->vertex[k], 1);
+	}
+	
+	/* prepare resources for rendering */
 	PointList primitives;
 	PointList clipped;
 	Vec3 device_coords[4];
 	
-	for (int i = 0; i < length; i += 3) {
-		/* model-view-projection transform */
+	for (int k = 0; k < length; k += 3) {
 		primitives.size = 3;
 		for (int j = 0; j < 3; ++j) {
-			primitives.vertices[j] = model_view_proj * Vec4(mesh->vertex[i + j], 1);
+			int index = has_indices ? mesh->indices[k + j] : k + j;
+			primitives.vertices[j] = clip_coords[index];
 		}
 		
+		/* skip the triangle outside of a side plane */
+		auto& p = primitives.vertices;
+		if (p[0].x > p[0].w && p[1].x > p[1].w && p[2].x > p[2].w) continue;
+		if (p[0].x < -p[0].w && p[1].x < -p[1].w && p[2].x < -p[2].w) continue;
+		if (p[0].y > p[0].w && p[1].y > p[1].w && p[2].y > p[2].w) continue;
+		if (p[0].y < -p[0].w && p[1].y < -p[1].w && p[2].y < -p[2].w) continue;
+		
 		/* clip near plane */
 		clipped.size = 0;
 		clip_near_plane(primitives, clipped);
 		
-		/* perspective division */
+		/* perspective division & viewport transform */
 		int number = clipped.size;
-		for (int i = 0; i < number; ++i) {
-			clipped.vertices[i] /= clipped.vertices[i].w;
+		for (int j = 0; j < number; ++j) {
+			auto& vertex = clipped.vertices[j];
+			device_coords[j].x = (vertex.x / vertex.w * 0.5f + 0.5f) * width;
+			device_coords[j].y = (vertex.y / vertex.w * 0.5f + 0.5f) * height;
+			device_coords[j].z = vertex.z / vertex.w * 0.5f + 0.5f;
 		}
 		
-		/* viewport transform */
-		for (int i = 0; i < number; ++i) {
-			device_coords[i].x = clipped.vertices[i].x * 0.5f + 0.5f;
-			device_coords[i].y = clipped.vertices[i].y * 0.5f + 0.5f;
-			device_coords[i].z = clipped.vertices[i].z * 0.5f + 0.5f;
-			device_coords[i].x = device_coords[i].x * s.viewport_width + s.viewport_x;
-			device_coords[i].y = device_coords[i].y * s.viewport_height + s.viewport_y;
+		/* rasterization */
+		for (int j = 2; j < number; ++j) {
+			rasterize(device_coords[0], device_coords[j - 1], device_coords[j]);
 		}
+	}
+}
+
+void OcclusionBuffer::render(const Scene& s, const Camera& c) {
+	s.to_visible_instances(c, visible_instances);
+	for (auto* instance : visible_instances) {
+		if (instance->occluder) render(*instance, c);
+	}
+}
+
+bool OcclusionBuffer::test(const Vec3& min, const Vec3& max, const Camera& c) const {
+	Mat4 view_proj = c.projection * c.viewing;
+	
+	/* project the corners of bounding box to the buffer */
+	float min_x = INFINITY;
+	float max_x = -INFINITY;
+	float min_y = INFINITY;
+	float max_y = -INFINITY;
+	float min_z = 1;
+	for (int k = 0; k < 8; ++k) {
+		Vec3 corner = {k & 1 ? max.x : min.x, k & 2 ? max.y : min.y, k & 4 ? max.z : min.z};
+		Vec4 vertex = view_proj * Vec4(corner, 1);
 		
-		/* rasterization */
-		rasterize(s, device_coords, number, b);
+		/* the box is visible if it crosses the near plane */
+		if (vertex.w <= 0 || vertex.z < -vertex.w) return true;
+		float x = (vertex.x / vertex.w * 0.5f + 0.5f) * width;
+		float y = (vertex.y / vertex.w * 0.5f + 0.5f) * height;
+		float z = vertex.z / vertex.w * 0.5f + 0.5f;
+		min_x = fminf(min_x, x);
+		max_x = fmaxf(max_x, x);
+		min_y = fminf(min_y, y);
+		max_y = fmaxf(max_y, y);
+		min_z = fminf(min_z, z);
+	}
+	
+	/* the box is visible if it is outside of buffer or degenerate */
+	if (max_x < 0 || min_x >= width || max_y < 0 || min_y >= height) return true;
+	if (min_x >= max_x || min_y >= max_y) return true;
+	
+	/* clamp the tiles overlapped by the box to the buffer */
+	int start_x = static_cast<int>(fmaxf(min_x, 0)) / TILE_WIDTH;
+	int end_x = std::min(static_cast<int>(fminf(max_x, width - 1)) / TILE_WIDTH, tile_x - 1);
+	int start_y = static_cast<int>(fmaxf(min_y, 0)) / TILE_HEIGHT;
+	int end_y = std::min(static_cast<int>(fminf(max_y, height - 1)) / TILE_HEIGHT, tile_y - 1);
+	
+	/* compare the nearest depth with the tiles overlapped by the box */
+	for (int y = start_y; y <= end_y; ++y) {
+		for (int x = start_x; x <= end_x; ++x) {
+			if (min_z < reference_depths[y * tile_x + x]) return true;
+		}
+	}
+	return false;
+}
+
+bool OcclusionBuffer::test(const Instance& i, const Camera& c) const {
+	Vec3 bound_min;
+	Vec3 bound_max;
+	i.get_bounds(bound_min, bound_max);
+	return test(bound_min, bound_max, c);
+}
+
+void OcclusionBuffer::rasterize(const Vec3& v1, const Vec3& v2, const Vec3& v3) {
+	/* make the triangle counter-clockwise */
+	const Vec3* a = &v1;
+	const Vec3* b = &v2;
+	const Vec3* c = &v3;
+	float area = (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+	if (!(area != 0)) return;
+	if (area < 0) {
+		std::swap(b, c);
+		area = -area;
+	}
+	
+	/* find the tiles overlapped by the bounding box */
+	float min_x = fmaxf(std::min({a->x, b->x, c->x}), 0.f);
+	float max_x = fminf(std::max({a->x, b->x, c->x}), width - 1);
+	float min_y = fmaxf(std::min({a->y, b->y, c->y}), 0.f);
+	float max_y = fminf(std::max({a->y, b->y, c->y}), height - 1);
+	if (min_x > max_x || min_y > max_y) return;
+	int start_x = static_cast<int>(min_x) / TILE_WIDTH;
+	int end_x = static_cast<int>(max_x) / TILE_WIDTH;
+	int start_y = static_cast<int>(min_y) / TILE_HEIGHT;
+	int end_y = static_cast<int>(max_y) / TILE_HEIGHT;
+	
+	/* calculate the edge functions which are positive inside */
+	const Vec3* vertices[4] = {a, b, c, a};
+	float edge_x[3];
+	float edge_y[3];
+	float edge_c[3];
+	for (int k = 0; k < 3; ++k) {
+		auto& p = *vertices[k];
+		auto& q = *vertices[k + 1];
+		edge_x[k] = p.y - q.y;
+		edge_y[k] = q.x - p.x;
+		edge_c[k] = -edge_x[k] * p.x - edge_y[k] * p.y;
+	}
+	
+	/* calculate the depth plane and the maximum depth of triangle */
+	float dzdx = ((b->z - a->z) * (c->y - a->y) - (c->z - a->z) * (b->y - a->y)) / area;
+	float dzdy = ((c->z - a->z) * (b->x - a->x) - (b->z - a->z) * (c->x - a->x)) / area;
+	float max_z = std::max({a->z, b->z, c->z});
+	
+	for (int ty = start_y; ty <= end_y; ++ty) {
+		for (int tx = start_x; tx <= end_x; ++tx) {
+			int pixel_x = tx * TILE_WIDTH;
+			int pixel_y = ty * TILE_HEIGHT;
+			
+			/* calculate the coverage mask of pixel centers */
+			uint32_t mask = 0;
+			uint32_t padding = 0;
+			for (int y = 0; y < TILE_HEIGHT; ++y) {
+				for (int x = 0; x < TILE_WIDTH; ++x) {
+					uint32_t bit = 1u << (y * TILE_WIDTH + x);
+					float center_x = pixel_x + x + 0.5f;
+					float center_y = pixel_y + y + 0.5f;
+					if (pixel_x + x >= width || pixel_y + y >= height) padding |= bit;
+					bool inside = true;
+					for (int k = 0; k < 3; ++k) {
+						inside = inside && edge_x[k] * center_x + edge_y[k] * center_y + edge_c[k] > 0;
+					}
+					if (inside) mask |= bit;
+				}
+			}
+			if (mask == 0) continue;
+			
+			/* the maximum depth of triangle on the corners of tile */
+			float corner_x = dzdx > 0 ? pixel_x + TILE_WIDTH : pixel_x;
+			float corner_y = dzdy > 0 ? pixel_y + TILE_HEIGHT : pixel_y;
+			float tile_z = a->z + dzdx * (corner_x - a->x) + dzdy * (corner_y - a->y);
+			
+			/* treat the pixels outside of buffer as covered */
+			update_tile(ty * tile_x + tx, mask | padding, fminf(tile_z, max_z));
+		}
+	}
+}
+
+void OcclusionBuffer::update_tile(int t, uint32_t m, float z) {
+	/* the triangle behind the reference layer occludes nothing new */
+	float& reference_depth = reference_depths[t];
+	float& working_depth = working_depths[t];
+	uint32_t& mask = masks[t];
+	if (z >= reference_depth) return;
+	
+	/* discard the working layer if the triangle is much closer */
+	if (mask != 0 && working_depth - z > reference_depth - working_depth) {
+		mask = 0;
+		working_depth = 0;
+	}
+	
+	/* merge the triangle into the working layer */
+	working_depth = fmaxf(working_depth, z);
+	mask |= m;
+	
+	/* the working layer becomes the reference when it covers the tile */
+	if (mask == FULL_MASK) {
+		reference_depth = working_depth;
+		working_depth = 0;
+		mask = 0;
+	}
+}
+
+static float saturate(float v) {
+	return std::clamp(v, 0.f, 1.f);
+}
+
+static float smoothstep(float e0, float e1, float v) {
+	float t = saturate((v - e0) / (e1 - e0));
+	return t * t * (3 - 2 * t);
+}
+
+static bool compare_depth(ComparisonFunc f, float z, float d) {
+	switch (f) {
+		case FUNC_NEVER:    return false;
+		case FUNC_LESS:     return z < d;
+		case FUNC_EQUAL:    return z == d;
+		case FUNC_LEQUAL:   return z <= d;
+		case FUNC_GREATER:  return z > d;
+		case FUNC_NOTEQUAL: return z != d;
+		case FUNC_GEQUAL:   return z >= d;
+		default:            return true;
+	}
+}
+
+static ShadingVertex mix_vertex(const ShadingVertex& v1, const ShadingVertex& v2, float t) {
+	ShadingVertex v;
+	v.position = v1.position * (1 - t) + v2.position * t;
+	v.world_position = v1.world_position * (1 - t) + v2.world_position * t;
+	v.normal = v1.normal * (1 - t) + v2.normal * t;
+	v.tangent = v1.tangent * (1 - t) + v2.tangent * t;
+	v.bitangent = v1.bitangent * (1 - t) + v2.bitangent * t;
+	v.uv = v1.uv * (1 - t) + v2.uv * t;
+	v.color = v1.color * (1 - t) + v2.color * t;
+	return v;
+}
+
+static int clip_near_plane(const ShadingVertex* i, ShadingVertex* o) {
+	int size = 0;
+	for (int l = 0; l < 3; ++l) {
+		auto& vertex_1 = i[l];
+		auto& vertex_2 = i[(l + 1) % 3];
+		float distance_1 = vertex_1.position.z + vertex_1.position.w;
+		float distance_2 = vertex_2.position.z + vertex_2.position.w;
+		
+		/* vertices are both outside */
+		if (distance_1 < 0 && distance_2 < 0) continue;
+		
+		/* vertices are both inside */
+		if (distance_1 >= 0 && distance_2 >= 0) {
+			o[size++] = vertex_2;
+			continue;
+		}
+		
+		/* add the intersection with the near plane */
+		o[size++] = mix_vertex(vertex_1, vertex_2, distance_1 / (distance_1 - distance_2));
+		
+		/* traveling from outside to inside */
+		if (distance_2 >= 0) o[size++] = vertex_2;
+	}
+	return size;
+}
+
+/* Returns the value of GGX BRDF like brdf_ggx in BRDF.glsl. */
+static Vec3 brdf_ggx(const Vec3& l, const Vec3& v, const Vec3& n, const Vec3& f0, float r) {
+	float a = r * r;
+	float a2 = a * a;
+	Vec3 h = (l + v).normalize();
+	float nol = saturate(n.dot(l));
+	float nov = saturate(n.dot(v));
+	float noh = saturate(n.dot(h));
+	float voh = saturate(v.dot(h));
+	
+	/* geometry with GGX-Smith model */
+	float gv = nol * sqrtf(a2 + (1 - a2) * nov * nov);
+	float gl = nov * sqrtf(a2 + (1 - a2) * nol * nol);
+	float g = 0.5f / std::max(gv + gl, SHADING_EPSILON);
+	
+	/* NDF with GGX model */
+	float d = noh * noh * (a2 - 1) + 1;
+	d = a2 / (PI * d * d);
+	
+	/* Fresnel with Schlick's approximation */
+	float fresnel = exp2f((-5.55473f * voh - 6.98316f) * voh);
+	return (f0 * (1 - fresnel) + fresnel) * (g * d);
+}
+
+/* Calculates direct light like lighting_direct in Lights.glsl. */
+static Vec3 lighting_direct(const Vec3& c, const Vec3& f0, float r, const Vec3& l, const Vec3& v, const Vec3& n) {
+	float nol = saturate(n.dot(l));
+	if (nol <= 0) return Vec3(0);
+	return (brdf_ggx(l, v, n, f0, r) + c * (1 / PI)) * nol;
+}
+
+static float attenuate(float d, float m, float e) {
+	if (m > 0 && e > 0) return powf(saturate(1 - d / m), e);
+	return 1;
+}
+
+static bool shade(const ShadingTriangle& t, const ShadingLights& l, const ShadingVertex& f,
+				  const Vec2& dx, const Vec2& dy, Vec4& o) {
+	const ShadingMaterial& m = *t.material;
+	const Material& material = *m.material;
+	auto sample = [&](const Texture* texture) -> Vec4 {
+		return texture->sample(f.uv, texture->get_lod(dx, dy));
+	};
+	
+	/* calculate color and alpha */
+	Vec4 color = Vec4(material.color, material.alpha);
+	if (material.use_vertex_color) {
+		color = Vec4(Vec3(color.x, color.y, color.z) * f.color, color.w);
+	}
+	if (m.color_map != nullptr) {
+		Vec4 texel = sample(m.color_map);
+		if (!material.use_map_with_alpha) texel.w = 1;
+		color *= texel;
+	}
+	if (m.alpha_map != nullptr) {
+		color.w *= sample(m.alpha_map).x;
+	}
+	
+	/* discard if failing alpha test */
+	if (color.w < material.alpha_test) return false;
+	
+	/* calculate normal in world space */
+	float face_dir = t.front ? 1 : -1;
+	Vec3 normal = f.normal.normalize() * face_dir;
+	if (m.normal_map != nullptr) {
+		Vec4 texel = sample(m.normal_map);
+		Vec3 map_normal = (Vec3(texel.x, texel.y, texel.z) * 2 - 1).normalize();
+		map_normal.x *= material.normal_scale;
+		map_normal.y *= material.normal_scale;
+		if (material.use_tangent_space && t.use_tangent) {
+			Vec3 tangent = f.tangent.normalize() * face_dir;
+			Vec3 bitangent = f.bitangent.normalize() * face_dir;
+			normal = (tangent * map_normal.x + bitangent * map_normal.y + normal * map_normal.z).normalize();
+		} else if (!material.use_tangent_space) {
+			normal = Vec3(*t.normal_matrix * map_normal).normalize();
+		}
+	}
+	
+	/* calculate metalness, roughness, specular IOR and emissive color */
+	float metalness = material.metalness;
+	if (m.metalness_map != nullptr) metalness *= sample(m.metalness_map).x;
+	float roughness = material.roughness;
+	if (m.roughness_map != nullptr) roughness *= sample(m.roughness_map).x;
+	roughness = std::max(roughness, MIN_ROUGHNESS);
+	float specular = material.specular;
+	if (m.specular_map != nullptr) specular *= sample(m.specular_map).x;
+	Vec3 emissive = material.emissive * material.emissive_intensity;
+	if (m.emissive_map != nullptr) {
+		Vec4 texel = sample(m.emissive_map);
+		emissive *= Vec3(texel.x, texel.y, texel.z);
+	}
+	
+	/* calculate ambient occlusion */
+	float occlusion = 1;
+	if (m.ao_map != nullptr) {
+		occlusion = (sample(m.ao_map).x - 1) * material.ao_intensity + 1;
+	}
+	
+	/* calculate diffuse color and specular F0 */
+	Vec3 base_color = Vec3(color.x, color.y, color.z);
+	Vec3 diffuse = base_color * (1 - metalness);
+	Vec3 specular_f0 = Vec3(specular * 0.08f) * (1 - metalness) + base_color * metalness;
+	
+	/* view from position to camera position */
+	Vec3 view_dir = (l.camera_position - f.world_position).normalize();
+	
+	/* apply point lights */
+	Vec3 direct_light = Vec3(0);
+	for (auto& light : l.point_lights) {
+		Vec3 light_dir = light.position - f.world_position;
+		float light_distance = light_dir.magnitude();
+		float attenuation = attenuate(light_distance, light.distance, light.decay);
+		if (attenuation <= 0 || light_distance <= 0) continue;
+		light_dir /= light_distance;
+		direct_light += light.color * attenuation *
+			lighting_direct(diffuse, specular_f0, roughness, light_dir, view_dir, normal);
+	}
+	
+	/* apply spot lights */
+	for (auto& light : l.spot_lights) {
+		Vec3 light_dir = light.position - f.world_position;
+		float light_distance = light_dir.magnitude();
+		if (light_distance <= 0) continue;
+		light_dir /= light_distance;
+		float attenuation = smoothstep(light.angle, light.penumbra, light_dir.dot(light.direction));
+		attenuation *= attenuate(light_distance, light.distance, light.decay);
+		if (attenuation <= 0) continue;
+		direct_light += light.color * attenuation *
+			lighting_direct(diffuse, specular_f0, roughness, light_dir, view_dir, normal);
+	}
+	
+	/* apply directional lights */
+	for (auto& light : l.directional_lights) {
+		direct_light += light.color *
+			lighting_direct(diffuse, specular_f0, roughness, light.direction, view_dir, normal);
+	}
+	
+	/* apply hemisphere lights as indirect light */
+	Vec3 indirect_light = emissive;
+	for (auto& light : l.hemisphere_lights) {
+		float weight = normal.dot(light.direction) * 0.5f + 0.5f;
+		Vec3 light_color = light.ground_color * (1 - weight) + light.sky_color * weight;
+		indirect_light += light_color * diffuse * (1 / PI);
+	}
+	
+	/* output color with alpha */
+	o = Vec4(direct_light + indirect_light * occlusion, color.w);
+	return true;
+}
+
+static void shade_triangle(const ShadingTriangle& t, const ShadingLights& l, int x1, int y1, int x2, int y2,
+						   int w, Vec4* c, float* d) {
+	/* snap the vertices to fixed-point subpixels */
+	int64_t x[3];
+	int64_t y[3];
+	for (int k = 0; k < 3; ++k) {
+		x[k] = static_cast<int64_t>(t.coords[k].x * SUBPIXEL_SCALE + SNAPPING_BIAS) - SNAPPING_OFFSET;
+		y[k] = static_cast<int64_t>(t.coords[k].y * SUBPIXEL_SCALE + SNAPPING_BIAS) - SNAPPING_OFFSET;
+	}
+	
+	/* make the triangle counter-clockwise, and keep the vertex order */
+	int order[3] = {0, 1, 2};
+	int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0) return;
+	if (area < 0) {
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+		std::swap(order[1], order[2]);
+		area = -area;
+	}
+	
+	/* find the pixels inside the bounding box and the bin */
+	int min_x = std::max(x1, static_cast<int>(std::min({x[0], x[1], x[2]}) >> SUBPIXEL_BITS));
+	int max_x = std::min(x2, static_cast<int>(std::max({x[0], x[1], x[2]}) >> SUBPIXEL_BITS) + 1);
+	int min_y = std::max(y1, static_cast<int>(std::min({y[0], y[1], y[2]}) >> SUBPIXEL_BITS));
+	int max_y = std::min(y2, static_cast<int>(std::max({y[0], y[1], y[2]}) >> SUBPIXEL_BITS) + 1);
+	if (min_x >= max_x || min_y >= max_y) return;
+	
+	/* calculate the edge functions with the top-left fill rule */
+	int64_t edge_x[3];
+	int64_t edge_y[3];
+	int64_t edge_bias[3];
+	int64_t edge_rows[3];
+	int64_t center_x = (static_cast<int64_t>(min_x) << SUBPIXEL_BITS) + SUBPIXEL_SCALE / 2;
+	int64_t center_y = (static_cast<int64_t>(min_y) << SUBPIXEL_BITS) + SUBPIXEL_SCALE / 2;
+	for (int k = 0; k < 3; ++k) {
+		int l = (k + 1) % 3;
+		edge_x[k] = y[k] - y[l];
+		edge_y[k] = x[l] - x[k];
+		bool top_left = edge_x[k] > 0 || (edge_x[k] == 0 && edge_y[k] > 0);
+		edge_bias[k] = top_left ? 0 : -1;
+		edge_rows[k] = edge_x[k] * (center_x - x[k]) + edge_y[k] * (center_y - y[k]);
+	}
+	
+	/* the edge function of an edge is the weight of the opposite vertex */
+	int weight_ids[3];
+	float weight_steps_x[3];
+	float weight_steps_y[3];
+	float inverse_area = 1.f / static_cast<float>(area);
+	for (int k = 0; k < 3; ++k) {
+		weight_ids[k] = order[(k + 2) % 3];
+		weight_steps_x[k] = static_cast<float>(edge_x[k] * SUBPIXEL_SCALE) * inverse_area;
+		weight_steps_y[k] = static_cast<float>(edge_y[k] * SUBPIXEL_SCALE) * inverse_area;
+	}
+	
+	/* interpolates the vertex attributes with perspective correction */
+	const Material& material = *t.material->material;
+	auto perspective_uv = [&](const float* b) -> Vec2 {
+		float p[3];
+		for (int k = 0; k < 3; ++k) p[weight_ids[k]] = b[k] * t.inverse_w[weight_ids[k]];
+		float sum = p[0] + p[1] + p[2];
+		return (t.vertices[0].uv * p[0] + t.vertices[1].uv * p[1] + t.vertices[2].uv * p[2]) / sum;
+	};
+	
+	/* rasterize and shade the pixels overlapped by the bounding box */
+	for (int py = min_y; py < max_y; ++py) {
+		int64_t edges[3] = {edge_rows[0], edge_rows[1], edge_rows[2]};
+		for (int px = min_x; px < max_x; ++px) {
+			bool inside = edges[0] + edge_bias[0] >= 0 && edges[1] + edge_bias[1] >= 0 && edges[2] + edge_bias[2] >= 0;
+			float b[3] = {edges[0] * inverse_area, edges[1] * inverse_area, edges[2] * inverse_area};
+			for (int k = 0; k < 3; ++k) edges[k] += edge_x[k] * SUBPIXEL_SCALE;
+			if (!inside) continue;
+			
+			/* depth test with the screen-space interpolated depth */
+			int index = py * w + px;
+			float depth = 0;
+			for (int k = 0; k < 3; ++k) depth += b[k] * t.coords[weight_ids[k]].z;
+			if (material.depth_test && !compare_depth(material.depth_func, depth, d[index])) continue;
+			
+			/* calculate the perspective-correct weights */
+			float p[3];
+			for (int k = 0; k < 3; ++k) p[weight_ids[k]] = b[k] * t.inverse_w[weight_ids[k]];
+			float sum = p[0] + p[1] + p[2];
+			p[0] /= sum;
+			p[1] /= sum;
+			p[2] /= sum;
+			
+			/* interpolate the vertex attributes */
+			ShadingVertex fragment;
+			auto& v = t.vertices;
+			fragment.world_position = v[0].world_position * p[0] + v[1].world_position * p[1] + v[2].world_position * p[2];
+			fragment.normal = v[0].normal * p[0] + v[1].normal * p[1] + v[2].normal * p[2];
+			fragment.tangent = v[0].tangent * p[0] + v[1].tangent * p[1] + v[2].tangent * p[2];
+			fragment.bitangent = v[0].bitangent * p[0] + v[1].bitangent * p[1] + v[2].bitangent * p[2];
+			fragment.uv = v[0].uv * p[0] + v[1].uv * p[1] + v[2].uv * p[2];
+			fragment.color = v[0].color * p[0] + v[1].color * p[1] + v[2].color * p[2];
+			
+			/* calculate the derivatives of UV with the neighbor pixels */
+			Vec2 uv_dx = Vec2(0, 0);
+			Vec2 uv_dy = Vec2(0, 0);
+			if (t.material->use_textures) {
+				float b_x[3] = {b[0] + weight_steps_x[0], b[1] + weight_steps_x[1], b[2] + weight_steps_x[2]};
+				float b_y[3] = {b[0] + weight_steps_y[0], b[1] + weight_steps_y[1], b[2] + weight_steps_y[2]};
+				uv_dx = perspective_uv(b_x) - fragment.uv;
+				uv_dy = perspective_uv(b_y) - fragment.uv;
+			}
+			
+			/* shade the pixel and write to the buffers */
+			Vec4 color;
+			if (!shade(t, l, fragment, uv_dx, uv_dy, color)) continue;
+			c[index] = material.blending ? color * color.w + c[index] * (1 - color.w) : color;
+			if (material.depth_test) d[index] = depth;
+		}
+		for (int k = 0; k < 3; ++k) edge_rows[k] += edge_y[k] * SUBPIXEL_SCALE;
+	}
+}
+
+Texture::Texture(const Image& i) {
+	/* check the format of image */
+	if (i.bytes != 1 && i.bytes != 4) {
+		Error::set("Texture", "Image's bytes must be 1 or 4");
+		return;
+	}
+	if (i.width <= 0 || i.height <= 0 || i.channel <= 0) {
+		Error::set("Texture", "Image is empty");
+		return;
+	}
+	
+	/* generate the mipmaps with box filter until 1x1 */
+	levels.emplace_back(i);
+	while (levels.back().width > 1 || levels.back().height > 1) {
+		const Image& level = levels.back();
+		Image next = Image(std::max(level.width / 2, 1), std::max(level.height / 2, 1), level.channel, level.bytes);
+		for (int y = 0; y < next.height; ++y) {
+			for (int x = 0; x < next.width; ++x) {
+				int x1 = std::min(x * 2, level.width - 1);
+				int x2 = std::min(x * 2 + 1, level.width - 1);
+				int y1 = std::min(y * 2, level.height - 1);
+				int y2 = std::min(y * 2 + 1, level.height - 1);
+				for (int c = 0; c < level.channel; ++c) {
+					int index = (y * next.width + x) * next.channel + c;
+					int index_11 = (y1 * level.width + x1) * level.channel + c;
+					int index_21 = (y1 * level.width + x2) * level.channel + c;
+					int index_12 = (y2 * level.width + x1) * level.channel + c;
+					int index_22 = (y2 * level.width + x2) * level.channel + c;
+					if (level.bytes == 1) {
+						auto* texels = level.data.data();
+						int sum = texels[index_11] + texels[index_21] + texels[index_12] + texels[index_22];
+						next.data[index] = static_cast<uint8_t>((sum + 2) / 4);
+					} else {
+						auto* texels = reinterpret_cast<const float*>(level.data.data());
+						float sum = texels[index_11] + texels[index_21] + texels[index_12] + texels[index_22];
+						reinterpret_cast<float*>(next.data.data())[index] = sum * 0.25f;
+					}
+				}
+			}
+		}
+		levels.emplace_back(std::move(next));
+	}
+}
+
+int Texture::get_width() const {
+	return levels.empty() ? 0 : levels[0].width;
+}
+
+int Texture::get_height() const {
+	return levels.empty() ? 0 : levels[0].height;
+}
+
+int Texture::get_levels() const {
+	return static_cast<int>(levels.size());
+}
+
+float Texture::get_lod(const Vec2& x, const Vec2& y) const {
+	if (levels.empty()) return 0;
+	float width = static_cast<float>(levels[0].width);
+	float height = static_cast<float>(levels[0].height);
+	float length_x = x.x * x.x * width * width + x.y * x.y * height * height;
+	float length_y = y.x * y.x * width * width + y.y * y.y * height * height;
+	float length = std::max(length_x, length_y);
+	return length > 1 ? 0.5f * log2f(length) : 0;
+}
+
+Vec4 Texture::sample(const Vec2& uv, float l) const {
+	if (levels.empty()) return Vec4(0, 0, 0, 1);
+	
+	/* sample the nearest level or blend two levels */
+	float lod = std::clamp(l, 0.f, static_cast<float>(levels.size() - 1));
+	int level = static_cast<int>(lod);
+	float weight = lod - level;
+	if (weight == 0) return sample_level(level, uv);
+	return sample_level(level, uv) * (1 - weight) + sample_level(level + 1, uv) * weight;
+}
+
+Vec4 Texture::fetch(const Image& i, int x, int y) const {
+	float texel[4] = {0, 0, 0, 1};
+	int index = (y * i.width + x) * i.channel;
+	int channel = std::min(i.channel, 4);
+	for (int c = 0; c < channel; ++c) {
+		texel[c] = i.bytes == 1 ? i.data[index + c] * (1 / 255.f) :
+			reinterpret_cast<const float*>(i.data.data())[index + c];
 	}
+	return Vec4(texel[0], texel[1], texel[2], texel[3]);
+}
+
+Vec4 Texture::sample_level(int l, const Vec2& uv) const {
+	const Image& level = levels[l];
+	
+	/* find the four texels around the UV */
+	float u = uv.x * level.width - 0.5f;
+	float v = uv.y * level.height - 0.5f;
+	float floor_u = floorf(u);
+	float floor_v = floorf(v);
+	float weight_u = u - floor_u;
+	float weight_v = v - floor_v;
+	
+	/* wrap the texels with repeat mode */
+	int x1 = static_cast<int>(floor_u) % level.width;
+	int y1 = static_cast<int>(floor_v) % level.height;
+	if (x1 < 0) x1 += level.width;
+	if (y1 < 0) y1 += level.height;
+	int x2 = x1 + 1 == level.width ? 0 : x1 + 1;
+	int y2 = y1 + 1 == level.height ? 0 : y1 + 1;
+	
+	/* blend the texels with bilinear filter */
+	Vec4 texel_1 = fetch(level, x1, y1) * (1 - weight_u) + fetch(level, x2, y1) * weight_u;
+	Vec4 texel_2 = fetch(level, x1, y2) * (1 - weight_u) + fetch(level, x2, y2) * weight_u;
+	return texel_1 * (1 - weight_v) + texel_2 * weight_v;
+}
+
+Vec4 Renderer::get_clear_color() const {
+	return clear_color;
+}
+
+void Renderer::set_clear_color(const Vec4& c) {
+	clear_color = c;
+}
+
+int Renderer::get_thread_count() const {
+	return thread_count;
+}
+
+void Renderer::set_thread_count(int n) {
+	thread_count = n;
+}
+
+void Renderer::clear_image_caches() {
+	image_cache.clear();
+}
+
+void Renderer::render(const Scene& s, const Camera& c, Image& i) const {
+	/* check the format of color buffer */
+	if (i.channel != 4 || (i.bytes != 1 && i.bytes != 4)) {
+		return Error::set("Renderer", "Color buffer must have 4 channels and 1 or 4 bytes");
+	}
+	int width = i.width;
+	int height = i.height;
+	if (width <= 0 || height <= 0) return;
+	
+	/* prepare the visible lights like the light block of GPU renderer */
+	ShadingLights lights;
+	lights.camera_position = c.position;
+	for (int k = 0; k < s.get_point_light_count(); ++k) {
+		auto& light = *s.get_point_light(k);
+		if (!light.visible) continue;
+		lights.point_lights.push_back({light.position, light.color * light.intensity * PI,
+			light.distance, light.decay});
+	}
+	for (int k = 0; k < s.get_spot_light_count(); ++k) {
+		auto& light = *s.get_spot_light(k);
+		if (!light.visible) continue;
+		lights.spot_lights.push_back({light.position, -light.direction.normalize(),
+			light.color * light.intensity * PI, light.distance, light.decay,
+			cosf(light.angle), cosf(light.angle * (1 - light.penumbra))});
+	}
+	for (int k = 0; k < s.get_directional_light_count(); ++k) {
+		auto& light = *s.get_directional_light(k);
+		if (!light.visible) continue;
+		lights.directional_lights.push_back({-light.direction.normalize(), light.color * light.intensity * PI});
+	}
+	for (int k = 0; k < s.get_hemisphere_light_count(); ++k) {
+		auto& light = *s.get_hemisphere_light(k);
+		if (!light.visible) continue;
+		lights.hemisphere_lights.push_back({light.direction, light.color * light.intensity * PI,
+			light.ground_color * light.intensity * PI});
+	}
+	
+	/* collect the visible mesh groups and create the textures of materials */
+	struct Batch {
+		const Mesh* mesh = nullptr;
+		Mat4 model_view_proj;
+		Mat4 model;
+		Mat3 normal_matrix;
+		int vertex_offset = 0;
+	};
+	struct Draw {
+		int batch = 0;
+		int position = 0;
+		int triangle_offset = 0;
+		const ShadingMaterial* material = nullptr;
+	};
+	std::vector<Batch> batches;
+	std::vector<Draw> draws;
+	std::unordered_map<const Material*, ShadingMaterial> materials;
+	int vertex_count = 0;
+	int triangle_count = 0;
+	s.to_visible_instances(c, visible_instances);
+	for (auto* instance : visible_instances) {
+		const Mesh* mesh = instance->mesh;
+		if (mesh == nullptr) continue;
+		int batch = -1;
+		int group_count = static_cast<int>(mesh->groups.size());
+		for (int g = 0; g < group_count; ++g) {
+			auto& group = mesh->groups[g];
+			auto* material = s.get_material(*instance, g);
+			if (material == nullptr || !material->visible || group.length < 3) continue;
+			
+			/* create the batch of instance when the first group is drawn */
+			if (batch == -1) {
+				auto& model = instance->matrix_global;
+				batch = static_cast<int>(batches.size());
+				batches.push_back({mesh, c.projection * c.viewing * model, model, inverse_3x3(Mat3{
+					model[0][0], model[1][0], model[2][0],
+					model[0][1], model[1][1], model[2][1],
+					model[0][2], model[1][2], model[2][2],
+				}), vertex_count});
+				vertex_count += static_cast<int>(mesh->vertex.size());
+			}
+			
+			/* create the textures when the material is first used */
+			auto iter = materials.find(material);
+			if (iter == materials.end()) {
+				ShadingMaterial m;
+				m.material = material;
+				m.normal_map = get_texture(material->normal_map);
+				m.color_map = get_texture(material->color_map);
+				m.alpha_map = get_texture(material->alpha_map);
+				m.roughness_map = get_texture(material->roughness_map);
+				m.metalness_map = get_texture(material->metalness_map);
+				m.specular_map = get_texture(material->specular_map);
+				m.emissive_map = get_texture(material->emissive_map);
+				m.ao_map = get_texture(material->ao_map);
+				m.use_textures = m.normal_map != nullptr || m.color_map != nullptr || m.alpha_map != nullptr ||
+					m.roughness_map != nullptr || m.metalness_map != nullptr || m.specular_map != nullptr ||
+					m.emissive_map != nullptr || m.ao_map != nullptr;
+				iter = materials.insert({material, m}).first;
+			}
+			draws.push_back({batch, group.position, triangle_count, &iter->second});
+			triangle_count += group.length / 3;
+		}
+	}
+	
+	/* decide the number of tasks by the number of triangles */
+	int task_count = get_task_count(thread_count, triangle_count);
+	
+	/* transform the vertices of batches in parallel */
+	std::vector<ShadingVertex> vertices(vertex_count);
+	WorkerPool::run(task_count, [&](int t) -> void {
+		int start = static_cast<int>(static_cast<int64_t>(vertex_count) * t / task_count);
+		int end = static_cast<int>(static_cast<int64_t>(vertex_count) * (t + 1) / task_count);
+		for (auto& batch : batches) {
+			auto& mesh = *batch.mesh;
+			int offset = batch.vertex_offset;
+			int first = std::max(start - offset, 0);
+			int last = std::min(end - offset, static_cast<int>(mesh.vertex.size()));
+			for (int k = first; k < last; ++k) {
+				auto& vertex = vertices[offset + k];
+				vertex.position = batch.model_view_proj * Vec4(mesh.vertex[k], 1);
+				vertex.world_position = Vec3(batch.model * Vec4(mesh.vertex[k], 1));
+				vertex.normal = k < mesh.normal.size() ? Vec3(batch.normal_matrix * mesh.normal[k]).normalize() : Vec3(0, 0, 1);
+				vertex.uv = k < mesh.uv.size() ? mesh.uv[k] : Vec2(0, 0);
+				vertex.color = k < mesh.color.size() ? mesh.color[k] : Vec3(1, 1, 1);
+				if (k < mesh.tangent.size()) {
+					auto& tangent = mesh.tangent[k];
+					vertex.tangent = Vec3(batch.model * Vec4(tangent.x, tangent.y, tangent.z, 0)).normalize();
+					vertex.bitangent = vertex.normal.cross(vertex.tangent).normalize() * tangent.w;
+				}
+			}
+		}
+	});
+	
+	/* find the bins of color buffer aligned to the tiles, or one bin for one task */
+	int bin_width = task_count == 1 ? width : BIN_SIZE;
+	int bin_height = task_count == 1 ? height : BIN_SIZE;
+	int bin_x = (width - 1) / bin_width + 1;
+	int bin_y = (height - 1) / bin_height + 1;
+	int bin_count = bin_x * bin_y;
+	
+	/* clip, cull and bin the triangles in parallel */
+	auto& bins = get_bins<ShadingTriangle>(task_count, bin_count);
+	WorkerPool::run(task_count, [&](int t) -> void {
+		auto& triangles = bins.triangles[t];
+		auto& indices = bins.indices[t];
+		ShadingVertex primitives[3];
+		ShadingVertex clipped[4];
+		Vec3 device_coords[4];
+		float inverse_w[4];
+		int start = static_cast<int>(static_cast<int64_t>(triangle_count) * t / task_count);
+		int end = static_cast<int>(static_cast<int64_t>(triangle_count) * (t + 1) / task_count);
+		auto draw_iter = std::upper_bound(draws.begin(), draws.end(), start, [](int v, const Draw& d) -> bool {
+			return v < d.triangle_offset;
+		}) - 1;
+		for (int k = start; k < end; ++k) {
+			while (draw_iter + 1 != draws.end() && (draw_iter + 1)->triangle_offset <= k) ++draw_iter;
+			auto& draw = *draw_iter;
+			auto& batch = batches[draw.batch];
+			auto& mesh = *batch.mesh;
+			auto& material = *draw.material->material;
+			
+			/* fetch the transformed vertices */
+			int position = draw.position + (k - draw.triangle_offset) * 3;
+			for (int j = 0; j < 3; ++j) {
+				int index = mesh.indices.empty() ? position + j : mesh.indices[position + j];
+				primitives[j] = vertices[batch.vertex_offset + index];
+			}
+			
+			/* skip the triangle outside of a side plane */
+			auto& p0 = primitives[0].position;
+			auto& p1 = primitives[1].position;
+			auto& p2 = primitives[2].position;
+			if (p0.x > p0.w && p1.x > p1.w && p2.x > p2.w) continue;
+			if (p0.x < -p0.w && p1.x < -p1.w && p2.x < -p2.w) continue;
+			if (p0.y > p0.w && p1.y > p1.w && p2.y > p2.w) continue;
+			if (p0.y < -p0.w && p1.y < -p1.w && p2.y < -p2.w) continue;
+			
+			/* clip near plane */
+			int number = clip_near_plane(primitives, clipped);
+			if (number < 3) continue;
+			
+			/* perspective division & viewport transform */
+			for (int j = 0; j < number; ++j) {
+				auto& clip_coord = clipped[j].position;
+				inverse_w[j] = 1 / clip_coord.w;
+				device_coords[j].x = (clip_coord.x * inverse_w[j] * 0.5f + 0.5f) * width;
+				device_coords[j].y = (clip_coord.y * inverse_w[j] * 0.5f + 0.5f) * height;
+				device_coords[j].z = clip_coord.z * inverse_w[j] * 0.5f + 0.5f;
+			}
+			
+			/* cull the faces by the counter-clockwise winding */
+			float area = (device_coords[1].x - device_coords[0].x) * (device_coords[2].y - device_coords[0].y) -
+				(device_coords[1].y - device_coords[0].y) * (device_coords[2].x - device_coords[0].x);
+			bool front = area > 0;
+			if (material.side == FRONT_SIDE && !front) continue;
+			if (material.side == BACK_SIDE && front) continue;
+			
+			/* add the triangles of polygon to the bins they overlap */
+			for (int j = 2; j < number; ++j) {
+				int ids[3] = {0, j - 1, j};
+				auto& v1 = device_coords[ids[0]];
+				auto& v2 = device_coords[ids[1]];
+				auto& v3 = device_coords[ids[2]];
+				float lower_x = std::max(std::min({v1.x, v2.x, v3.x}), 0.f);
+				float upper_x = std::min(std::max({v1.x, v2.x, v3.x}), static_cast<float>(width - 1));
+				float lower_y = std::max(std::min({v1.y, v2.y, v3.y}), 0.f);
+				float upper_y = std::min(std::max({v1.y, v2.y, v3.y}), static_cast<float>(height - 1));
+				if (!(lower_x <= upper_x && lower_y <= upper_y)) continue;
+				int triangle = static_cast<int>(triangles.size());
+				auto& shading_triangle = triangles.emplace_back();
+				for (int l = 0; l < 3; ++l) {
+					shading_triangle.vertices[l] = clipped[ids[l]];
+					shading_triangle.coords[l] = device_coords[ids[l]];
+					shading_triangle.inverse_w[l] = inverse_w[ids[l]];
+				}
+				shading_triangle.front = front;
+				shading_triangle.use_tangent = !mesh.tangent.empty();
+				shading_triangle.normal_matrix = &batch.normal_matrix;
+				shading_triangle.material = draw.material;
+				int start_x = static_cast<int>(lower_x) / bin_width;
+				int end_x = static_cast<int>(upper_x) / bin_width;
+				int start_y = static_cast<int>(lower_y) / bin_height;
+				int end_y = static_cast<int>(upper_y) / bin_height;
+				for (int y = start_y; y <= end_y; ++y) {
+					for (int x = start_x; x <= end_x; ++x) indices[y * bin_x + x].emplace_back(triangle);
+				}
+			}
+		}
+	});
+	
+	/* shade the bins in parallel, the bins never share a pixel */
+	std::vector<Vec4> colors(static_cast<size_t>(width) * height, clear_color);
+	std::vector<float> depths(static_cast<size_t>(width) * height, 1.f);
+	std::atomic<int> next_bin = 0;
+	WorkerPool::run(task_count, [&](int) -> void {
+		for (int bin = next_bin++; bin < bin_count; bin = next_bin++) {
+			int x1 = bin % bin_x * bin_width;
+			int y1 = bin / bin_x * bin_height;
+			int x2 = std::min(x1 + bin_width, width);
+			int y2 = std::min(y1 + bin_height, height);
+			
+			/* shade the opaque triangles, then the blended triangles */
+			for (int pass = 0; pass < 2; ++pass) {
+				for (int t = 0; t < task_count; ++t) {
+					auto& triangles = bins.triangles[t];
+					for (int triangle : bins.indices[t][bin]) {
+						auto& shading_triangle = triangles[triangle];
+						if (shading_triangle.material->material->blending != (pass == 1)) continue;
+						shade_triangle(shading_triangle, lights, x1, y1, x2, y2, width, colors.data(), depths.data());
+					}
+				}
+			}
+			
+			/* write the colors of bin to the color buffer */
+			for (int y = y1; y < y2; ++y) {
+				for (int x = x1; x < x2; ++x) {
+					int index = y * width + x;
+					Vec4 color = colors[index];
+					if (i.bytes == 4) {
+						reinterpret_cast<Vec4*>(i.data.data())[index] = color;
+						continue;
+					}
+					Vec3 srgb = Color::rgb_to_srgb(Vec3(saturate(color.x), saturate(color.y), saturate(color.z)));
+					uint8_t* pixel = i.data.data() + index * 4;
+					pixel[0] = static_cast<uint8_t>(srgb.x * 255 + 0.5f);
+					pixel[1] = static_cast<uint8_t>(srgb.y * 255 + 0.5f);
+					pixel[2] = static_cast<uint8_t>(srgb.z * 255 + 0.5f);
+					pixel[3] = static_cast<uint8_t>(saturate(color.w) * 255 + 0.5f);
+				}
+			}
+		}
+	});
+}
+
+const Texture* Renderer::get_texture(const Image* i) const {
+	if (i == nullptr) return nullptr;
+	auto& texture = image_cache[i];
+	if (!texture) texture = std::make_unique<Texture>(*i);
+	return texture->get_levels() == 0 ? nullptr : texture.get();
 }
 
 }
@@ -23,6 +23,7 @@
 #include "Window.h"
 
 #include "ink/core/Error.h"
+#include "ink/graphics/Gpu.h"
 
 #include "opengl/glad.h"
 
@@ -60,6 +61,7 @@ void Window::init_opengl(int v, int d, int s, int m, bool a) {
 	context = SDL_GL_CreateContext(sdl_window);
 	SDL_GL_SetSwapInterval(v);
 	if (gladLoadGL() == 0) Error::set("Window", "Failed to load OpenGL");
+	gpu::State::invalidate();
 }
 
 void Window::close() {
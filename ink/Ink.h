@@ -25,6 +25,7 @@
 /* core part */
 #include "core/Error.h"
 #include "core/File.h"
+#include "core/WorkerPool.h"
 
 /* math part */
 #include "math/Vector.h"
@@ -34,12 +35,15 @@
 #include "math/Euler.h"
 #include "math/Random.h"
 #include "math/Ray.h"
+#include "math/Frustum.h"
 
 /* objects part */
 #include "objects/Defines.h"
 #include "objects/Enums.h"
 #include "objects/Image.h"
 #include "objects/Mesh.h"
+#include "objects/MeshOptimizer.h"
+#include "objects/MeshSimplifier.h"
 #include "objects/Instance.h"
 #include "objects/Uniforms.h"
 #include "objects/Material.h"
@@ -80,9 +84,13 @@
 #include "probes/ReflectionProbe.h"
 
 /* scene part */
+#include "scene/AABBTree.h"
+#include "scene/TransformSystem.h"
 #include "scene/Scene.h"
 
 /* renderer part */
+#include "renderer/CompiledMaterial.h"
+#include "renderer/DrawQueue.h"
 #include "renderer/Renderer.h"
 
 /* postprocess part */
@@ -43,4 +43,8 @@ void Camera::lookat(const Vec3& p, const Vec3& d, const Vec3& u) {
 	};
 }
 
+Frustum Camera::get_frustum() const {
+	return Frustum(projection * viewing);
+}
+
 }
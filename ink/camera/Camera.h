@@ -24,6 +24,7 @@
 
 #include "../math/Vector.h"
 #include "../math/Matrix.h"
+#include "../math/Frustum.h"
 
 namespace ink {
 
@@ -58,6 +59,12 @@ public:
 	 * \param u view-up vector
 	 */
 	void lookat(const Vec3& p, const Vec3& d, const Vec3& u);
+	
+	/**
+	 * Returns the view frustum of the camera in world space, extracted from
+	 * the viewing matrix and the projection matrix.
+	 */
+	Frustum get_frustum() const;
 };
 
 }
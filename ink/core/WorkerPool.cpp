@@ -0,0 +1,118 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ink {
+
+class Workers {
+public:
+	~Workers();
+	
+	void run(int n, const std::function<void(int)>& f);
+	
+private:
+	std::mutex run_mutex;
+	std::mutex mutex;
+	std::condition_variable task_ready;
+	std::condition_variable task_done;
+	std::vector<std::thread> workers;
+	const std::function<void(int)>* task = nullptr;
+	int task_count = 0;
+	int next_task = 0;
+	int unfinished_tasks = 0;
+	bool stopping = false;
+	
+	void work();
+	
+	bool run_next(std::unique_lock<std::mutex>& l);
+};
+
+Workers::~Workers() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	task_ready.notify_all();
+	for (auto& worker : workers) worker.join();
+}
+
+void Workers::run(int n, const std::function<void(int)>& f) {
+	/* the pool runs the tasks of one caller at a time */
+	std::lock_guard<std::mutex> run_lock(run_mutex);
+	std::unique_lock<std::mutex> lock(mutex);
+	while (workers.size() + 1 < static_cast<size_t>(n)) workers.emplace_back(&Workers::work, this);
+	task = &f;
+	task_count = n;
+	next_task = 0;
+	unfinished_tasks = n;
+	task_ready.notify_all();
+	
+	/* the calling thread takes the tasks as well */
+	while (run_next(lock)) continue;
+	task_done.wait(lock, [this]() -> bool { return unfinished_tasks == 0; });
+	task = nullptr;
+}
+
+void Workers::work() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		task_ready.wait(lock, [this]() -> bool { return stopping || next_task < task_count; });
+		if (stopping) return;
+		run_next(lock);
+	}
+}
+
+bool Workers::run_next(std::unique_lock<std::mutex>& l) {
+	if (next_task >= task_count) return false;
+	auto& function = *task;
+	int index = next_task++;
+	l.unlock();
+	function(index);
+	l.lock();
+	if (--unfinished_tasks == 0) task_done.notify_all();
+	return true;
+}
+
+void WorkerPool::run(int n, const std::function<void(int)>& f) {
+	if (n == 1) {
+		f(0);
+		return;
+	}
+	
+	/* the workers are created once and wait for the next tasks */
+	static Workers workers;
+	workers.run(n, f);
+}
+
+int WorkerPool::get_thread_count() {
+	static const int thread_count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	return thread_count;
+}
+
+}
@@ -0,0 +1,49 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <functional>
+
+namespace ink {
+
+class WorkerPool {
+public:
+	/**
+	 * Runs the tasks with the indices from 0 to n - 1 on the worker threads
+	 * shared by the engine. The threads are created on first use and are kept
+	 * waiting for the next tasks, and the calling thread takes tasks as well.
+	 * The tasks from different callers run one batch after another, so the
+	 * tasks should not run the pool again.
+	 *
+	 * \param n the number of tasks
+	 * \param f the function called with the index of each task
+	 */
+	static void run(int n, const std::function<void(int)>& f);
+	
+	/**
+	 * Returns the number of hardware threads, which is read only once.
+	 */
+	static int get_thread_count();
+};
+
+}
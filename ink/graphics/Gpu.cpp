@@ -27,6 +27,9 @@
 
 #include "opengl/glad.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -363,6 +366,72 @@ RenderSide get_render_side(uint32_t v) {
 	/*   ... GL_FRONT_AND_BACK*/return DOUBLE_SIDE;
 }
 
+constexpr size_t ARENA_MIN_CAPACITY = 1 << 20;
+
+constexpr int LOCATION_VERTEX = 0;
+constexpr int LOCATION_NORMAL = 1;
+constexpr int LOCATION_UV = 2;
+constexpr int LOCATION_TANGENT = 3;
+constexpr int LOCATION_COLOR = 4;
+constexpr int LOCATION_INSTANCE_MODEL = 5;
+constexpr int LOCATION_INSTANCE_NORMAL = 9;
+
+static uint16_t to_half(float v) {
+	uint32_t bits = 0;
+	std::memcpy(&bits, &v, sizeof(float));
+	uint16_t sign = (bits >> 16) & 0x8000;
+	int exponent = static_cast<int>((bits >> 23) & 0xff) - 112;
+	uint32_t mantissa = bits & 0x7fffff;
+	
+	/* clamp to infinity if overflow */
+	if (exponent >= 31) return sign | 0x7c00;
+	
+	/* shift to subnormal if underflow */
+	if (exponent <= 0) {
+		if (exponent < -10) return sign;
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1 << shift) - 1);
+		uint32_t middle = 1 << (shift - 1);
+		if (rest > middle || (rest == middle && (half & 1) != 0)) ++half;
+		return sign | half;
+	}
+	
+	/* round to nearest even, the carry moves to exponent */
+	uint32_t half = exponent << 10 | mantissa >> 13;
+	uint32_t rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1) != 0)) ++half;
+	return sign | half;
+}
+
+static Vec2 encode_octahedron(const Vec3& n) {
+	float length = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (length == 0) return {0, 0};
+	Vec2 e = {n.x / length, n.y / length};
+	if (n.z >= 0) return e;
+	return {
+		(1 - fabsf(e.y)) * (e.x >= 0 ? 1 : -1),
+		(1 - fabsf(e.x)) * (e.y >= 0 ? 1 : -1),
+	};
+}
+
+static int to_snorm(float v, int b) {
+	float max = static_cast<float>((1 << (b - 1)) - 1);
+	return static_cast<int>(roundf(fminf(fmaxf(v, -1), 1) * max));
+}
+
+static int to_unorm(float v, int b) {
+	float max = static_cast<float>((1 << b) - 1);
+	return static_cast<int>(roundf(fminf(fmaxf(v, 0), 1) * max));
+}
+
+template <typename Type, typename... Args>
+static void write_attribute(uint8_t* p, Args... v) {
+	Type data[] = {static_cast<Type>(v)...};
+	std::memcpy(p, data, sizeof(data));
+}
+
 Rect::Rect(int w, int h) : width(w), height(h) {}
 
 Rect::Rect(int x, int y, int w, int h) : x(x), y(y), width(w), height(h) {}
@@ -442,15 +511,22 @@ Vec4 State::get_color_writemask() {
 }
 
 void State::set_color_writemask(bool r, bool g, bool b, bool a) {
+	auto color_writemask = std::make_tuple(r, g, b, a);
+	if (cache.color_writemask == color_writemask) return;
 	glColorMask(r, g, b, a);
+	cache.color_writemask = color_writemask;
 }
 
 void State::enable_depth_test() {
+	if (cache.depth_test == true) return;
 	glEnable(GL_DEPTH_TEST);
+	cache.depth_test = true;
 }
 
 void State::disable_depth_test() {
+	if (cache.depth_test == false) return;
 	glDisable(GL_DEPTH_TEST);
+	cache.depth_test = false;
 }
 
 double State::get_clear_depth() {
@@ -470,7 +546,9 @@ bool State::get_depth_writemask() {
 }
 
 void State::set_depth_writemask(bool m) {
+	if (cache.depth_writemask == m) return;
 	glDepthMask(m);
+	cache.depth_writemask = m;
 }
 
 ComparisonFunc State::get_depth_func() {
@@ -480,15 +558,22 @@ ComparisonFunc State::get_depth_func() {
 }
 
 void State::set_depth_func(ComparisonFunc f) {
-	glDepthFunc(GL_COMPARISON_FUNCTIONS[f]);
+	uint32_t depth_func = GL_COMPARISON_FUNCTIONS[f];
+	if (cache.depth_func == depth_func) return;
+	glDepthFunc(depth_func);
+	cache.depth_func = depth_func;
 }
 
 void State::enable_stencil_test() {
+	if (cache.stencil_test == true) return;
 	glEnable(GL_STENCIL_TEST);
+	cache.stencil_test = true;
 }
 
 void State::disable_stencil_test() {
+	if (cache.stencil_test == false) return;
 	glDisable(GL_STENCIL_TEST);
+	cache.stencil_test = false;
 }
 
 int State::get_clear_stencil() {
@@ -508,7 +593,9 @@ unsigned int State::get_stencil_writemask() {
 }
 
 void State::set_stencil_writemask(unsigned int m) {
+	if (cache.stencil_writemask == m) return;
 	glStencilMask(m);
+	cache.stencil_writemask = m;
 }
 
 ComparisonFunc State::get_stencil_func() {
@@ -530,7 +617,10 @@ int State::get_stencil_mask() {
 }
 
 void State::set_stencil_func(ComparisonFunc f, int r, int m) {
+	auto stencil_func = std::make_tuple(GL_COMPARISON_FUNCTIONS[f], r, m);
+	if (cache.stencil_func == stencil_func) return;
 	glStencilFunc(GL_COMPARISON_FUNCTIONS[f], r, m);
+	cache.stencil_func = stencil_func;
 }
 
 StencilOperation State::get_stencil_fail() {
@@ -554,17 +644,26 @@ StencilOperation State::get_stencil_zpass() {
 void State::set_stencil_op(StencilOperation f,
 						   StencilOperation zf,
 						   StencilOperation zp) {
+	auto stencil_op = std::make_tuple(GL_STENCIL_OPERATIONS[f],
+									  GL_STENCIL_OPERATIONS[zf],
+									  GL_STENCIL_OPERATIONS[zp]);
+	if (cache.stencil_op == stencil_op) return;
 	glStencilOp(GL_STENCIL_OPERATIONS[f],
 				GL_STENCIL_OPERATIONS[zf],
 				GL_STENCIL_OPERATIONS[zp]);
+	cache.stencil_op = stencil_op;
 }
 
 void State::enable_blending() {
+	if (cache.blending == true) return;
 	glEnable(GL_BLEND);
+	cache.blending = true;
 }
 
 void State::disable_blending() {
+	if (cache.blending == false) return;
 	glDisable(GL_BLEND);
+	cache.blending = false;
 }
 
 BlendOperation State::get_blend_op_rgb() {
@@ -580,11 +679,17 @@ BlendOperation State::get_blend_op_alpha() {
 }
 
 void State::set_blend_op(BlendOperation o) {
+	auto blend_op = std::make_tuple(GL_BLEND_OPERATIONS[o], GL_BLEND_OPERATIONS[o]);
+	if (cache.blend_op == blend_op) return;
 	glBlendEquation(GL_BLEND_OPERATIONS[o]);
+	cache.blend_op = blend_op;
 }
 
 void State::set_blend_op(BlendOperation rgb, BlendOperation a) {
+	auto blend_op = std::make_tuple(GL_BLEND_OPERATIONS[rgb], GL_BLEND_OPERATIONS[a]);
+	if (cache.blend_op == blend_op) return;
 	glBlendEquationSeparate(GL_BLEND_OPERATIONS[rgb], GL_BLEND_OPERATIONS[a]);
+	cache.blend_op = blend_op;
 }
 
 BlendFactor State::get_blend_src_rgb() {
@@ -612,13 +717,21 @@ BlendFactor State::get_blend_dst_alpha() {
 }
 
 void State::set_blend_factor(BlendFactor s, BlendFactor d) {
+	auto blend_factor = std::make_tuple(GL_BLEND_FACTORS[s], GL_BLEND_FACTORS[d],
+										GL_BLEND_FACTORS[s], GL_BLEND_FACTORS[d]);
+	if (cache.blend_factor == blend_factor) return;
 	glBlendFunc(GL_BLEND_FACTORS[s], GL_BLEND_FACTORS[d]);
+	cache.blend_factor = blend_factor;
 }
 
 void State::set_blend_factor(BlendFactor sr, BlendFactor dr,
 							 BlendFactor sa, BlendFactor da) {
+	auto blend_factor = std::make_tuple(GL_BLEND_FACTORS[sr], GL_BLEND_FACTORS[dr],
+										GL_BLEND_FACTORS[sa], GL_BLEND_FACTORS[da]);
+	if (cache.blend_factor == blend_factor) return;
 	glBlendFuncSeparate(GL_BLEND_FACTORS[sr], GL_BLEND_FACTORS[dr],
 						GL_BLEND_FACTORS[sa], GL_BLEND_FACTORS[da]);
+	cache.blend_factor = blend_factor;
 }
 
 Rect State::get_viewport() {
@@ -628,15 +741,22 @@ Rect State::get_viewport() {
 }
 
 void State::set_viewport(const Rect& v) {
+	auto viewport = std::make_tuple(v.x, v.y, v.width, v.height);
+	if (cache.viewport == viewport) return;
 	glViewport(v.x, v.y, v.width, v.height);
+	cache.viewport = viewport;
 }
 
 void State::enable_scissor_test() {
+	if (cache.scissor_test == true) return;
 	glEnable(GL_SCISSOR_TEST);
+	cache.scissor_test = true;
 }
 
 void State::disable_scissor_test() {
+	if (cache.scissor_test == false) return;
 	glDisable(GL_SCISSOR_TEST);
+	cache.scissor_test = false;
 }
 
 Rect State::get_scissor() {
@@ -646,23 +766,34 @@ Rect State::get_scissor() {
 }
 
 void State::set_scissor(const Rect& s) {
+	auto scissor = std::make_tuple(s.x, s.y, s.width, s.height);
+	if (cache.scissor == scissor) return;
 	glScissor(s.x, s.y, s.width, s.height);
+	cache.scissor = scissor;
 }
 
 void State::enable_wireframe() {
+	if (cache.wireframe == true) return;
 	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	cache.wireframe = true;
 }
 
 void State::disable_wireframe() {
+	if (cache.wireframe == false) return;
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	cache.wireframe = false;
 }
 
 void State::enable_culling() {
+	if (cache.culling == true) return;
 	glEnable(GL_CULL_FACE);
+	cache.culling = true;
 }
 
 void State::disable_culling() {
+	if (cache.culling == false) return;
 	glDisable(GL_CULL_FACE);
+	cache.culling = false;
 }
 
 RenderSide State::get_cull_side() {
@@ -672,7 +803,10 @@ RenderSide State::get_cull_side() {
 }
 
 void State::set_cull_side(RenderSide s) {
-	glCullFace(GL_RENDER_SIDES[s]);
+	uint32_t cull_side = GL_RENDER_SIDES[s];
+	if (cache.cull_side == cull_side) return;
+	glCullFace(cull_side);
+	cache.cull_side = cull_side;
 }
 
 void State::enable_polygon_offset() {
@@ -731,6 +865,12 @@ void State::disable_texture_cube_seamless() {
 	glDisable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 }
 
+void State::invalidate() {
+	cache = Cache();
+}
+
+State::Cache State::cache;
+
 void MaterialState::set_depth(const Material& m) {
 	if (!m.depth_test) return State::disable_depth_test();
 	State::enable_depth_test();
@@ -838,39 +978,75 @@ void Shader::set_defines(const Defines& d) {
 }
 
 void Shader::set_uniform_i(const std::string& n, int v) const {
-	glUniform1i(glGetUniformLocation(program, n.c_str()), v);
+	set_uniform_i(UniformKey(n), v);
 }
 
 void Shader::set_uniform_u(const std::string& n, unsigned int v) const {
-	glUniform1ui(glGetUniformLocation(program, n.c_str()), v);
+	set_uniform_u(UniformKey(n), v);
 }
 
 void Shader::set_uniform_f(const std::string& n, float v) const {
-	glUniform1f(glGetUniformLocation(program, n.c_str()), v);
+	set_uniform_f(UniformKey(n), v);
 }
 
 void Shader::set_uniform_v2(const std::string& n, const Vec2& v) const {
-	glUniform2fv(glGetUniformLocation(program, n.c_str()), 1, &v.x);
+	set_uniform_v2(UniformKey(n), v);
 }
 
 void Shader::set_uniform_v3(const std::string& n, const Vec3& v) const {
-	glUniform3fv(glGetUniformLocation(program, n.c_str()), 1, &v.x);
+	set_uniform_v3(UniformKey(n), v);
 }
 
 void Shader::set_uniform_v4(const std::string& n, const Vec4& v) const {
-	glUniform4fv(glGetUniformLocation(program, n.c_str()), 1, &v.x);
+	set_uniform_v4(UniformKey(n), v);
 }
 
 void Shader::set_uniform_m2(const std::string& n, const Mat2& v) const {
-	glUniformMatrix2fv(glGetUniformLocation(program, n.c_str()), 1, GL_TRUE, v[0]);
+	set_uniform_m2(UniformKey(n), v);
 }
 
 void Shader::set_uniform_m3(const std::string& n, const Mat3& v) const {
-	glUniformMatrix3fv(glGetUniformLocation(program, n.c_str()), 1, GL_TRUE, v[0]);
+	set_uniform_m3(UniformKey(n), v);
 }
 
 void Shader::set_uniform_m4(const std::string& n, const Mat4& v) const {
-	glUniformMatrix4fv(glGetUniformLocation(program, n.c_str()), 1, GL_TRUE, v[0]);
+	set_uniform_m4(UniformKey(n), v);
+}
+
+void Shader::set_uniform_i(const UniformKey& k, int v) const {
+	glUniform1i(get_uniform_location(k), v);
+}
+
+void Shader::set_uniform_u(const UniformKey& k, unsigned int v) const {
+	glUniform1ui(get_uniform_location(k), v);
+}
+
+void Shader::set_uniform_f(const UniformKey& k, float v) const {
+	glUniform1f(get_uniform_location(k), v);
+}
+
+void Shader::set_uniform_v2(const UniformKey& k, const Vec2& v) const {
+	glUniform2fv(get_uniform_location(k), 1, &v.x);
+}
+
+void Shader::set_uniform_v3(const UniformKey& k, const Vec3& v) const {
+	glUniform3fv(get_uniform_location(k), 1, &v.x);
+}
+
+void Shader::set_uniform_v4(const UniformKey& k, const Vec4& v) const {
+	glUniform4fv(get_uniform_location(k), 1, &v.x);
+}
+
+void Shader::set_uniform_m2(const UniformKey& k, const Mat2& v) const {
+	glUniformMatrix2fv(get_uniform_location(k), 1, GL_TRUE, v[0]);
+}
+
+void Shader::set_uniform_m3(const UniformKey& k, const Mat3& v) const {
+	glUniformMatrix3fv(get_uniform_location(k), 1, GL_TRUE, v[0]);
+}
+
+void Shader::set_uniform_m4(const UniformKey& k, const Mat4& v) const {
+	glUniformMatrix4fv(get_uniform_location(k), 1, GL_TRUE, v[0]);
 }
 
 void Shader::set_uniforms(const Uniforms& u) const {
@@ -879,8 +1055,7 @@ void Shader::set_uniforms(const Uniforms& u) const {
 	auto* data_u = reinterpret_cast<const unsigned int*>(data_f);
 	size_t uniform_count = u.get_count();
 	for (int i = 0; i < uniform_count; ++i) {
-		std::string name = u.get_name(i);
-		int32_t gl_location = glGetUniformLocation(program, name.c_str());
+		int32_t gl_location = get_uniform_location(UniformKey(u.get_name(i)));
 		int type = u.get_type(i);
 		int location = u.get_location(i);
 		if (type == 0 /* int */ ) {
@@ -907,6 +1082,24 @@ void Shader::set_uniforms(const Uniforms& u) const {
 	}
 }
 
+void Shader::set_uniform_block(const std::string& n, unsigned int b) const {
+	set_uniform_block(UniformKey(n), b);
+}
+
+void Shader::set_uniform_block(const UniformKey& k, unsigned int b) const {
+	auto iter = uniform_blocks.find(k.hash);
+	if (iter == uniform_blocks.end()) return;
+	auto& [index, binding] = iter->second;
+	if (binding == b) return;
+	glUniformBlockBinding(program, index, b);
+	binding = b;
+}
+
+int32_t Shader::get_uniform_location(const UniformKey& k) const {
+	auto iter = uniform_locations.find(k.hash);
+	return iter == uniform_locations.end() ? -1 : iter->second;
+}
+
 std::string Shader::get_glsl_version() {
 	return glsl_version;
 }
@@ -957,11 +1150,23 @@ void Shader::compile_shaders() const {
 		return Error::set("Shader", "Fragment shader is missing");
 	}
 	
+	/* bind the vertex inputs to fixed locations */
+	glBindAttribLocation(program, LOCATION_VERTEX, "vertex");
+	glBindAttribLocation(program, LOCATION_NORMAL, "normal");
+	glBindAttribLocation(program, LOCATION_UV, "uv");
+	glBindAttribLocation(program, LOCATION_TANGENT, "tangent");
+	glBindAttribLocation(program, LOCATION_COLOR, "color");
+	glBindAttribLocation(program, LOCATION_INSTANCE_MODEL, "instance_model");
+	glBindAttribLocation(program, LOCATION_INSTANCE_NORMAL, "instance_normal");
+	
 	/* link shaders to program */
 	glLinkProgram(program);
 	std::string info = get_link_info();
 	if (!info.empty()) Error::set("Shader", info);
 	
+	/* resolve the locations of active uniforms */
+	resolve_uniforms();
+	
 	/* delete vertex shader */
 	glDeleteShader(vert_id);
 	
@@ -981,6 +1186,51 @@ std::string Shader::get_link_info() const {
 	return std::string("Link error\n") + info;
 }
 
+void Shader::resolve_uniforms() const {
+	uniform_locations.clear();
+	
+	/* get the number of active uniforms */
+	int32_t uniform_count = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniform_count);
+	int32_t max_length = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+	std::vector<char> name_buffer(max_length + 1);
+	
+	for (int i = 0; i < uniform_count; ++i) {
+		/* get the name and location of uniform */
+		int32_t size = 0;
+		uint32_t type = 0;
+		glGetActiveUniform(program, i, max_length + 1, nullptr, &size, &type, name_buffer.data());
+		std::string name = name_buffer.data();
+		int32_t location = glGetUniformLocation(program, name.c_str());
+		if (location == -1) continue; /* uniforms in uniform blocks */
+		uniform_locations.insert_or_assign(UniformKey(name).hash, location);
+		
+		/* add every element if the uniform is an array */
+		if (!name.ends_with("[0]")) continue;
+		std::string array_name = name.substr(0, name.size() - 3);
+		uniform_locations.insert_or_assign(UniformKey(array_name).hash, location);
+		for (int j = 1; j < size; ++j) {
+			std::string element_name = array_name + '[' + std::to_string(j) + ']';
+			int32_t element_location = glGetUniformLocation(program, element_name.c_str());
+			uniform_locations.insert_or_assign(UniformKey(element_name).hash, element_location);
+		}
+	}
+	
+	/* get the number of active uniform blocks */
+	uniform_blocks.clear();
+	int32_t block_count = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &block_count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_length);
+	name_buffer.resize(max_length + 1);
+	
+	for (int i = 0; i < block_count; ++i) {
+		/* every block is bound to binding point 0 after linking */
+		glGetActiveUniformBlockName(program, i, max_length + 1, nullptr, name_buffer.data());
+		uniform_blocks.insert_or_assign(UniformKey(name_buffer.data()).hash, std::make_pair(i, 0));
+	}
+}
+
 void Shader::resolve_defines(std::string& s) const {
 	s = defines + s;
 }
@@ -1054,17 +1304,29 @@ std::string Shader::get_error_info(const std::string& c, const std::string& s) {
 
 std::string Shader::glsl_version = "410";
 
-VertexObject::VertexObject() {
-	glGenVertexArrays(1, &id);
-	glGenBuffers(1, &buffer_id);
-}
+UniformKey::UniformKey(const std::string& n) : hash(hash_name(n.c_str())) {}
+
+VertexObject::VertexObject() {}
 
 VertexObject::~VertexObject() {
+	if (arena != nullptr) arena->free(*this);
 	glDeleteVertexArrays(1, &id);
 	glDeleteBuffers(1, &buffer_id);
+	if (index_buffer_id != 0) glDeleteBuffers(1, &index_buffer_id);
+}
+
+void VertexObject::load(const Mesh& m, const MeshGroup& g, bool q) {
+	load_data(m, g, q, nullptr);
+}
+
+void VertexObject::load(const Mesh& m, const MeshGroup& g, GeometryArena& a) {
+	load_data(m, g, a.quantized, &a);
 }
 
-void VertexObject::load(const Mesh& m, const MeshGroup& g) {
+void VertexObject::load_data(const Mesh& m, const MeshGroup& g, bool q, GeometryArena* a) {
+	/* free the previous allocation in arena */
+	if (arena != nullptr) arena->free(*this);
+	
 	auto& vertex = m.vertex;
 	auto& normal = m.normal;
 	auto& uv = m.uv;
@@ -1077,101 +1339,531 @@ void VertexObject::load(const Mesh& m, const MeshGroup& g) {
 	bool has_tangent = !tangent.empty();
 	bool has_color = !color.empty();
 	
-	/* calculate length and stride */
-	length = g.length;
-	int group_end = g.position + g.length;
-	int stride = 3;
-	if (has_normal) stride += 3;
-	if (has_uv) stride += 2;
-	if (has_tangent) stride += 4;
-	if (has_color) stride += 3;
+	/* store the attributes of arena to share vertex array */
+	int attributes = a == nullptr ? GeometryArena::get_attributes(m) : a->attributes;
+	bool use_normal = (attributes & GeometryArena::ATTRIBUTE_NORMAL) != 0;
+	bool use_uv = (attributes & GeometryArena::ATTRIBUTE_UV) != 0;
+	bool use_tangent = (attributes & GeometryArena::ATTRIBUTE_TANGENT) != 0;
+	bool use_color = (attributes & GeometryArena::ATTRIBUTE_COLOR) != 0;
 	
-	/* pack attributes' data into one vector */
-	std::vector<float> data(length * stride);
-	/* has_vertex */ {
-		names = {"vertex"};
-		sizes = {3};
-		locations = {0};
-		auto* data_ptr = data.data() + locations.back();
-		for (int i = g.position; i < group_end; ++i) {
-			data_ptr[0] = vertex[i].x;
-			data_ptr[1] = vertex[i].y;
-			data_ptr[2] = vertex[i].z;
-			data_ptr += stride;
+	/* find the vertices used by the group */
+	length = g.length;
+	bool has_indices = !m.indices.empty();
+	std::vector<int> vertex_ids;
+	std::vector<uint32_t> indices;
+	if (!has_indices) {
+		vertex_ids.resize(length);
+		for (int i = 0; i < length; ++i) vertex_ids[i] = g.position + i;
+	} else {
+		/* remap the indices to the vertices used by the group */
+		std::unordered_map<uint32_t, uint32_t> remap;
+		indices.resize(length);
+		for (int i = 0; i < length; ++i) {
+			uint32_t index = m.indices[g.position + i];
+			auto [entry, inserted] = remap.try_emplace(index, static_cast<uint32_t>(vertex_ids.size()));
+			if (inserted) vertex_ids.emplace_back(index);
+			indices[i] = entry->second;
 		}
-		locations.emplace_back(locations.back() + 3);
 	}
-	if (has_normal) {
-		names.emplace_back("normal");
-		sizes.emplace_back(3);
-		auto* data_ptr = data.data() + locations.back();
-		for (int i = g.position; i < group_end; ++i) {
-			data_ptr[0] = normal[i].x;
-			data_ptr[1] = normal[i].y;
-			data_ptr[2] = normal[i].z;
-			data_ptr += stride;
-		}
-		locations.emplace_back(locations.back() + 3);
+	size_t vertex_count = vertex_ids.size();
+	
+	/* copy the meshlets in the group with positions relative to group */
+	meshlets.clear();
+	for (auto& meshlet : m.meshlets) {
+		if (!has_indices || meshlet.position < g.position) continue;
+		if (meshlet.position + meshlet.length > g.position + g.length) continue;
+		meshlets.emplace_back(meshlet).position -= g.position;
 	}
-	if (has_uv) {
-		names.emplace_back("uv");
-		sizes.emplace_back(2);
-		auto* data_ptr = data.data() + locations.back();
-		for (int i = g.position; i < group_end; ++i) {
-			data_ptr[0] = uv[i].x;
-			data_ptr[1] = uv[i].y;
-			data_ptr += stride;
+	
+	/* calculate the bounds of group to quantize vertices */
+	quantized = q;
+	vertex_offset = {0, 0, 0};
+	vertex_scale = {1, 1, 1};
+	Vec3 inv_scale = {0, 0, 0};
+	if (q && vertex_count != 0) {
+		Vec3 min = vertex[vertex_ids[0]];
+		Vec3 max = vertex[vertex_ids[0]];
+		for (int i : vertex_ids) {
+			auto& v = vertex[i];
+			min = {std::min(min.x, v.x), std::min(min.y, v.y), std::min(min.z, v.z)};
+			max = {std::max(max.x, v.x), std::max(max.y, v.y), std::max(max.z, v.z)};
 		}
-		locations.emplace_back(locations.back() + 2);
+		vertex_offset = min;
+		vertex_scale = max - min;
+		inv_scale.x = vertex_scale.x == 0 ? 0 : 1 / vertex_scale.x;
+		inv_scale.y = vertex_scale.y == 0 ? 0 : 1 / vertex_scale.y;
+		inv_scale.z = vertex_scale.z == 0 ? 0 : 1 / vertex_scale.z;
 	}
-	if (has_tangent) {
-		names.emplace_back("tangent");
-		sizes.emplace_back(4);
-		auto* data_ptr = data.data() + locations.back();
-		for (int i = g.position; i < group_end; ++i) {
-			data_ptr[0] = tangent[i].x;
-			data_ptr[1] = tangent[i].y;
-			data_ptr[2] = tangent[i].z;
-			data_ptr[3] = tangent[i].w;
-			data_ptr += stride;
-		}
-		locations.emplace_back(locations.back() + 4);
+	
+	/* calculate the layout of attributes */
+	locations.clear();
+	sizes.clear();
+	types.clear();
+	normalized.clear();
+	offsets.clear();
+	stride = 0;
+	auto add_attribute = [&](int l, int s, uint32_t t, int b) -> void {
+		locations.emplace_back(l);
+		sizes.emplace_back(s);
+		types.emplace_back(t);
+		normalized.emplace_back(t != GL_FLOAT && t != GL_HALF_FLOAT);
+		offsets.emplace_back(stride);
+		stride += b;
+	};
+	if (!q) {
+		add_attribute(LOCATION_VERTEX, 3, GL_FLOAT, 12);
+		if (use_normal) add_attribute(LOCATION_NORMAL, 3, GL_FLOAT, 12);
+		if (use_uv) add_attribute(LOCATION_UV, 2, GL_FLOAT, 8);
+		if (use_tangent) add_attribute(LOCATION_TANGENT, 4, GL_FLOAT, 16);
+		if (use_color) add_attribute(LOCATION_COLOR, 3, GL_FLOAT, 12);
+	} else {
+		add_attribute(LOCATION_VERTEX, 3, GL_UNSIGNED_SHORT, 8);
+		if (use_normal) add_attribute(LOCATION_NORMAL, 2, GL_SHORT, 4);
+		if (use_uv) add_attribute(LOCATION_UV, 2, GL_HALF_FLOAT, 4);
+		if (use_tangent) add_attribute(LOCATION_TANGENT, 4, GL_INT_2_10_10_10_REV, 4);
+		if (use_color) add_attribute(LOCATION_COLOR, 3, GL_UNSIGNED_BYTE, 4);
 	}
-	if (has_color) {
-		names.emplace_back("color");
-		sizes.emplace_back(3);
-		auto* data_ptr = data.data() + locations.back();
-		for (int i = g.position; i < group_end; ++i) {
-			data_ptr[0] = color[i].x;
-			data_ptr[1] = color[i].y;
-			data_ptr[2] = color[i].z;
-			data_ptr += stride;
+	
+	/* pack attributes' data into one buffer, missing attributes are zeros */
+	std::vector<uint8_t> data(vertex_count * stride);
+	uint8_t* data_ptr = data.data();
+	for (int i : vertex_ids) {
+		uint8_t* attribute_ptr = data_ptr;
+		if (!q) {
+			write_attribute<float>(attribute_ptr, vertex[i].x, vertex[i].y, vertex[i].z);
+			attribute_ptr += 12;
+		} else {
+			Vec3 v = (vertex[i] - vertex_offset) * inv_scale;
+			write_attribute<uint16_t>(attribute_ptr, to_unorm(v.x, 16), to_unorm(v.y, 16), to_unorm(v.z, 16), 0);
+			attribute_ptr += 8;
+		}
+		if (use_normal && !q) {
+			if (has_normal) write_attribute<float>(attribute_ptr, normal[i].x, normal[i].y, normal[i].z);
+			attribute_ptr += 12;
+		} else if (use_normal) {
+			Vec2 e = has_normal ? encode_octahedron(normal[i]) : Vec2(0, 0);
+			write_attribute<int16_t>(attribute_ptr, to_snorm(e.x, 16), to_snorm(e.y, 16));
+			attribute_ptr += 4;
+		}
+		if (use_uv && !q) {
+			if (has_uv) write_attribute<float>(attribute_ptr, uv[i].x, uv[i].y);
+			attribute_ptr += 8;
+		} else if (use_uv) {
+			if (has_uv) write_attribute<uint16_t>(attribute_ptr, to_half(uv[i].x), to_half(uv[i].y));
+			attribute_ptr += 4;
 		}
-		locations.emplace_back(locations.back() + 3);
+		if (use_tangent && !q) {
+			if (has_tangent) write_attribute<float>(attribute_ptr, tangent[i].x, tangent[i].y, tangent[i].z, tangent[i].w);
+			attribute_ptr += 16;
+		} else if (use_tangent && has_tangent) {
+			/* pack octahedron into XY and handedness into W */
+			Vec2 e = encode_octahedron({tangent[i].x, tangent[i].y, tangent[i].z});
+			uint32_t x = to_snorm(e.x, 10) & 0x3ff;
+			uint32_t y = to_snorm(e.y, 10) & 0x3ff;
+			uint32_t w = (tangent[i].w < 0 ? -1 : 1) & 0x3;
+			write_attribute<uint32_t>(attribute_ptr, x | y << 10 | w << 30);
+			attribute_ptr += 4;
+		} else if (use_tangent) {
+			attribute_ptr += 4;
+		}
+		if (use_color && !q) {
+			if (has_color) write_attribute<float>(attribute_ptr, color[i].x, color[i].y, color[i].z);
+		} else if (use_color && has_color) {
+			write_attribute<uint8_t>(attribute_ptr, to_unorm(color[i].x, 8), to_unorm(color[i].y, 8), to_unorm(color[i].z, 8), 255);
+		}
+		data_ptr += stride;
+	}
+	
+	/* convert indices to 16-bit type if possible */
+	index_type = 0;
+	std::vector<uint16_t> short_indices;
+	const void* index_data = nullptr;
+	size_t index_size = 0;
+	if (has_indices && vertex_count <= 65536) {
+		short_indices.assign(indices.begin(), indices.end());
+		index_type = GL_UNSIGNED_SHORT;
+		index_data = short_indices.data();
+		index_size = sizeof(uint16_t) * length;
+	} else if (has_indices) {
+		index_type = GL_UNSIGNED_INT;
+		index_data = indices.data();
+		index_size = sizeof(uint32_t) * length;
+	}
+	
+	/* upload data to the sub-allocation of arena */
+	if (a != nullptr) {
+		return a->allocate(*this, data.data(), data.size(), index_data, index_size);
 	}
 	
 	/* upload data to GPU */
+	if (id == 0) glGenVertexArrays(1, &id);
+	if (buffer_id == 0) glGenBuffers(1, &buffer_id);
 	glBindVertexArray(id);
 	glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * data.size(), data.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+	set_vertex_array(id, buffer_id);
+	if (index_type == 0) return;
+	if (index_buffer_id == 0) glGenBuffers(1, &index_buffer_id);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_id);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_size, index_data, GL_STATIC_DRAW);
 }
 
-void VertexObject::attach(const Shader& s) const {
-	int stride = locations.back();
-	glBindVertexArray(id);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+bool VertexObject::is_quantized() const {
+	return quantized;
+}
+
+Vec3 VertexObject::get_vertex_offset() const {
+	return vertex_offset;
+}
+
+Vec3 VertexObject::get_vertex_scale() const {
+	return vertex_scale;
+}
+
+const std::vector<Meshlet>& VertexObject::get_meshlets() const {
+	return meshlets;
+}
+
+bool VertexObject::shares_layout(const VertexObject& v) const {
+	return this == &v || (arena != nullptr && arena == v.arena);
+}
+
+void VertexObject::set_vertex_array(uint32_t a, uint32_t b) const {
+	glBindVertexArray(a);
+	glBindBuffer(GL_ARRAY_BUFFER, b);
 	for (int i = 0; i < sizes.size(); ++i) {
-		int32_t attrib = glGetAttribLocation(s.program, names[i].c_str());
-		if (attrib == -1) continue;
-		void* pointer = reinterpret_cast<void*>(sizeof(float) * locations[i]);
-		glVertexAttribPointer(attrib, sizes[i], GL_FLOAT, GL_FALSE, sizeof(float) * stride, pointer);
-		glEnableVertexAttribArray(attrib);
+		void* pointer = reinterpret_cast<void*>(static_cast<size_t>(offsets[i]));
+		glVertexAttribPointer(locations[i], sizes[i], types[i], normalized[i], stride, pointer);
+		glEnableVertexAttribArray(locations[i]);
 	}
 }
 
+uint32_t VertexObject::get_vertex_array() const {
+	return arena == nullptr ? id : arena->id;
+}
+
 void VertexObject::render() const {
+	/* the sub-allocation of arena starts from base vertex */
+	int first = arena == nullptr ? 0 : static_cast<int>(arena_vertex_start / stride);
+	void* indices = reinterpret_cast<void*>(arena_index_start);
+	glBindVertexArray(get_vertex_array());
+	if (index_type == 0) {
+		glDrawArrays(GL_TRIANGLES, first, length);
+	} else {
+		glDrawElementsBaseVertex(GL_TRIANGLES, length, index_type, indices, first);
+	}
+}
+
+void VertexObject::render(int c) const {
+	/* the sub-allocation of arena starts from base vertex */
+	int first = arena == nullptr ? 0 : static_cast<int>(arena_vertex_start / stride);
+	void* indices = reinterpret_cast<void*>(arena_index_start);
+	glBindVertexArray(get_vertex_array());
+	if (index_type == 0) {
+		glDrawArraysInstanced(GL_TRIANGLES, first, length, c);
+	} else {
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, length, index_type, indices, c, first);
+	}
+}
+
+void VertexObject::render(const int* f, const int* c, int n) const {
+	/* the sub-allocation of arena starts from base vertex */
+	int first = arena == nullptr ? 0 : static_cast<int>(arena_vertex_start / stride);
+	glBindVertexArray(get_vertex_array());
+	if (index_type == 0) {
+		std::vector<int> firsts(f, f + n);
+		for (auto& i : firsts) i += first;
+		return glMultiDrawArrays(GL_TRIANGLES, firsts.data(), c, n);
+	}
+	
+	/* convert the first indices to the offsets in index buffer */
+	size_t index_size = index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	std::vector<const void*> indices(n);
+	for (int i = 0; i < n; ++i) {
+		indices[i] = reinterpret_cast<const void*>(arena_index_start + f[i] * index_size);
+	}
+	std::vector<int> base_vertices(n, first);
+	glMultiDrawElementsBaseVertex(GL_TRIANGLES, c, index_type, indices.data(), n, base_vertices.data());
+}
+
+GeometryArena::GeometryArena(bool q, int a) : quantized(q), attributes(a) {
+	glGenVertexArrays(1, &id);
+}
+
+GeometryArena::~GeometryArena() {
+	for (auto* object : objects) {
+		if (object != nullptr) object->arena = nullptr;
+	}
+	glDeleteVertexArrays(1, &id);
+	if (vertex_buffer_id != 0) glDeleteBuffers(1, &vertex_buffer_id);
+	if (index_buffer_id != 0) glDeleteBuffers(1, &index_buffer_id);
+}
+
+bool GeometryArena::is_quantized() const {
+	return quantized;
+}
+
+int GeometryArena::get_attributes() const {
+	return attributes;
+}
+
+size_t GeometryArena::get_object_count() const {
+	return object_count;
+}
+
+size_t GeometryArena::get_vertex_size() const {
+	return vertex_size;
+}
+
+size_t GeometryArena::get_index_size() const {
+	return index_size;
+}
+
+void GeometryArena::defragment() {
+	/* remove the slots of freed objects */
+	std::erase(objects, nullptr);
+	for (size_t i = 0; i < objects.size(); ++i) objects[i]->arena_slot = i;
+	
+	/* copy the vertices of objects to the front of a new buffer */
+	if (vertex_capacity != 0) {
+		uint32_t buffer = 0;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, vertex_capacity, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_READ_BUFFER, vertex_buffer_id);
+		size_t start = 0;
+		for (auto* object : objects) {
+			size_t size = object->arena_vertex_size;
+			if (size != 0) {
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, object->arena_vertex_start, start, size);
+			}
+			object->arena_vertex_start = start;
+			start += size;
+		}
+		glDeleteBuffers(1, &vertex_buffer_id);
+		vertex_buffer_id = buffer;
+		vertex_size = start;
+		
+		/* point the vertex array to the new buffer */
+		if (!objects.empty()) objects.front()->set_vertex_array(id, vertex_buffer_id);
+	}
+	
+	/* copy the indices of objects to the front of a new buffer */
+	if (index_capacity != 0) {
+		uint32_t buffer = 0;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, index_capacity, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_READ_BUFFER, index_buffer_id);
+		size_t start = 0;
+		for (auto* object : objects) {
+			size_t size = object->arena_index_size;
+			if (size != 0) {
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, object->arena_index_start, start, size);
+			}
+			object->arena_index_start = start;
+			start += size;
+		}
+		glDeleteBuffers(1, &index_buffer_id);
+		index_buffer_id = buffer;
+		index_size = start;
+		bind_index_buffer();
+	}
+}
+
+void GeometryArena::allocate(VertexObject& o, const void* v, size_t vs, const void* i, size_t is) {
+	/* defragment if more than half of the used bytes are holes */
+	if ((vertex_size - vertex_used) * 2 > vertex_size || (index_size - index_used) * 2 > index_size) {
+		defragment();
+	}
+	
+	/* align indices to 4 bytes for both index types */
+	size_t index_aligned = (is + 3) & ~size_t(3);
+	
+	/* grow the buffers if there is no enough space */
+	if (reserve(vertex_buffer_id, vertex_size, vertex_capacity, vertex_size + vs) || object_count == 0) {
+		o.set_vertex_array(id, vertex_buffer_id);
+	}
+	if (reserve(index_buffer_id, index_size, index_capacity, index_size + index_aligned)) {
+		bind_index_buffer();
+	}
+	
+	/* upload data to the end of buffers */
+	if (vs != 0) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer_id);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, vertex_size, vs, v);
+	}
+	if (is != 0) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer_id);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, index_size, is, i);
+	}
+	
+	/* record the sub-allocation in vertex object */
+	o.arena = this;
+	o.arena_vertex_start = vertex_size;
+	o.arena_vertex_size = vs;
+	o.arena_index_start = index_size;
+	o.arena_index_size = index_aligned;
+	o.arena_slot = objects.size();
+	objects.emplace_back(&o);
+	++object_count;
+	vertex_size += vs;
+	vertex_used += vs;
+	index_size += index_aligned;
+	index_used += index_aligned;
+}
+
+void GeometryArena::free(VertexObject& o) {
+	/* leave a hole in the slot of object */
+	o.arena = nullptr;
+	objects[o.arena_slot] = nullptr;
+	--object_count;
+	vertex_used -= o.arena_vertex_size;
+	index_used -= o.arena_index_size;
+	
+	/* shrink to the end of the last object, objects are in address order */
+	while (!objects.empty() && objects.back() == nullptr) objects.pop_back();
+	vertex_size = objects.empty() ? 0 : objects.back()->arena_vertex_start + objects.back()->arena_vertex_size;
+	index_size = objects.empty() ? 0 : objects.back()->arena_index_start + objects.back()->arena_index_size;
+}
+
+void GeometryArena::bind_index_buffer() const {
 	glBindVertexArray(id);
-	glDrawArrays(GL_TRIANGLES, 0, length);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_id);
+}
+
+int GeometryArena::get_attributes(const Mesh& m) {
+	int attributes = 0;
+	if (!m.normal.empty()) attributes |= ATTRIBUTE_NORMAL;
+	if (!m.uv.empty()) attributes |= ATTRIBUTE_UV;
+	if (!m.tangent.empty()) attributes |= ATTRIBUTE_TANGENT;
+	if (!m.color.empty()) attributes |= ATTRIBUTE_COLOR;
+	return attributes;
+}
+
+bool GeometryArena::reserve(uint32_t& b, size_t s, size_t& c, size_t n) {
+	if (n <= c) return false;
+	
+	/* double the capacity to amortize the copies */
+	size_t capacity = std::max({n, c * 2, ARENA_MIN_CAPACITY});
+	uint32_t buffer = 0;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+	if (s != 0) {
+		glBindBuffer(GL_COPY_READ_BUFFER, b);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, s);
+	}
+	if (b != 0) glDeleteBuffers(1, &b);
+	b = buffer;
+	c = capacity;
+	return true;
+}
+
+InstanceBuffer::InstanceBuffer() {
+	glGenBuffers(1, &id);
+}
+
+InstanceBuffer::~InstanceBuffer() {
+	glDeleteBuffers(1, &id);
+}
+
+void InstanceBuffer::load(const float* d, int c) {
+	/* orphan the previous storage to avoid synchronization */
+	glBindBuffer(GL_ARRAY_BUFFER, id);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * STRIDE * c, d, GL_STREAM_DRAW);
+}
+
+void InstanceBuffer::attach(const VertexObject& v, int f) const {
+	size_t stride = sizeof(float) * STRIDE;
+	size_t offset = stride * f;
+	glBindVertexArray(v.get_vertex_array());
+	glBindBuffer(GL_ARRAY_BUFFER, id);
+	
+	/* matrix inputs take one location for each column */
+	for (int i = 0; i < 4; ++i) {
+		int location = LOCATION_INSTANCE_MODEL + i;
+		void* pointer = reinterpret_cast<void*>(offset + sizeof(float) * i * 4);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, pointer);
+		glVertexAttribDivisor(location, 1);
+		glEnableVertexAttribArray(location);
+	}
+	for (int i = 0; i < 3; ++i) {
+		int location = LOCATION_INSTANCE_NORMAL + i;
+		void* pointer = reinterpret_cast<void*>(offset + sizeof(float) * (16 + i * 3));
+		glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride, pointer);
+		glVertexAttribDivisor(location, 1);
+		glEnableVertexAttribArray(location);
+	}
+}
+
+UniformBuffer::UniformBuffer() {
+	glGenBuffers(1, &id);
+}
+
+UniformBuffer::~UniformBuffer() {
+	glDeleteBuffers(1, &id);
+}
+
+void UniformBuffer::load(const void* d, size_t s) {
+	glBindBuffer(GL_UNIFORM_BUFFER, id);
+	if (s > capacity) {
+		glBufferData(GL_UNIFORM_BUFFER, s, d, GL_DYNAMIC_DRAW);
+		capacity = s;
+	} else {
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, s, d);
+	}
+}
+
+void UniformBuffer::activate(unsigned int b) const {
+	glBindBufferBase(GL_UNIFORM_BUFFER, b, id);
+}
+
+PixelBuffer::PixelBuffer() {
+	glGenBuffers(1, &id);
+}
+
+PixelBuffer::~PixelBuffer() {
+	glDeleteBuffers(1, &id);
+}
+
+void PixelBuffer::init(size_t s) {
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, id);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, s, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	size = s;
+}
+
+size_t PixelBuffer::get_size() const {
+	return size;
+}
+
+void* PixelBuffer::map(size_t o, size_t s) const {
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, id);
+	uint32_t access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+	void* pointer = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, o, s, access);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return pointer;
+}
+
+void PixelBuffer::unmap() const {
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, id);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+Fence::Fence() {
+	sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+Fence::~Fence() {
+	glDeleteSync(static_cast<GLsync>(sync));
+}
+
+bool Fence::is_signaled() const {
+	/* flush the commands so that the fence will be signaled eventually */
+	GLenum status = glClientWaitSync(static_cast<GLsync>(sync), GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
 }
 
 Texture::Texture() {
@@ -1214,6 +1906,39 @@ void Texture::init_2d(const Image& i, TextureFormat f, ImageFormat t) {
 	set_parameters(TEXTURE_2D, f);
 }
 
+void Texture::init_2d_storage(int w, int h, int l, TextureFormat f, ImageType t) {
+	int32_t sized = GL_TEXTURE_SIZED_INTERNAL_FORMATS[f];
+	uint32_t base = GL_TEXTURE_BASE_INTERNAL_FORMATS[f];
+	uint32_t data = GL_IMAGE_TYPES[t];
+	glBindTexture(GL_TEXTURE_2D, id);
+	for (int level = 0; level < l; ++level) {
+		int level_w = std::max(w >> level, 1);
+		int level_h = std::max(h >> level, 1);
+		glTexImage2D(GL_TEXTURE_2D, level, sized, level_w, level_h, 0, base, data, nullptr);
+	}
+	
+	/* sample the base level only until the mipmaps are generated */
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	set_dimensions(w, h, 0);
+	set_parameters(TEXTURE_2D, f);
+	storage_levels = l;
+}
+
+void Texture::update_2d(const PixelBuffer& b, size_t o, const Image& i, int y, int h, ImageFormat t) const {
+	uint32_t base = GL_IMAGE_FORMATS[t];
+	uint32_t data = GL_IMAGE_TYPES[i.bytes == 1 ? IMAGE_UBYTE : IMAGE_FLOAT];
+	if (base == GL_RGBA) base = GL_IMAGE_COLORS[i.channel - 1];
+	if (base == GL_RGBA_INTEGER) base = GL_IMAGE_COLOR_INTEGERS[i.channel - 1];
+	glBindTexture(GL_TEXTURE_2D, id);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, b.id);
+	
+	/* the rows are tightly packed in the pixel buffer */
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, i.width, h, base, data, reinterpret_cast<void*>(o));
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
 void Texture::init_3d(int w, int h, int d, TextureFormat f, ImageType t) {
 	int32_t sized = GL_TEXTURE_SIZED_INTERNAL_FORMATS[f];
 	uint32_t base = GL_TEXTURE_BASE_INTERNAL_FORMATS[f];
@@ -1337,6 +2062,7 @@ void Texture::copy_to_image(Image& i) const {
 void Texture::generate_mipmap() const {
 	uint32_t gl_type = GL_TEXTURE_TYPES[type];
 	glBindTexture(gl_type, id);
+	if (storage_levels != 0) glTexParameteri(gl_type, GL_TEXTURE_MAX_LEVEL, storage_levels - 1);
 	glGenerateMipmap(gl_type);
 }
 
@@ -1403,6 +2129,7 @@ void Texture::set_dimensions(int w, int h, int d) {
 	width = w;
 	height = h;
 	depth = d;
+	storage_levels = 0;
 }
 
 void Texture::set_parameters(TextureType t, TextureFormat f) {
@@ -29,6 +29,10 @@
 #include "../objects/Mesh.h"
 #include "../objects/Uniforms.h"
 
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+
 namespace ink::gpu {
 
 class Rect {
@@ -499,6 +503,37 @@ public:
 	 * Disables seamless cube texture accesses.
 	 */
 	static void disable_texture_cube_seamless();
+	
+	/**
+	 * Invalidates the cached pipeline states. The setters skip the GL calls
+	 * when the values are unchanged, so this should be called after the GL
+	 * states are changed without using State.
+	 */
+	static void invalidate();
+	
+private:
+	class Cache {
+	public:
+		std::optional<bool> depth_test;
+		std::optional<bool> stencil_test;
+		std::optional<bool> blending;
+		std::optional<bool> scissor_test;
+		std::optional<bool> culling;
+		std::optional<bool> wireframe;
+		std::optional<bool> depth_writemask;
+		std::optional<uint32_t> depth_func;
+		std::optional<uint32_t> stencil_writemask;
+		std::optional<std::tuple<uint32_t, int, int>> stencil_func;
+		std::optional<std::tuple<uint32_t, uint32_t, uint32_t>> stencil_op;
+		std::optional<std::tuple<uint32_t, uint32_t>> blend_op;
+		std::optional<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>> blend_factor;
+		std::optional<uint32_t> cull_side;
+		std::optional<std::tuple<bool, bool, bool, bool>> color_writemask;
+		std::optional<std::tuple<int, int, int, int>> viewport;
+		std::optional<std::tuple<int, int, int, int>> scissor;
+	};
+	
+	static Cache cache;
 };
 
 class MaterialState {
@@ -546,6 +581,35 @@ public:
 	static void set_shadow_side(const Material& m);
 };
 
+class UniformKey {
+public:
+	uint64_t hash = 0;    /**< the hash value of the uniform variable name */
+	
+	/**
+	 * Creates a new UniformKey object and initializes it with the name of the
+	 * uniform variable. The name is hashed at compile time if the key is
+	 * declared as constexpr.
+	 *
+	 * \param n variable name
+	 */
+	explicit constexpr UniformKey(const char* n);
+	
+	/**
+	 * Creates a new UniformKey object and initializes it with the name of the
+	 * uniform variable.
+	 *
+	 * \param n variable name
+	 */
+	explicit UniformKey(const std::string& n);
+	
+	/**
+	 * Returns the 64-bit FNV-1a hash value of the specified name.
+	 *
+	 * \param n variable name
+	 */
+	static constexpr uint64_t hash_name(const char* n);
+};
+
 class Shader {
 public:
 	/**
@@ -632,7 +696,10 @@ public:
 	void load_frag_file(const std::string& p);
 	
 	/**
-	 * Compiles the shader program if the shader has been changed.
+	 * Compiles the shader program if the shader has been changed. The vertex
+	 * inputs are bound to fixed locations before linking: vertex = 0,
+	 * normal = 1, uv = 2, tangent = 3, color = 4, instance_model = 5 and
+	 * instance_normal = 9.
 	 */
 	void compile() const;
 	
@@ -730,6 +797,87 @@ public:
 	 */
 	void set_uniform_m4(const std::string& n, const Mat4& v) const;
 	
+	/**
+	 * Sets the value of the uniform variable with the specified key. The
+	 * location is taken from the table resolved when linking the program.
+	 *
+	 * \param k variable key
+	 * \param v value
+	 */
+	void set_uniform_i(const UniformKey& k, int v) const;
+	
+	/**
+	 * Sets the value of the uniform variable with the specified key. The
+	 * location is taken from the table resolved when linking the program.
+	 *
+	 * \param k variable key
+	 * \param v value
+	 */
+	void set_uniform_u(const UniformKey& k, unsigned int v) const;
+	
+	/**
+	 * Sets the value of the uniform variable with the specified key. The
+	 * location is taken from the table resolved when linking the program.
+	 *
+	 * \param k variable key
+	 * \param v value
+	 */
+	void set_uniform_f(const UniformKey& k, float v) const;
+	
+	/**
+	 * Sets the value of the uniform variable with the specified key. The
+	 * location is taken from the table resolved when linking the program.
+	 *
+	 * \param k variable key
+	 * \param v value
+	 */
+	void set_uniform_v2(const UniformKey& k, const Vec2& v) const;
+	
+	/**
+	 * Sets the value of the uniform variable with the specified key. The
+	 * location is taken from the table resolved when linking the program.
+	 *
+	 * \param k variable key
+	 * \param v value
+	 */
+	void set_uniform_v3(const UniformKey& k, const Vec3& v) const;
+	
+	/**
+	 * Sets the value of the uniform variable with the specified key. The
+	 * location is taken from the table resolved when linking the program.
+	 *
+	 * \param k variable key
+	 * \param v value
+	 */
+	void set_uniform_v4(const UniformKey& k, const Vec4& v) const;
+	
+	/**
+	 * Sets the value of the uniform variable with the specified key. The
+	 * location is taken from the table resolved when linking the program.
+	 *
+	 * \param k variable key
+	 * \param v value
+	 */
+	void set_uniform_m2(const UniformKey& k, const Mat2& v) const;
+	
+	/**
+	 * Sets the value of the uniform variable with the specified key. The
+	 * location is taken from the table resolved when linking the program.
+	 *
+	 * \param k variable key
+	 * \param v value
+	 */
+	void set_uniform_m3(const UniformKey& k, const Mat3& v) const;
+	
+	/**
+	 * Sets the value of the uniform variable with the specified key. The
+	 * location is taken from the table resolved when linking the program.
+	 *
+	 * \param k variable key
+	 * \param v value
+	 */
+	void set_uniform_m4(const UniformKey& k, const Mat4& v) const;
+	
 	/**
 	 * Sets the value of the uniform variable. These uniform variables are then
 	 * available in the vertex, geometry, and fragment shaders.
@@ -738,6 +886,32 @@ public:
 	 */
 	void set_uniforms(const Uniforms& u) const;
 	
+	/**
+	 * Binds the uniform block with the specified name to the binding point.
+	 * The binding is remembered and unchanged bindings are skipped.
+	 *
+	 * \param n block name
+	 * \param b binding point
+	 */
+	void set_uniform_block(const std::string& n, unsigned int b) const;
+	
+	/**
+	 * Binds the uniform block with the specified key to the binding point.
+	 * The binding is remembered and unchanged bindings are skipped.
+	 *
+	 * \param k block key
+	 * \param b binding point
+	 */
+	void set_uniform_block(const UniformKey& k, unsigned int b) const;
+	
+	/**
+	 * Returns the location of the uniform variable with the specified key, or
+	 * -1 if the variable is not an active uniform of the program.
+	 *
+	 * \param k variable key
+	 */
+	int32_t get_uniform_location(const UniformKey& k) const;
+	
 	/**
 	 * Returns the GLSL version of the shading language.
 	 */
@@ -758,6 +932,10 @@ private:
 	std::string geom_shader;
 	std::string frag_shader;
 	
+	mutable std::unordered_map<uint64_t, int32_t> uniform_locations;
+	
+	mutable std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> uniform_blocks;
+	
 	static std::string glsl_version;
 	
 	uint32_t compile_shader(const std::string& s, int32_t t) const;
@@ -766,6 +944,8 @@ private:
 	
 	std::string get_link_info() const;
 	
+	void resolve_uniforms() const;
+	
 	void resolve_defines(std::string& s) const;
 	
 	static void resolve_version(std::string& s);
@@ -777,6 +957,8 @@ private:
 	friend class VertexObject;
 };
 
+class GeometryArena;
+
 class VertexObject {
 public:
 	/**
@@ -800,35 +982,413 @@ public:
 	VertexObject& operator=(const VertexObject&) = delete;
 	
 	/**
-	 * Loads the specified mesh to this vertex object.
+	 * Loads the specified mesh to this vertex object. If the mesh has indices,
+	 * only the vertices used by the group are loaded, and the indices are
+	 * stored as 16-bit or 32-bit integers depending on the vertex count.
+	 *
+	 * If quantization is enabled, the vertices are stored as normalized 16-bit
+	 * integers relative to the bounds of group, the normals are encoded with
+	 * octahedron in snorm16, the tangents are encoded with octahedron in
+	 * 10_10_10_2, the UVs are stored as half-floats and the colors are stored
+	 * as unorm8. The shader must decode them when USE_VERTEX_QUANTIZATION is
+	 * defined.
 	 *
 	 * \param m mesh
 	 * \param g material group
+	 * \param q whether to quantize the attributes
 	 */
-	void load(const Mesh& m, const MeshGroup& g);
+	void load(const Mesh& m, const MeshGroup& g, bool q = false);
 	
 	/**
-	 * Attaches this vertex object to the target shader to automatically match
-	 * the input data with the shader locations.
+	 * Loads the specified mesh to a sub-allocation of the geometry arena. The
+	 * attributes of arena are stored, so that the vertex objects in the same
+	 * arena share one vertex array, and the attributes missing in the mesh
+	 * are zeros. The vertex object is freed from the arena when it is deleted
+	 * or loaded again.
 	 *
-	 * \param s target shader
+	 * \param m mesh
+	 * \param g material group
+	 * \param a geometry arena
 	 */
-	void attach(const Shader& s) const;
+	void load(const Mesh& m, const MeshGroup& g, GeometryArena& a);
+	
+	/**
+	 * Returns true if the attributes of vertex object are quantized.
+	 */
+	bool is_quantized() const;
+	
+	/**
+	 * Returns the offset to decode the quantized vertices, which is the
+	 * minimum of the bounds of group.
+	 */
+	Vec3 get_vertex_offset() const;
+	
+	/**
+	 * Returns the scale to decode the quantized vertices, which is the size of
+	 * the bounds of group.
+	 */
+	Vec3 get_vertex_scale() const;
+	
+	/**
+	 * Returns the meshlets of the loaded group. The positions of meshlets are
+	 * relative to the first index of group.
+	 */
+	const std::vector<Meshlet>& get_meshlets() const;
+	
+	/**
+	 * Returns true if this vertex object shares the vertex array with the
+	 * specified vertex object, in which case switching between them does not
+	 * bind another vertex array.
+	 *
+	 * \param v vertex object
+	 */
+	bool shares_layout(const VertexObject& v) const;
 	
 	/**
 	 * Renders the vertex object to the current render target.
 	 */
 	void render() const;
 	
+	/**
+	 * Renders the specified number of instances of the vertex object to the
+	 * current render target. The instance buffer must be attached first.
+	 *
+	 * \param c the number of instances
+	 */
+	void render(int c) const;
+	
+	/**
+	 * Renders the specified ranges of the vertex object to the current render
+	 * target in one draw call, such as the meshlets survived from culling.
+	 *
+	 * \param f the first indices of ranges
+	 * \param c the numbers of indices of ranges
+	 * \param n the number of ranges
+	 */
+	void render(const int* f, const int* c, int n) const;
+	
 private:
 	uint32_t id = 0;
 	uint32_t buffer_id = 0;
+	uint32_t index_buffer_id = 0;
 	
 	int length = 0;
+	int index_type = 0;
+	int stride = 0;
+	
+	bool quantized = false;
+	Vec3 vertex_offset = {0, 0, 0};
+	Vec3 vertex_scale = {1, 1, 1};
 	
-	std::vector<std::string> names;
-	std::vector<int> sizes;
 	std::vector<int> locations;
+	std::vector<int> sizes;
+	std::vector<uint32_t> types;
+	std::vector<bool> normalized;
+	std::vector<int> offsets;
+	
+	std::vector<Meshlet> meshlets;
+	
+	GeometryArena* arena = nullptr;
+	size_t arena_vertex_start = 0;
+	size_t arena_vertex_size = 0;
+	size_t arena_index_start = 0;
+	size_t arena_index_size = 0;
+	size_t arena_slot = 0;
+	
+	friend class GeometryArena;
+	friend class InstanceBuffer;
+	
+	void load_data(const Mesh& m, const MeshGroup& g, bool q, GeometryArena* a);
+	
+	void set_vertex_array(uint32_t a, uint32_t b) const;
+	
+	uint32_t get_vertex_array() const;
+};
+
+class GeometryArena {
+public:
+	static constexpr int ATTRIBUTE_NORMAL = 1;  /**< the mesh has normals */
+	static constexpr int ATTRIBUTE_UV = 2;      /**< the mesh has UVs */
+	static constexpr int ATTRIBUTE_TANGENT = 4; /**< the mesh has tangents */
+	static constexpr int ATTRIBUTE_COLOR = 8;   /**< the mesh has colors */
+	
+	/**
+	 * Creates a new GeometryArena object with the specified vertex format.
+	 * Meshes should be loaded to the arena with the same attributes to avoid
+	 * storing the missing attributes.
+	 *
+	 * \param q whether to store quantized attributes
+	 * \param a the attributes to store, see get_attributes
+	 */
+	explicit GeometryArena(bool q = false, int a = 0);
+	
+	/**
+	 * Deletes this GeometryArena object. The vertex objects in the arena can
+	 * not be rendered after that.
+	 */
+	~GeometryArena();
+	
+	/**
+	 * GeometryArena is non-copyable. The copy constructor is deleted.
+	 */
+	GeometryArena(const GeometryArena&) = delete;
+	
+	/**
+	 * GeometryArena is non-copyable. The copy assignment operator is deleted.
+	 */
+	GeometryArena& operator=(const GeometryArena&) = delete;
+	
+	/**
+	 * Returns true if the attributes in the arena are quantized.
+	 */
+	bool is_quantized() const;
+	
+	/**
+	 * Returns the attributes stored in the arena except vertices.
+	 */
+	int get_attributes() const;
+	
+	/**
+	 * Returns the number of vertex objects in the arena.
+	 */
+	size_t get_object_count() const;
+	
+	/**
+	 * Returns the number of bytes used by vertices in the arena, including
+	 * the holes left by freed vertex objects.
+	 */
+	size_t get_vertex_size() const;
+	
+	/**
+	 * Returns the number of bytes used by indices in the arena, including the
+	 * holes left by freed vertex objects.
+	 */
+	size_t get_index_size() const;
+	
+	/**
+	 * Moves all the vertex objects to the front of buffers to remove the holes
+	 * left by freed vertex objects. This is called automatically by the next
+	 * allocation when more than half of the used bytes are holes.
+	 */
+	void defragment();
+	
+	/**
+	 * Returns the attributes of the specified mesh except vertices, which are
+	 * the combination of ATTRIBUTE_NORMAL, ATTRIBUTE_UV, ATTRIBUTE_TANGENT and
+	 * ATTRIBUTE_COLOR.
+	 *
+	 * \param m mesh
+	 */
+	static int get_attributes(const Mesh& m);
+	
+private:
+	uint32_t id = 0;
+	uint32_t vertex_buffer_id = 0;
+	uint32_t index_buffer_id = 0;
+	
+	bool quantized = false;
+	int attributes = 0;
+	
+	size_t object_count = 0;
+	size_t vertex_size = 0;
+	size_t vertex_used = 0;
+	size_t vertex_capacity = 0;
+	size_t index_size = 0;
+	size_t index_used = 0;
+	size_t index_capacity = 0;
+	
+	std::vector<VertexObject*> objects;
+	
+	friend class VertexObject;
+	
+	void allocate(VertexObject& o, const void* v, size_t vs, const void* i, size_t is);
+	
+	void free(VertexObject& o);
+	
+	void bind_index_buffer() const;
+	
+	static bool reserve(uint32_t& b, size_t s, size_t& c, size_t n);
+};
+
+class InstanceBuffer {
+public:
+	static constexpr int STRIDE = 25; /**< the number of floats per instance */
+	
+	/**
+	 * Creates a new InstanceBuffer object.
+	 */
+	InstanceBuffer();
+	
+	/**
+	 * Deletes this InstanceBuffer object.
+	 */
+	~InstanceBuffer();
+	
+	/**
+	 * InstanceBuffer is non-copyable. The copy constructor is deleted.
+	 */
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	
+	/**
+	 * InstanceBuffer is non-copyable. The copy assignment operator is deleted.
+	 */
+	InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+	
+	/**
+	 * Loads the specified per-instance data to this instance buffer. Each
+	 * instance is made of a column-major 4x4 model matrix followed by a
+	 * column-major 3x3 normal matrix.
+	 *
+	 * \param d data
+	 * \param c the number of instances
+	 */
+	void load(const float* d, int c);
+	
+	/**
+	 * Attaches this instance buffer to the vertex array of the vertex object
+	 * at the fixed locations of instance_model and instance_normal inputs.
+	 *
+	 * \param v vertex object
+	 * \param f the index of the first instance
+	 */
+	void attach(const VertexObject& v, int f) const;
+	
+private:
+	uint32_t id = 0;
+};
+
+class UniformBuffer {
+public:
+	/**
+	 * Creates a new UniformBuffer object.
+	 */
+	UniformBuffer();
+	
+	/**
+	 * Deletes this UniformBuffer object.
+	 */
+	~UniformBuffer();
+	
+	/**
+	 * UniformBuffer is non-copyable. The copy constructor is deleted.
+	 */
+	UniformBuffer(const UniformBuffer&) = delete;
+	
+	/**
+	 * UniformBuffer is non-copyable. The copy assignment operator is deleted.
+	 */
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+	
+	/**
+	 * Loads the specified data to this uniform buffer. The storage is only
+	 * reallocated when the data is larger than the current capacity.
+	 *
+	 * \param d data
+	 * \param s the size of data in bytes
+	 */
+	void load(const void* d, size_t s);
+	
+	/**
+	 * Binds this uniform buffer to the specified binding point.
+	 *
+	 * \param b binding point
+	 */
+	void activate(unsigned int b) const;
+	
+private:
+	uint32_t id = 0;
+	
+	size_t capacity = 0;
+};
+
+class PixelBuffer {
+public:
+	/**
+	 * Creates a new PixelBuffer object.
+	 */
+	PixelBuffer();
+	
+	/**
+	 * Deletes this PixelBuffer object.
+	 */
+	~PixelBuffer();
+	
+	/**
+	 * PixelBuffer is non-copyable. The copy constructor is deleted.
+	 */
+	PixelBuffer(const PixelBuffer&) = delete;
+	
+	/**
+	 * PixelBuffer is non-copyable. The copy assignment operator is deleted.
+	 */
+	PixelBuffer& operator=(const PixelBuffer&) = delete;
+	
+	/**
+	 * Initializes the pixel buffer with the specified size for streaming the
+	 * pixels to textures.
+	 *
+	 * \param s the size of buffer in bytes
+	 */
+	void init(size_t s);
+	
+	/**
+	 * Returns the size of buffer in bytes.
+	 */
+	size_t get_size() const;
+	
+	/**
+	 * Maps the range of buffer for writing without synchronization. The range
+	 * must not be in use by GPU, which can be tracked with fences. Returns
+	 * nullptr if failed.
+	 *
+	 * \param o the offset of range in bytes
+	 * \param s the size of range in bytes
+	 */
+	void* map(size_t o, size_t s) const;
+	
+	/**
+	 * Unmaps the buffer after the mapped range is written.
+	 */
+	void unmap() const;
+	
+private:
+	uint32_t id = 0;
+	
+	size_t size = 0;
+	
+	friend class Texture;
+};
+
+class Fence {
+public:
+	/**
+	 * Creates a new Fence object and inserts it into the command stream.
+	 */
+	Fence();
+	
+	/**
+	 * Deletes this Fence object.
+	 */
+	~Fence();
+	
+	/**
+	 * Fence is non-copyable. The copy constructor is deleted.
+	 */
+	Fence(const Fence&) = delete;
+	
+	/**
+	 * Fence is non-copyable. The copy assignment operator is deleted.
+	 */
+	Fence& operator=(const Fence&) = delete;
+	
+	/**
+	 * Returns true if the commands before the fence are completed on GPU. This
+	 * function never blocks.
+	 */
+	bool is_signaled() const;
+	
+private:
+	void* sync = nullptr;
 };
 
 class Texture {
@@ -881,6 +1441,33 @@ public:
 	 */
 	void init_2d(const Image& i, TextureFormat f, ImageFormat t = IMAGE_COLOR);
 	
+	/**
+	 * Initializes the texture as an empty 2D texture with the storage of all
+	 * the mipmap levels allocated at once. Only the base level is sampled
+	 * until generate_mipmap is called.
+	 *
+	 * \param w the width of the texture
+	 * \param h the height of the texture
+	 * \param l the number of mipmap levels
+	 * \param f texture format
+	 * \param t image data type
+	 */
+	void init_2d_storage(int w, int h, int l, TextureFormat f, ImageType t = IMAGE_UBYTE);
+	
+	/**
+	 * Updates the rows from y to y + h in the base level of the 2D texture
+	 * with the pixels in the pixel buffer. The pixels are tightly packed in
+	 * the same layout as the image.
+	 *
+	 * \param b pixel buffer
+	 * \param o the offset of pixels in the pixel buffer
+	 * \param i the image describing the layout of pixels
+	 * \param y the first row to update
+	 * \param h the number of rows to update
+	 * \param t image data format
+	 */
+	void update_2d(const PixelBuffer& b, size_t o, const Image& i, int y, int h, ImageFormat t = IMAGE_COLOR) const;
+	
 	/**
 	 * Initializes the texture as an empty 3D texture.
 	 *
@@ -988,7 +1575,8 @@ public:
 	void copy_to_image(Image& i) const;
 	
 	/**
-	 * Generates mipmaps for the texture.
+	 * Generates mipmaps for the texture. All the mipmap levels allocated by
+	 * init_2d_storage are sampled after that.
 	 */
 	void generate_mipmap() const;
 	
@@ -1080,6 +1668,7 @@ private:
 	int width = 0;
 	int height = 0;
 	int depth = 0;
+	int storage_levels = 0;
 	
 	TextureType type = TEXTURE_2D;
 	
@@ -1248,4 +1837,15 @@ private:
 	void set_framebuffer(const Renderbuffer& r, uint32_t a) const;
 };
 
+constexpr UniformKey::UniformKey(const char* n) : hash(hash_name(n)) {}
+
+constexpr uint64_t UniformKey::hash_name(const char* n) {
+	uint64_t value = 14695981039346656037ull;
+	while (*n != '\0') {
+		value ^= static_cast<uint8_t>(*n++);
+		value *= 1099511628211ull;
+	}
+	return value;
+}
+
 }
@@ -270,6 +270,9 @@ LoadObject Loader::load_obj(const std::string& p, const LoadObjOptions& o) {
 		}
 	}
 	
+	/* create the bounds of meshes */
+	for (auto& mesh : object.mesh) mesh.create_bounds();
+	
 	/* close file stream */
 	stream.close();
 	
@@ -0,0 +1,124 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Frustum.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace ink {
+
+Frustum::Frustum(const Mat4& m) {
+	/* extract planes from the rows of matrix */
+	Vec4 w = {m[3][0], m[3][1], m[3][2], m[3][3]};
+	for (int i = 0; i < 3; ++i) {
+		Vec4 row = {m[i][0], m[i][1], m[i][2], m[i][3]};
+		planes[i * 2] = w + row;
+		planes[i * 2 + 1] = w - row;
+	}
+	
+	/* normalize planes to make distances comparable */
+	for (auto& p : planes) {
+		float length = Vec3(p.x, p.y, p.z).magnitude();
+		if (length != 0) p /= length;
+	}
+}
+
+bool Frustum::intersects_box(const Vec3& l, const Vec3& u) const {
+	Vec3 c = (l + u) * .5f;
+	Vec3 e = (u - l) * .5f;
+	for (auto& p : planes) {
+		float d = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+		float r = fabsf(p.x) * e.x + fabsf(p.y) * e.y + fabsf(p.z) * e.z;
+		if (d + r < 0) return false;
+	}
+	return true;
+}
+
+bool Frustum::intersects_sphere(const Vec3& c, float r) const {
+	for (auto& p : planes) {
+		float d = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+		if (d + r < 0) return false;
+	}
+	return true;
+}
+
+void Frustum::intersects_boxes(const float* d, size_t n, uint8_t* r) const {
+	const float* cx = d;
+	const float* cy = d + n;
+	const float* cz = d + n * 2;
+	const float* ex = d + n * 3;
+	const float* ey = d + n * 4;
+	const float* ez = d + n * 5;
+	size_t i = 0;
+	
+#ifdef FRUSTUM_USE_SSE
+	/* test 4 boxes against each plane at a time */
+	__m128 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+	for (int j = 0; j < 6; ++j) {
+		px[j] = _mm_set1_ps(planes[j].x);
+		py[j] = _mm_set1_ps(planes[j].y);
+		pz[j] = _mm_set1_ps(planes[j].z);
+		pw[j] = _mm_set1_ps(planes[j].w);
+		ax[j] = _mm_set1_ps(fabsf(planes[j].x));
+		ay[j] = _mm_set1_ps(fabsf(planes[j].y));
+		az[j] = _mm_set1_ps(fabsf(planes[j].z));
+	}
+	__m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= n; i += 4) {
+		__m128 bcx = _mm_loadu_ps(cx + i);
+		__m128 bcy = _mm_loadu_ps(cy + i);
+		__m128 bcz = _mm_loadu_ps(cz + i);
+		__m128 bex = _mm_loadu_ps(ex + i);
+		__m128 bey = _mm_loadu_ps(ey + i);
+		__m128 bez = _mm_loadu_ps(ez + i);
+		__m128 outside = _mm_setzero_ps();
+		for (int j = 0; j < 6; ++j) {
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[j], bcx), _mm_mul_ps(py[j], bcy)),
+								  _mm_add_ps(_mm_mul_ps(pz[j], bcz), pw[j]));
+			__m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[j], bex), _mm_mul_ps(ay[j], bey)),
+								  _mm_mul_ps(az[j], bez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, e), zero));
+		}
+		int mask = _mm_movemask_ps(outside);
+		r[i    ] = (mask & 1) == 0;
+		r[i + 1] = (mask & 2) == 0;
+		r[i + 2] = (mask & 4) == 0;
+		r[i + 3] = (mask & 8) == 0;
+	}
+#endif
+	
+	/* test the remaining boxes one by one */
+	for (; i < n; ++i) {
+		bool inside = true;
+		for (auto& p : planes) {
+			float d = p.x * cx[i] + p.y * cy[i] + p.z * cz[i] + p.w;
+			float e = fabsf(p.x) * ex[i] + fabsf(p.y) * ey[i] + fabsf(p.z) * ez[i];
+			if (d + e < 0) inside = false;
+		}
+		r[i] = inside;
+	}
+}
+
+}
@@ -0,0 +1,79 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Vector.h"
+#include "Matrix.h"
+
+#include <cstdint>
+
+namespace ink {
+
+class Frustum {
+public:
+	Vec4 planes[6];    /**< the left, right, bottom, top, near and far planes, normals point inside */
+	
+	/**
+	 * Creates a new Frustum object.
+	 */
+	Frustum() = default;
+	
+	/**
+	 * Creates a new Frustum object and extracts the planes from the matrix of
+	 * view-projection transform. The planes are in world space.
+	 *
+	 * \param m view-projection matrix
+	 */
+	explicit Frustum(const Mat4& m);
+	
+	/**
+	 * Returns true if the AABB box intersects or is inside the frustum. The
+	 * test is conservative, some boxes near the corners may be accepted.
+	 *
+	 * \param l the lower boundary of the box
+	 * \param u the upper boundary of the box
+	 */
+	bool intersects_box(const Vec3& l, const Vec3& u) const;
+	
+	/**
+	 * Returns true if the sphere intersects or is inside the frustum.
+	 *
+	 * \param c the center of the sphere
+	 * \param r the radius of the sphere
+	 */
+	bool intersects_sphere(const Vec3& c, float r) const;
+	
+	/**
+	 * Tests the AABB boxes stored in SoA layout against the frustum in batch.
+	 * The data is made of 6 arrays of n floats, which are the X, Y, Z of
+	 * centers followed by the X, Y, Z of half extents. Writes 1 to the result
+	 * if the box intersects the frustum, 0 otherwise.
+	 *
+	 * \param d the centers and half extents of boxes
+	 * \param n the number of boxes
+	 * \param r the results of boxes
+	 */
+	void intersects_boxes(const float* d, size_t n, uint8_t* r) const;
+};
+
+}
@@ -30,6 +30,7 @@ Mesh BoxMesh::create() {
 	mesh.vertex = vertex;
 	mesh.uv = uv;
 	mesh.normal = normal;
+	mesh.create_bounds();
 	return mesh;
 }
 
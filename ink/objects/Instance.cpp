@@ -22,38 +22,42 @@
 
 #include "Instance.h"
 
+#include "../core/Error.h"
+#include "../scene/Scene.h"
+
 namespace ink {
 
 Instance::Instance(const std::string& n) : name(n) {}
 
+Instance::~Instance() {
+	if (tree_scene != nullptr) tree_scene->remove_leaf(*this, tree_leaf);
+	if (transform_system != nullptr) transform_system->release(transform_index);
+}
+
 void Instance::add(Instance* i) {
-	i->parent = this;
+	attach_child(i);
 	children.emplace_back(i);
 }
 
 void Instance::add(const std::initializer_list<Instance*>& l) {
-	for (auto& instance : l) {
-		instance->parent = this;
-	}
+	for (auto& instance : l) attach_child(instance);
 	children.insert(children.end(), l);
 }
 
 void Instance::remove(Instance* i) {
-	i->parent = nullptr;
+	detach_child(i);
 	std::erase(children, i);
 }
 
 void Instance::remove(const std::initializer_list<Instance*>& l) {
 	for (auto& instance : l) {
-		instance->parent = nullptr;
+		detach_child(instance);
 		std::erase(children, instance);
 	}
 }
 
 void Instance::clear() {
-	for (auto& child : children) {
-		child->parent = nullptr;
-	}
+	for (auto& child : children) detach_child(child);
 	children.clear();
 }
 
@@ -77,10 +81,64 @@ Instance* Instance::get_parent() const {
 	return parent;
 }
 
+bool Instance::is_visible() const {
+	return visible;
+}
+
+void Instance::set_visible(bool v) {
+	visible = v;
+	mark_subtree_dirty();
+}
+
+Mesh* Instance::get_mesh() const {
+	return mesh;
+}
+
+void Instance::set_mesh(Mesh* m) {
+	mesh = m;
+	mark_subtree_dirty();
+}
+
+Vec3 Instance::get_position() const {
+	return position;
+}
+
+void Instance::set_position(const Vec3& p) {
+	position = p;
+	mark_dirty();
+}
+
+Euler Instance::get_rotation() const {
+	return rotation;
+}
+
+void Instance::set_rotation(const Euler& r) {
+	rotation = r;
+	mark_dirty();
+}
+
+Vec3 Instance::get_scale() const {
+	return scale;
+}
+
+void Instance::set_scale(const Vec3& s) {
+	scale = s;
+	mark_dirty();
+}
+
 void Instance::set_transform(const Vec3& p, const Euler& r, const Vec3& s) {
 	position = p;
 	rotation = r;
 	scale = s;
+	mark_dirty();
+}
+
+Mat4 Instance::get_matrix_local() const {
+	return matrix_local;
+}
+
+Mat4 Instance::get_matrix_global() const {
+	return matrix_global;
 }
 
 void Instance::update_matrix_local() {
@@ -91,6 +149,30 @@ void Instance::update_matrix_global() {
 	matrix_global = transform_global();
 }
 
+void Instance::update_bounds() {
+	if (mesh != nullptr && mesh->bound_radius < 0) mesh->create_bounds();
+	calculate_bounds(bound_min, bound_max);
+}
+
+void Instance::get_bounds(Vec3& l, Vec3& u) const {
+	/* calculate the bounds if they are never updated by scene */
+	if (bounds_dirty || cached_mesh != mesh) {
+		calculate_bounds(l, u);
+	} else {
+		l = bound_min;
+		u = bound_max;
+	}
+}
+
+void Instance::mark_dirty() {
+	if (transform_system != nullptr) {
+		transform_system->mark_changed(transform_index, true);
+		return;
+	}
+	transform_dirty = true;
+	mark_subtree_dirty();
+}
+
 Vec3 Instance::global_to_local(const Vec3& v) const {
 	return inverse_4x4(matrix_global) * Vec4(v, 1);
 }
@@ -123,4 +205,125 @@ Mat4 Instance::transform(const Vec3& p, const Euler& r, const Vec3& s) {
 	};
 }
 
+const TransformSystem* Instance::get_transform_system() const {
+	return transform_system;
+}
+
+void Instance::attach_child(Instance* i) {
+	/* the flattened transforms of both hierarchies are out of date */
+	detach_transforms();
+	i->detach_transforms();
+	
+	/* the old and the new hierarchies share the instance from now on */
+	bool sharing = i->shared || i->parent != nullptr;
+	if (i->parent != nullptr) {
+		i->shared = true;
+		i->parent->mark_hierarchy_dirty(true);
+	}
+	i->parent = this;
+	
+	/* update the whole subtree under its new ancestors */
+	i->remove_leaves();
+	i->transform_dirty = true;
+	i->hierarchy_dirty = true;
+	i->sharing_dirty = true;
+	i->mark_hierarchy_dirty(sharing);
+}
+
+void Instance::detach_child(Instance* i) {
+	detach_transforms();
+	i->detach_transforms();
+	i->parent = nullptr;
+	i->hierarchy_dirty = true;
+	i->sharing_dirty = true;
+	i->remove_leaves();
+	mark_hierarchy_dirty(i->shared);
+}
+
+void Instance::mark_subtree_dirty() {
+	if (transform_system != nullptr) {
+		transform_system->mark_changed(transform_index, false);
+		return;
+	}
+	
+	/* mark the ancestors so that the scene only visits dirty subtrees */
+	Instance* instance = this;
+	while (instance != nullptr && !instance->subtree_dirty) {
+		instance->subtree_dirty = true;
+		instance = instance->parent;
+	}
+}
+
+void Instance::mark_hierarchy_dirty(bool s) {
+	/* mark the ancestors until the root, which is usually a scene */
+	Instance* instance = this;
+	while (true) {
+		instance->subtree_dirty = true;
+		if (instance->parent == nullptr) break;
+		instance = instance->parent;
+	}
+	instance->hierarchy_dirty = true;
+	instance->sharing_dirty = instance->sharing_dirty || s;
+}
+
+void Instance::remove_leaves() {
+	/* remove the subtree from the instance tree of its scene at once */
+	std::vector<Instance*> unvisited = {this};
+	while (!unvisited.empty()) {
+		Instance* current = unvisited.back();
+		unvisited.pop_back();
+		if (current->tree_scene != nullptr) {
+			current->tree_scene->remove_leaf(*current, current->tree_leaf);
+		}
+		unvisited.insert(unvisited.end(), current->children.begin(), current->children.end());
+	}
+}
+
+void Instance::detach_transforms() {
+	/* the scene flattens the hierarchies again in the next update */
+	if (transform_system != nullptr) transform_system->clear();
+}
+
+void Instance::prepare_bounds() {
+	/* update the bounds later if the bounds of mesh are out of date */
+	cached_mesh = mesh;
+	bounds_dirty = mesh != nullptr && mesh->bound_radius < 0;
+	if (!bounds_dirty) calculate_bounds(bound_min, bound_max);
+}
+
+void Instance::calculate_bounds(Vec3& l, Vec3& u) const {
+	/* the bounds of instance without mesh is its origin */
+	const Mat4& m = matrix_global;
+	Vec3 origin = {m[0][3], m[1][3], m[2][3]};
+	if (mesh == nullptr) {
+		l = origin;
+		u = origin;
+		return;
+	}
+	
+	/* the bounds of mesh are never created here, which may be shared */
+	if (mesh->bound_radius < 0) {
+		Error::set("Instance", "Bounds of mesh are out of date");
+		l = origin;
+		u = origin;
+		return;
+	}
+	
+	/* inflate the box by the padding of displacement */
+	Vec3 c = (mesh->bound_min + mesh->bound_max) * .5f;
+	Vec3 e = (mesh->bound_max - mesh->bound_min) * .5f + bound_padding;
+	Vec3 center = {
+		m[0][0] * c.x + m[0][1] * c.y + m[0][2] * c.z + m[0][3],
+		m[1][0] * c.x + m[1][1] * c.y + m[1][2] * c.z + m[1][3],
+		m[2][0] * c.x + m[2][1] * c.y + m[2][2] * c.z + m[2][3],
+	};
+	Vec3 extent = {
+		fabsf(m[0][0]) * e.x + fabsf(m[0][1]) * e.y + fabsf(m[0][2]) * e.z,
+		fabsf(m[1][0]) * e.x + fabsf(m[1][1]) * e.y + fabsf(m[1][2]) * e.z,
+		fabsf(m[2][0]) * e.x + fabsf(m[2][1]) * e.y + fabsf(m[2][2]) * e.z,
+	};
+	l = center - extent;
+	u = center + extent;
+}
+
 }
@@ -28,6 +28,12 @@
 
 namespace ink {
 
+class Material;
+
+class Scene;
+
+class TransformSystem;
+
 class Instance {
 public:
 	std::string name;              /**< instance name */
@@ -36,6 +42,8 @@ public:
 	
 	bool cast_shadow = true;       /**< whether the instance will cast shadows */
 	
+	bool occluder = false;         /**< whether the instance will occlude others in occlusion culling */
+	
 	int priority = 0;              /**< the sorting priority in rendering */
 	
 	Vec3 position = {0, 0, 0};     /**< the position vector of the instance */
@@ -50,6 +58,9 @@ public:
 	
 	Mesh* mesh = nullptr;          /**< the linked mesh of the instance */
 	
+	Vec3 bound_min = {0, 0, 0};    /**< the lower boundary of the bounding box in the global space */
+	Vec3 bound_max = {0, 0, 0};    /**< the upper boundary of the bounding box in the global space */
+	
 	/**
 	 * Creates a new Instance object, which is the minimum unit of rendering.
 	 *
@@ -57,6 +68,23 @@ public:
 	 */
 	Instance(const std::string& n = "");
 	
+	/**
+	 * Removes the leaf of the instance from the instance tree of its scene,
+	 * releases the slot of the instance in its transform system and deletes
+	 * this Instance object.
+	 */
+	~Instance();
+	
+	/**
+	 * Instance is non-copyable. The copy constructor is deleted.
+	 */
+	Instance(const Instance&) = delete;
+	
+	/**
+	 * Instance is non-copyable. The copy assignment operator is deleted.
+	 */
+	Instance& operator=(const Instance&) = delete;
+	
 	/**
 	 * Adds the specified instance as the child of this instance. The index
 	 * starts from zero.
@@ -74,14 +102,18 @@ public:
 	void add(const std::initializer_list<Instance*>& l);
 	
 	/**
-	 * Removes the specified instance as the child of this instance.
+	 * Removes the specified instance as the child of this instance. The
+	 * instance and its descendants are removed from the instance tree of scene
+	 * at once.
 	 *
 	 * \param i instance
 	 */
 	void remove(Instance* i);
 	
 	/**
-	 * Removes the specified instances as the children of this instance.
+	 * Removes the specified instances as the children of this instance. The
+	 * instances and their descendants are removed from the instance tree of
+	 * scene at once.
 	 *
 	 * \param l instance list
 	 */
@@ -117,7 +149,73 @@ public:
 	Instance* get_parent() const;
 	
 	/**
-	 * Sets the transform (position, rotation and scale) to this instance.
+	 * Returns whether the instance will be rendered.
+	 */
+	bool is_visible() const;
+	
+	/**
+	 * Sets whether the instance will be rendered.
+	 *
+	 * \param v visible
+	 */
+	void set_visible(bool v);
+	
+	/**
+	 * Returns the linked mesh of the instance.
+	 */
+	Mesh* get_mesh() const;
+	
+	/**
+	 * Links the specified mesh to the instance. The bounding box is
+	 * recalculated in the next update of scene.
+	 *
+	 * \param m mesh
+	 */
+	void set_mesh(Mesh* m);
+	
+	/**
+	 * Returns the position vector of the instance.
+	 */
+	Vec3 get_position() const;
+	
+	/**
+	 * Sets the position vector of the instance. The matrices of the instance
+	 * and its descendants are recalculated in the next update of scene.
+	 *
+	 * \param p position vector
+	 */
+	void set_position(const Vec3& p);
+	
+	/**
+	 * Returns the rotation angles of the instance.
+	 */
+	Euler get_rotation() const;
+	
+	/**
+	 * Sets the rotation angles of the instance. The matrices of the instance
+	 * and its descendants are recalculated in the next update of scene.
+	 *
+	 * \param r rotation angles
+	 */
+	void set_rotation(const Euler& r);
+	
+	/**
+	 * Returns the scaling vector of the instance.
+	 */
+	Vec3 get_scale() const;
+	
+	/**
+	 * Sets the scaling vector of the instance. The matrices of the instance
+	 * and its descendants are recalculated in the next update of scene.
+	 *
+	 * \param s scale vector
+	 */
+	void set_scale(const Vec3& s);
+	
+	/**
+	 * Sets the transform (position, rotation and scale) to this instance. The
+	 * matrices of the instance and its descendants are recalculated in the
+	 * next update of scene.
 	 *
 	 * \param p position vector
 	 * \param r rotation angles
@@ -125,6 +223,16 @@ public:
 	 */
 	void set_transform(const Vec3& p, const Euler& r, const Vec3& s);
 	
+	/**
+	 * Returns the transform matrix in the local space.
+	 */
+	Mat4 get_matrix_local() const;
+	
+	/**
+	 * Returns the transform matrix in the global space.
+	 */
+	Mat4 get_matrix_global() const;
+	
 	/**
 	 * Updates the local transform matrix.
 	 * This function is equivalent to "matrix_local = transform();".
@@ -137,6 +245,43 @@ public:
 	 */
 	void update_matrix_global();
 	
+	/**
+	 * Updates the bounding box in the global space from the bounding box of
+	 * the linked mesh. The bounds of mesh are created if they are out of date,
+	 * so this should not run alongside other users of the mesh. The box is
+	 * inflated by the displacement padding set by the scene. This function
+	 * only works when matrix_global is prepared.
+	 */
+	void update_bounds();
+	
+	/**
+	 * Gets the bounding box in the global space. If the instance is not
+	 * updated by the scene since it is created or its mesh is changed, the
+	 * box is calculated from matrix_global without being stored. The bounds
+	 * of mesh are never created here, an error is reported and the origin is
+	 * returned if they are out of date.
+	 *
+	 * \param l the lower boundary of the box
+	 * \param u the upper boundary of the box
+	 */
+	void get_bounds(Vec3& l, Vec3& u) const;
+	
+	/**
+	 * Marks the transform of this instance as changed. The matrices and bounds
+	 * of the instance and its descendants are recalculated in the next update
+	 * of scene. The setters mark the instance automatically. This should be
+	 * called after writing position, rotation, scale, visible or mesh
+	 * directly, or after the linked mesh is modified in place, otherwise the
+	 * changes are not seen by the scene.
+	 */
+	void mark_dirty();
+	
+	/**
+	 * Returns the transform system sweeping the transform of the instance, or
+	 * nullptr if the instance is updated through the pointer hierarchy.
+	 */
+	const TransformSystem* get_transform_system() const;
+	
 	/**
 	 * Converts the vector from the global space to the local space.
 	 * This function only works when matrix_global is prepared.
@@ -176,9 +321,54 @@ public:
 	static Mat4 transform(const Vec3& p, const Euler& r, const Vec3& s);
 	
 protected:
+	std::vector<Instance*> children;
+	
+	bool transform_dirty = true;
+	bool subtree_dirty = true;
+	bool bounds_dirty = true;
+	bool cached_visible = true;
+	bool bindings_dirty = false;
+	
+	float bound_padding = 0;
+	
+	const Mesh* cached_mesh = nullptr;
+	const Mesh* indexed_mesh = nullptr;
+	
+	Scene* tree_scene = nullptr;
+	int tree_leaf = -1;
+	
 	Instance* parent = nullptr;
 	
-	std::vector<Instance*> children;
+	bool shared = false;
+	bool hierarchy_dirty = false;
+	bool sharing_dirty = false;
+	
+	TransformSystem* transform_system = nullptr;
+	int transform_index = -1;
+	
+	mutable const Instance* binding_scene = nullptr;
+	mutable const Mesh* binding_mesh = nullptr;
+	mutable size_t binding_version = 0;
+	mutable std::vector<Material*> material_bindings;
+	
+	void attach_child(Instance* i);
+	
+	void detach_child(Instance* i);
+	
+	void mark_subtree_dirty();
+	
+	void mark_hierarchy_dirty(bool s);
+	
+	void remove_leaves();
+	
+	void detach_transforms();
+	
+	void prepare_bounds();
+	
+	void calculate_bounds(Vec3& l, Vec3& u) const;
+	
+	friend class Scene;
+	friend class TransformSystem;
 };
 
 }
@@ -24,6 +24,8 @@
 
 #include "../core/Error.h"
 
+#include <algorithm>
+#include <cstring>
 #include <unordered_map>
 
 namespace ink {
@@ -36,12 +38,14 @@ void Mesh::translate(float x, float y, float z) {
 		v.y += y;
 		v.z += z;
 	}
+	bound_radius = -1;
 }
 
 void Mesh::translate(const Vec3& t) {
 	for (auto& v : vertex) {
 		v += t;
 	}
+	bound_radius = -1;
 }
 
 void Mesh::rotate_x(float a) {
@@ -64,6 +68,7 @@ void Mesh::rotate_x(float a) {
 		t_xyz.z = sinf(a) * t.y + cosf(a) * t.z;
 		t = {t_xyz.normalize(), t.w};
 	}
+	bound_radius = -1;
 }
 
 void Mesh::rotate_y(float a) {
@@ -86,6 +91,7 @@ void Mesh::rotate_y(float a) {
 		t_xyz.z = -sinf(a) * t.x + cosf(a) * t.z;
 		t = {t_xyz.normalize(), t.w};
 	}
+	bound_radius = -1;
 }
 
 void Mesh::rotate_z(float a) {
@@ -108,6 +114,7 @@ void Mesh::rotate_z(float a) {
 		t_xyz.y = sinf(a) * t.x + cosf(a) * t.y;
 		t = {t_xyz.normalize(), t.w};
 	}
+	bound_radius = -1;
 }
 
 void Mesh::rotate(const Euler& e) {
@@ -122,6 +129,7 @@ void Mesh::rotate(const Euler& e) {
 		Vec3 t_xyz = rotation_matrix * Vec3(t.x, t.y, t.z);
 		t = {t_xyz.normalize(), t.w};
 	}
+	bound_radius = -1;
 }
 
 void Mesh::scale(float x, float y, float z) {
@@ -140,6 +148,7 @@ void Mesh::scale(float x, float y, float z) {
 		Vec3 t_xyz = {t.x * x, t.y * y, t.z * z};
 		t = {t_xyz.normalize(), t.w};
 	}
+	bound_radius = -1;
 }
 
 void Mesh::scale(const Vec3& s) {
@@ -153,6 +162,7 @@ void Mesh::scale(const Vec3& s) {
 		Vec3 t_xyz = {t.x * s.x, t.y * s.y, t.z * s.z};
 		t = {t_xyz.normalize(), t.w};
 	}
+	bound_radius = -1;
 }
 
 void Mesh::normalize() {
@@ -166,6 +176,9 @@ void Mesh::create_normals() {
 	if (vertex.empty()) {
 		return Error::set("Mesh", "Vertex information is missing");
 	}
+	if (!indices.empty()) {
+		return Error::set("Mesh", "Mesh is already indexed");
+	}
 	size_t size = vertex.size();
 	normal.resize(size);
 	std::unordered_map<std::string, Vec3> normals;
@@ -192,6 +205,9 @@ void Mesh::create_tangents() {
 	if (vertex.empty()) {
 		return Error::set("Mesh", "Vertex information is missing");
 	}
+	if (!indices.empty()) {
+		return Error::set("Mesh", "Mesh is already indexed");
+	}
 	if (uv.empty()) {
 		return Error::set("Mesh", "UV information is missing");
 	}
@@ -217,4 +233,117 @@ void Mesh::create_tangents() {
 	}
 }
 
+void Mesh::create_bounds() {
+	if (vertex.empty()) {
+		bound_min = {0, 0, 0};
+		bound_max = {0, 0, 0};
+		bound_center = {0, 0, 0};
+		bound_radius = 0;
+		return;
+	}
+	bound_min = vertex[0];
+	bound_max = vertex[0];
+	for (auto& v : vertex) {
+		bound_min = {std::min(bound_min.x, v.x), std::min(bound_min.y, v.y), std::min(bound_min.z, v.z)};
+		bound_max = {std::max(bound_max.x, v.x), std::max(bound_max.y, v.y), std::max(bound_max.z, v.z)};
+	}
+	bound_center = (bound_min + bound_max) * .5f;
+	float radius_2 = 0;
+	for (auto& v : vertex) {
+		Vec3 d = v - bound_center;
+		radius_2 = std::max(radius_2, d.dot(d));
+	}
+	bound_radius = sqrtf(radius_2);
+}
+
+void Mesh::create_indices() {
+	if (vertex.empty()) {
+		return Error::set("Mesh", "Vertex information is missing");
+	}
+	if (!indices.empty()) {
+		return Error::set("Mesh", "Mesh is already indexed");
+	}
+	
+	/* pack the attributes of each vertex into one tuple */
+	size_t size = vertex.size();
+	bool has_normal = !normal.empty();
+	bool has_uv = !uv.empty();
+	bool has_tangent = !tangent.empty();
+	bool has_color = !color.empty();
+	int stride = 3 + (has_normal ? 3 : 0) + (has_uv ? 2 : 0) + (has_tangent ? 4 : 0) + (has_color ? 3 : 0);
+	std::vector<float> tuples(size * stride);
+	for (int i = 0; i < size; ++i) {
+		float* tuple = tuples.data() + i * stride;
+		*tuple++ = vertex[i].x;
+		*tuple++ = vertex[i].y;
+		*tuple++ = vertex[i].z;
+		if (has_normal) {
+			*tuple++ = normal[i].x;
+			*tuple++ = normal[i].y;
+			*tuple++ = normal[i].z;
+		}
+		if (has_uv) {
+			*tuple++ = uv[i].x;
+			*tuple++ = uv[i].y;
+		}
+		if (has_tangent) {
+			*tuple++ = tangent[i].x;
+			*tuple++ = tangent[i].y;
+			*tuple++ = tangent[i].z;
+			*tuple++ = tangent[i].w;
+		}
+		if (has_color) {
+			*tuple++ = color[i].x;
+			*tuple++ = color[i].y;
+			*tuple++ = color[i].z;
+		}
+	}
+	
+	/* merge the vertices with identical tuples by hashing */
+	std::unordered_map<uint64_t, int> buckets;
+	std::vector<int> chains;
+	std::vector<int> sources;
+	indices.resize(size);
+	size_t tuple_size = sizeof(float) * stride;
+	for (int i = 0; i < size; ++i) {
+		const float* tuple = tuples.data() + i * stride;
+		uint64_t hash = 14695981039346656037ull;
+		auto* bytes = reinterpret_cast<const unsigned char*>(tuple);
+		for (int j = 0; j < tuple_size; ++j) {
+			hash = (hash ^ bytes[j]) * 1099511628211ull;
+		}
+		auto [bucket, inserted] = buckets.try_emplace(hash, -1);
+		int index = -1;
+		for (int j = bucket->second; j != -1; j = chains[j]) {
+			if (memcmp(tuple, tuples.data() + sources[j] * stride, tuple_size) == 0) {
+				index = j;
+				break;
+			}
+		}
+		if (index == -1) {
+			index = static_cast<int>(sources.size());
+			sources.emplace_back(i);
+			chains.emplace_back(bucket->second);
+			bucket->second = index;
+		}
+		indices[i] = index;
+	}
+	
+	/* keep the first vertex of each tuple */
+	size_t unique_size = sources.size();
+	for (int i = 0; i < unique_size; ++i) {
+		int source = sources[i];
+		vertex[i] = vertex[source];
+		if (has_normal) normal[i] = normal[source];
+		if (has_uv) uv[i] = uv[source];
+		if (has_tangent) tangent[i] = tangent[source];
+		if (has_color) color[i] = color[source];
+	}
+	vertex.resize(unique_size);
+	if (has_normal) normal.resize(unique_size);
+	if (has_uv) uv.resize(unique_size);
+	if (has_tangent) tangent.resize(unique_size);
+	if (has_color) color.resize(unique_size);
+}
+
 }
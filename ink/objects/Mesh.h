@@ -25,6 +25,7 @@
 #include "../math/Euler.h"
 #include "../math/Vector.h"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -36,6 +37,19 @@ struct MeshGroup {
 	int length = 0;
 };
 
+class Meshlet {
+public:
+	int position = 0;                 /**< the position of the first index in the mesh indices */
+	int length = 0;                   /**< the number of indices */
+	int vertex_count = 0;             /**< the number of unique vertices */
+	
+	Vec3 center = {0, 0, 0};          /**< the center of the bounding sphere */
+	float radius = 0;                 /**< the radius of the bounding sphere */
+	
+	Vec3 cone_axis = {0, 0, 0};       /**< the average direction of the normals of triangles */
+	float cone_cutoff = 1;            /**< the sine of the half angle of the normal cone, 1 if can not be culled */
+};
+
 class Mesh {
 public:
 	std::string name;                 /**< mesh name */
@@ -48,6 +62,18 @@ public:
 	std::vector<Vec4> tangent;        /**< the tangent for each vertex */
 	std::vector<Vec3> color;          /**< the color for each vertex */
 	
+	std::vector<uint32_t> indices;    /**< the vertex indices of triangles, empty if not indexed */
+	
+	Vec3 bound_min = {0, 0, 0};       /**< the lower boundary of the bounding box */
+	Vec3 bound_max = {0, 0, 0};       /**< the upper boundary of the bounding box */
+	Vec3 bound_center = {0, 0, 0};    /**< the center of the bounding sphere */
+	float bound_radius = -1;          /**< the radius of the bounding sphere, set to -1 after modifying vertex directly */
+	
+	std::vector<Mesh> lods;           /**< the simplified meshes from fine to coarse with the same groups */
+	float lod_error = 0;              /**< the simplification error relative to the bounding radius */
+	
+	std::vector<Meshlet> meshlets;    /**< the clusters of triangles in the ranges of indices, empty if not built */
+	
 	/**
 	 * Creates a new Mesh object and initializes it with name.
 	 *
@@ -126,14 +152,31 @@ public:
 	
 	/**
 	 * Calculates normals from the vertices, adds these normals to the mesh.
+	 * The mesh should not be indexed.
 	 */
 	void create_normals();
 	
 	/**
 	 * Calculates tangents from the vertices, normals, and UVs information, adds
-	 * these tangents to the mesh.
+	 * these tangents to the mesh. The mesh should not be indexed.
 	 */
 	void create_tangents();
+	
+	/**
+	 * Calculates the bounding box and the bounding sphere from the vertices.
+	 * The bounds are created by the built-in meshes and the loaders, and are
+	 * marked out of date by setting bound_radius to -1 when the mesh is
+	 * transformed. After modifying the vertices directly, set bound_radius to
+	 * -1 so that the scene recreates the bounds in its next update, or call
+	 * this function again. The bounds are never created in the queries.
+	 */
+	void create_bounds();
+	
+	/**
+	 * Merges the vertices with identical attributes and creates indices for
+	 * the triangles. The groups refer to the ranges of indices afterwards.
+	 */
+	void create_indices();
 };
 
 }
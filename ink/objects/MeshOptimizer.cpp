@@ -0,0 +1,509 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "MeshOptimizer.h"
+
+#include "../core/Error.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ink {
+
+constexpr int CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = .75f;
+constexpr float VALENCE_BOOST_SCALE = 2.f;
+constexpr float VALENCE_BOOST_POWER = .5f;
+constexpr int OVERDRAW_CACHE_SIZE = 16;
+constexpr float MESHLET_CONE_MIN_DOT = .1f;
+
+static float get_vertex_score(int p, int r) {
+	if (r == 0) return -1;
+	float score = 0;
+	if (p >= 0 && p < 3) score = LAST_TRIANGLE_SCORE;
+	if (p >= 3) score = powf(1 - (p - 3) / static_cast<float>(CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	return score + VALENCE_BOOST_SCALE * powf(static_cast<float>(r), -VALENCE_BOOST_POWER);
+}
+
+static int simulate_cache(const uint32_t* i, std::vector<int>& t, int& c, int s) {
+	int misses = 0;
+	for (int k = 0; k < 3; ++k) {
+		if (c - t[i[k]] < s) continue;
+		t[i[k]] = c++;
+		++misses;
+	}
+	return misses;
+}
+
+static Meshlet create_meshlet(const Mesh& m, int p, int l, const std::vector<uint32_t>& v) {
+	Meshlet meshlet;
+	meshlet.position = p;
+	meshlet.length = l;
+	meshlet.vertex_count = static_cast<int>(v.size());
+	
+	/* calculate the bounding sphere from the bounding box */
+	Vec3 min = m.vertex[v[0]];
+	Vec3 max = m.vertex[v[0]];
+	for (auto i : v) {
+		auto& vertex = m.vertex[i];
+		min = {std::min(min.x, vertex.x), std::min(min.y, vertex.y), std::min(min.z, vertex.z)};
+		max = {std::max(max.x, vertex.x), std::max(max.y, vertex.y), std::max(max.z, vertex.z)};
+	}
+	meshlet.center = (min + max) * .5f;
+	for (auto i : v) {
+		meshlet.radius = std::max(meshlet.radius, meshlet.center.distance(m.vertex[i]));
+	}
+	
+	/* calculate the normals of non-degenerate triangles */
+	const uint32_t* indices = m.indices.data() + p;
+	std::vector<Vec3> normals;
+	normals.reserve(l / 3);
+	for (int i = 0; i < l; i += 3) {
+		auto& a = m.vertex[indices[i + 0]];
+		auto& b = m.vertex[indices[i + 1]];
+		auto& c = m.vertex[indices[i + 2]];
+		Vec3 normal = (b - a).cross(c - a);
+		float length = normal.magnitude();
+		if (length > 0) normals.emplace_back(normal / length);
+	}
+	
+	/* calculate the normal cone around the average normal */
+	Vec3 axis = {0, 0, 0};
+	for (auto& normal : normals) axis += normal;
+	float axis_length = axis.magnitude();
+	if (axis_length == 0) return meshlet;
+	meshlet.cone_axis = axis / axis_length;
+	float min_dot = 1;
+	for (auto& normal : normals) {
+		min_dot = std::min(min_dot, normal.dot(meshlet.cone_axis));
+	}
+	
+	/* the meshlet can not be culled if the cone is too wide */
+	if (min_dot > MESHLET_CONE_MIN_DOT) {
+		meshlet.cone_cutoff = sqrtf(1 - min_dot * min_dot);
+	}
+	return meshlet;
+}
+
+template <typename Type>
+static void reorder(std::vector<Type>& a, const std::vector<int>& r) {
+	if (a.empty()) return;
+	std::vector<Type> reordered(a.size());
+	for (int i = 0; i < a.size(); ++i) reordered[r[i]] = a[i];
+	a.swap(reordered);
+}
+
+void MeshOptimizer::optimize_vertex_cache(Mesh& m) {
+	if (m.indices.empty()) {
+		return Error::set("MeshOptimizer", "Mesh is not indexed");
+	}
+	std::vector<int> local_ids(m.vertex.size(), -1);
+	for (auto& group : m.groups) {
+		uint32_t* indices = m.indices.data() + group.position;
+		int triangle_count = group.length / 3;
+		if (triangle_count == 0) continue;
+		
+		/* map the vertices of group to local ids */
+		std::vector<uint32_t> vertices;
+		std::vector<int> corners(triangle_count * 3);
+		for (int i = 0; i < triangle_count * 3; ++i) {
+			int& id = local_ids[indices[i]];
+			if (id == -1) {
+				id = static_cast<int>(vertices.size());
+				vertices.emplace_back(indices[i]);
+			}
+			corners[i] = id;
+		}
+		for (auto v : vertices) local_ids[v] = -1;
+		int vertex_count = static_cast<int>(vertices.size());
+		
+		/* build the triangle list of each vertex */
+		std::vector<int> remaining(vertex_count, 0);
+		for (int c : corners) ++remaining[c];
+		std::vector<int> offsets(vertex_count + 1, 0);
+		for (int i = 0; i < vertex_count; ++i) {
+			offsets[i + 1] = offsets[i] + remaining[i];
+		}
+		std::vector<int> triangle_lists(triangle_count * 3);
+		std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+		for (int i = 0; i < triangle_count * 3; ++i) {
+			triangle_lists[fill[corners[i]]++] = i / 3;
+		}
+		
+		/* calculate the initial scores */
+		std::vector<float> vertex_scores(vertex_count);
+		for (int i = 0; i < vertex_count; ++i) {
+			vertex_scores[i] = get_vertex_score(-1, remaining[i]);
+		}
+		std::vector<float> triangle_scores(triangle_count);
+		std::vector<bool> emitted(triangle_count, false);
+		int best = 0;
+		for (int i = 0; i < triangle_count; ++i) {
+			triangle_scores[i] = vertex_scores[corners[i * 3 + 0]] +
+								 vertex_scores[corners[i * 3 + 1]] +
+								 vertex_scores[corners[i * 3 + 2]];
+			if (triangle_scores[i] > triangle_scores[best]) best = i;
+		}
+		
+		/* emit the triangle with the best score one by one */
+		std::vector<uint32_t> output;
+		output.reserve(triangle_count * 3);
+		std::vector<int> cache;
+		std::vector<int> next_cache;
+		int cursor = 0;
+		for (int n = 0; n < triangle_count; ++n) {
+			
+			/* find the best triangle in all if no candidate */
+			if (best == -1) {
+				while (emitted[cursor]) ++cursor;
+				best = cursor;
+				for (int i = cursor + 1; i < triangle_count; ++i) {
+					if (emitted[i] || triangle_scores[i] <= triangle_scores[best]) continue;
+					best = i;
+				}
+			}
+			emitted[best] = true;
+			
+			/* remove the triangle from its vertices */
+			const int* triangle = corners.data() + best * 3;
+			next_cache.clear();
+			for (int j = 0; j < 3; ++j) {
+				int v = triangle[j];
+				output.emplace_back(vertices[v]);
+				if (std::find(next_cache.begin(), next_cache.end(), v) == next_cache.end()) {
+					next_cache.emplace_back(v);
+				}
+				int* list = triangle_lists.data() + offsets[v];
+				int count = remaining[v];
+				for (int k = 0; k < count; ++k) {
+					if (list[k] != best) continue;
+					list[k] = list[count - 1];
+					break;
+				}
+				--remaining[v];
+			}
+			for (int v : cache) {
+				if (v == triangle[0] || v == triangle[1] || v == triangle[2]) continue;
+				next_cache.emplace_back(v);
+			}
+			
+			/* update the scores of cached and evicted vertices */
+			for (int i = 0; i < next_cache.size(); ++i) {
+				int v = next_cache[i];
+				float score = get_vertex_score(i < CACHE_SIZE ? i : -1, remaining[v]);
+				float delta = score - vertex_scores[v];
+				vertex_scores[v] = score;
+				for (int k = 0; k < remaining[v]; ++k) {
+					triangle_scores[triangle_lists[offsets[v] + k]] += delta;
+				}
+			}
+			if (next_cache.size() > CACHE_SIZE) next_cache.resize(CACHE_SIZE);
+			cache.swap(next_cache);
+			
+			/* find the best triangle adjacent to the cache */
+			best = -1;
+			for (int v : cache) {
+				for (int k = 0; k < remaining[v]; ++k) {
+					int t = triangle_lists[offsets[v] + k];
+					if (best == -1 || triangle_scores[t] > triangle_scores[best]) best = t;
+				}
+			}
+		}
+		std::copy(output.begin(), output.end(), indices);
+	}
+	m.meshlets.clear();
+}
+
+void MeshOptimizer::optimize_overdraw(Mesh& m, float t) {
+	if (m.indices.empty()) {
+		return Error::set("MeshOptimizer", "Mesh is not indexed");
+	}
+	std::vector<int> timestamps(m.vertex.size(), -OVERDRAW_CACHE_SIZE);
+	int time = 0;
+	for (auto& group : m.groups) {
+		uint32_t* indices = m.indices.data() + group.position;
+		int triangle_count = group.length / 3;
+		if (triangle_count == 0) continue;
+		
+		/* calculate the ACMR of group */
+		int group_misses = 0;
+		time += OVERDRAW_CACHE_SIZE;
+		for (int i = 0; i < triangle_count; ++i) {
+			group_misses += simulate_cache(indices + i * 3, timestamps, time, OVERDRAW_CACHE_SIZE);
+		}
+		float group_acmr = static_cast<float>(group_misses) / triangle_count;
+		
+		/* split the triangles into clusters where the cache restarts */
+		std::vector<int> clusters = {0};
+		int cluster_misses = 0;
+		int cluster_triangles = 0;
+		time += OVERDRAW_CACHE_SIZE;
+		for (int i = 0; i < triangle_count; ++i) {
+			int misses = simulate_cache(indices + i * 3, timestamps, time, OVERDRAW_CACHE_SIZE);
+			if (cluster_triangles != 0) {
+				bool hard = misses == 3;
+				bool soft = misses >= 2 &&
+					cluster_misses <= group_acmr * t * cluster_triangles;
+				if (hard || soft) {
+					clusters.emplace_back(i);
+					cluster_misses = 0;
+					cluster_triangles = 0;
+				}
+			}
+			cluster_misses += misses;
+			++cluster_triangles;
+		}
+		clusters.emplace_back(triangle_count);
+		
+		/* calculate the centroid and normal of each cluster */
+		int cluster_count = static_cast<int>(clusters.size()) - 1;
+		std::vector<Vec3> centroids(cluster_count);
+		std::vector<Vec3> normals(cluster_count);
+		Vec3 group_centroid;
+		float group_area = 0;
+		for (int i = 0; i < cluster_count; ++i) {
+			Vec3 centroid;
+			Vec3 normal;
+			float area = 0;
+			for (int j = clusters[i]; j < clusters[i + 1]; ++j) {
+				Vec3 a = m.vertex[indices[j * 3 + 0]];
+				Vec3 b = m.vertex[indices[j * 3 + 1]];
+				Vec3 c = m.vertex[indices[j * 3 + 2]];
+				Vec3 n = (b - a).cross(c - a);
+				float w = n.magnitude();
+				centroid += (a + b + c) * (w / 3);
+				normal += n;
+				area += w;
+			}
+			group_centroid += centroid;
+			group_area += area;
+			centroids[i] = area == 0 ? centroid : centroid / area;
+			normals[i] = normal;
+		}
+		if (group_area != 0) group_centroid = group_centroid / group_area;
+		
+		/* sort the clusters facing outwards to the front */
+		std::vector<float> sort_keys(cluster_count);
+		for (int i = 0; i < cluster_count; ++i) {
+			float length = normals[i].magnitude();
+			if (length == 0) continue;
+			sort_keys[i] = (centroids[i] - group_centroid).dot(normals[i]) / length;
+		}
+		std::vector<int> order(cluster_count);
+		for (int i = 0; i < cluster_count; ++i) order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) -> bool {
+			return sort_keys[a] > sort_keys[b];
+		});
+		
+		/* write the clusters in sorted order */
+		std::vector<uint32_t> output;
+		output.reserve(triangle_count * 3);
+		for (int i : order) {
+			output.insert(output.end(), indices + clusters[i] * 3, indices + clusters[i + 1] * 3);
+		}
+		std::copy(output.begin(), output.end(), indices);
+	}
+	m.meshlets.clear();
+}
+
+void MeshOptimizer::optimize_vertex_fetch(Mesh& m) {
+	if (m.indices.empty()) {
+		return Error::set("MeshOptimizer", "Mesh is not indexed");
+	}
+	
+	/* assign new indices in the order of first use */
+	int vertex_count = static_cast<int>(m.vertex.size());
+	std::vector<int> remap(vertex_count, -1);
+	int next = 0;
+	for (auto& i : m.indices) {
+		if (remap[i] == -1) remap[i] = next++;
+		i = remap[i];
+	}
+	for (int i = 0; i < vertex_count; ++i) {
+		if (remap[i] == -1) remap[i] = next++;
+	}
+	
+	/* reorder the vertex attributes */
+	reorder(m.vertex, remap);
+	reorder(m.normal, remap);
+	reorder(m.uv, remap);
+	reorder(m.tangent, remap);
+	reorder(m.color, remap);
+}
+
+void MeshOptimizer::optimize(Mesh& m) {
+	if (m.indices.empty()) {
+		return Error::set("MeshOptimizer", "Mesh is not indexed");
+	}
+	optimize_vertex_cache(m);
+	optimize_overdraw(m);
+	optimize_vertex_fetch(m);
+}
+
+void MeshOptimizer::create_meshlets(Mesh& m, int v, int t) {
+	if (m.indices.empty()) {
+		return Error::set("MeshOptimizer", "Mesh is not indexed");
+	}
+	if (v < 3 || t < 1) {
+		return Error::set("MeshOptimizer", "Invalid meshlet size");
+	}
+	m.meshlets.clear();
+	std::vector<int> local_ids(m.vertex.size(), -1);
+	for (auto& group : m.groups) {
+		uint32_t* indices = m.indices.data() + group.position;
+		int triangle_count = group.length / 3;
+		if (triangle_count == 0) continue;
+		
+		/* map the vertices of group to local ids */
+		std::vector<uint32_t> vertices;
+		std::vector<int> corners(triangle_count * 3);
+		for (int i = 0; i < triangle_count * 3; ++i) {
+			int& id = local_ids[indices[i]];
+			if (id == -1) {
+				id = static_cast<int>(vertices.size());
+				vertices.emplace_back(indices[i]);
+			}
+			corners[i] = id;
+		}
+		for (auto i : vertices) local_ids[i] = -1;
+		int vertex_count = static_cast<int>(vertices.size());
+		
+		/* build the triangle list of each vertex */
+		std::vector<int> offsets(vertex_count + 1, 0);
+		for (int c : corners) ++offsets[c + 1];
+		for (int i = 0; i < vertex_count; ++i) offsets[i + 1] += offsets[i];
+		std::vector<int> triangle_lists(triangle_count * 3);
+		std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+		for (int i = 0; i < triangle_count * 3; ++i) {
+			triangle_lists[fill[corners[i]]++] = i / 3;
+		}
+		
+		/* grow the meshlets with the adjacent triangles greedily */
+		std::vector<uint32_t> output;
+		output.reserve(triangle_count * 3);
+		std::vector<bool> emitted(triangle_count, false);
+		std::vector<int> stamps(vertex_count, -1);
+		std::vector<int> meshlet_vertices;
+		std::vector<uint32_t> global_vertices;
+		int meshlet_start = 0;
+		int meshlet_id = 0;
+		int cursor = 0;
+		for (int n = 0; n < triangle_count; ++n) {
+			
+			/* find the triangle sharing the most vertices with meshlet */
+			int best = -1;
+			int best_shared = -1;
+			for (int i : meshlet_vertices) {
+				for (int k = offsets[i]; k < offsets[i + 1]; ++k) {
+					int triangle = triangle_lists[k];
+					if (emitted[triangle]) continue;
+					const int* c = corners.data() + triangle * 3;
+					int shared = (stamps[c[0]] == meshlet_id) +
+								 (stamps[c[1]] == meshlet_id) +
+								 (stamps[c[2]] == meshlet_id);
+					if (shared <= best_shared) continue;
+					best = triangle;
+					best_shared = shared;
+				}
+			}
+			
+			/* start from the first remaining triangle if no candidate */
+			if (best == -1) {
+				while (emitted[cursor]) ++cursor;
+				best = cursor;
+			}
+			const int* c = corners.data() + best * 3;
+			
+			/* count the vertices to be added to the meshlet */
+			int new_vertices = 0;
+			for (int j = 0; j < 3; ++j) {
+				bool added = stamps[c[j]] == meshlet_id;
+				for (int k = 0; k < j; ++k) added = added || c[k] == c[j];
+				new_vertices += !added;
+			}
+			
+			/* finish the meshlet if the triangle exceeds the limits */
+			int meshlet_length = static_cast<int>(output.size()) - meshlet_start;
+			bool full = meshlet_length == t * 3 ||
+				static_cast<int>(meshlet_vertices.size()) + new_vertices > v;
+			if (full) {
+				int position = group.position + meshlet_start;
+				std::copy(output.begin() + meshlet_start, output.end(), indices + meshlet_start);
+				m.meshlets.emplace_back(create_meshlet(m, position, meshlet_length, global_vertices));
+				meshlet_start = static_cast<int>(output.size());
+				meshlet_vertices.clear();
+				global_vertices.clear();
+				++meshlet_id;
+			}
+			
+			/* add the triangle to the meshlet */
+			emitted[best] = true;
+			for (int j = 0; j < 3; ++j) {
+				output.emplace_back(vertices[c[j]]);
+				if (stamps[c[j]] == meshlet_id) continue;
+				stamps[c[j]] = meshlet_id;
+				meshlet_vertices.emplace_back(c[j]);
+				global_vertices.emplace_back(vertices[c[j]]);
+			}
+		}
+		
+		/* finish the last meshlet of group */
+		int position = group.position + meshlet_start;
+		int meshlet_length = static_cast<int>(output.size()) - meshlet_start;
+		std::copy(output.begin() + meshlet_start, output.end(), indices + meshlet_start);
+		m.meshlets.emplace_back(create_meshlet(m, position, meshlet_length, global_vertices));
+	}
+}
+
+MeshStats MeshOptimizer::get_stats(const Mesh& m, int c) {
+	MeshStats stats;
+	if (m.indices.empty()) {
+		Error::set("MeshOptimizer", "Mesh is not indexed");
+		return stats;
+	}
+	std::vector<int> timestamps(m.vertex.size(), -c);
+	std::vector<bool> referenced(m.vertex.size(), false);
+	int time = 0;
+	int misses = 0;
+	int triangles = 0;
+	int vertices = 0;
+	for (auto& group : m.groups) {
+		const uint32_t* indices = m.indices.data() + group.position;
+		int triangle_count = group.length / 3;
+		time += c;
+		for (int i = 0; i < triangle_count; ++i) {
+			misses += simulate_cache(indices + i * 3, timestamps, time, c);
+		}
+		for (int i = 0; i < triangle_count * 3; ++i) {
+			if (referenced[indices[i]]) continue;
+			referenced[indices[i]] = true;
+			++vertices;
+		}
+		triangles += triangle_count;
+	}
+	if (triangles != 0) stats.acmr = static_cast<float>(misses) / triangles;
+	if (vertices != 0) stats.atvr = static_cast<float>(misses) / vertices;
+	return stats;
+}
+
+}
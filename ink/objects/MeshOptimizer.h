@@ -0,0 +1,98 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Mesh.h"
+
+namespace ink {
+
+class MeshStats {
+public:
+	float acmr = 0;    /**< the average cache miss ratio, transformed vertices per triangle */
+	float atvr = 0;    /**< the average transformed vertex ratio, transformed vertices per vertex */
+};
+
+class MeshOptimizer {
+public:
+	/**
+	 * Reorders the triangles of each group for the locality of post-transform
+	 * vertex cache with Forsyth's algorithm. The mesh must be indexed.
+	 *
+	 * \param m mesh
+	 */
+	static void optimize_vertex_cache(Mesh& m);
+	
+	/**
+	 * Reorders the clusters of triangles of each group to reduce overdraw.
+	 * The triangles are split into clusters where the vertex cache restarts,
+	 * then the clusters facing outwards are moved to the front. This should
+	 * be called after optimize_vertex_cache. The mesh must be indexed.
+	 *
+	 * \param m mesh
+	 * \param t the threshold of ACMR degradation allowed when splitting
+	 */
+	static void optimize_overdraw(Mesh& m, float t = 1.05f);
+	
+	/**
+	 * Reorders the vertices in the order of their first use by the indices
+	 * for the locality of vertex fetch. This should be called after the
+	 * triangles are reordered. The mesh must be indexed.
+	 *
+	 * \param m mesh
+	 */
+	static void optimize_vertex_fetch(Mesh& m);
+	
+	/**
+	 * Runs the vertex cache, overdraw and vertex fetch optimizations in order.
+	 * The mesh must be indexed.
+	 *
+	 * \param m mesh
+	 */
+	static void optimize(Mesh& m);
+	
+	/**
+	 * Splits the triangles of each group into meshlets with the specified
+	 * maximum numbers of vertices and triangles. The triangles are reordered
+	 * so that each meshlet refers to a contiguous range of indices, then the
+	 * bounding sphere and the normal cone of each meshlet are calculated to
+	 * cull the meshlets at render time. This should be called after the other
+	 * optimizations, and the meshlets are cleared when the triangles are
+	 * reordered again. The mesh must be indexed.
+	 *
+	 * \param m mesh
+	 * \param v the maximum number of vertices of meshlet
+	 * \param t the maximum number of triangles of meshlet
+	 */
+	static void create_meshlets(Mesh& m, int v = 64, int t = 124);
+	
+	/**
+	 * Returns the ACMR and ATVR of the mesh by simulating a FIFO vertex cache
+	 * of the specified size. The cache is restarted for each group.
+	 *
+	 * \param m mesh
+	 * \param c the size of vertex cache
+	 */
+	static MeshStats get_stats(const Mesh& m, int c = 16);
+};
+
+}
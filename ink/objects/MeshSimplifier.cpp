@@ -0,0 +1,293 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "MeshSimplifier.h"
+
+#include "../core/Error.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <tuple>
+#include <unordered_map>
+
+namespace ink {
+
+/* the symmetric matrix, vector, constant and weight of quadric */
+using Quadric = std::array<double, 11>;
+
+static void add_plane(Quadric& q, const Vec3& n, double d, double w) {
+	q[0] += w * n.x * n.x;
+	q[1] += w * n.x * n.y;
+	q[2] += w * n.x * n.z;
+	q[3] += w * n.y * n.y;
+	q[4] += w * n.y * n.z;
+	q[5] += w * n.z * n.z;
+	q[6] += w * n.x * d;
+	q[7] += w * n.y * d;
+	q[8] += w * n.z * d;
+	q[9] += w * d * d;
+	q[10] += w;
+}
+
+static void add_quadric(Quadric& q, const Quadric& r) {
+	for (int i = 0; i < 11; ++i) q[i] += r[i];
+}
+
+static double get_cost(const Quadric& q, const Quadric& r, const Vec3& p) {
+	double weight = q[10] + r[10];
+	if (weight == 0) return 0;
+	double x = p.x;
+	double y = p.y;
+	double z = p.z;
+	double error = (q[0] + r[0]) * x * x + (q[3] + r[3]) * y * y + (q[5] + r[5]) * z * z +
+		2 * ((q[1] + r[1]) * x * y + (q[2] + r[2]) * x * z + (q[4] + r[4]) * y * z) +
+		2 * ((q[6] + r[6]) * x + (q[7] + r[7]) * y + (q[8] + r[8]) * z) + (q[9] + r[9]);
+	return std::max(error, 0.) / weight;
+}
+
+template <typename Type>
+static void copy_attribute(const std::vector<Type>& s, std::vector<Type>& d, const std::vector<uint32_t>& v) {
+	if (s.empty()) return;
+	d.resize(v.size());
+	for (int i = 0; i < v.size(); ++i) d[i] = s[v[i]];
+}
+
+Mesh MeshSimplifier::simplify(const Mesh& m, float r, float e) {
+	if (m.indices.empty()) {
+		Error::set("MeshSimplifier", "Mesh is not indexed");
+		return Mesh(m.name);
+	}
+	auto& vertex = m.vertex;
+	int vertex_count = static_cast<int>(vertex.size());
+	int triangle_count = static_cast<int>(m.indices.size() / 3);
+	
+	/* lock the vertices sharing positions, which are on seams */
+	std::vector<int> sorted(vertex_count);
+	for (int i = 0; i < vertex_count; ++i) sorted[i] = i;
+	std::sort(sorted.begin(), sorted.end(), [&](int a, int b) -> bool {
+		auto& u = vertex[a];
+		auto& v = vertex[b];
+		return u.x != v.x ? u.x < v.x : u.y != v.y ? u.y < v.y : u.z < v.z;
+	});
+	std::vector<bool> locked(vertex_count, false);
+	for (int i = 0; i < vertex_count;) {
+		int j = i + 1;
+		while (j < vertex_count && vertex[sorted[j]] == vertex[sorted[i]]) ++j;
+		for (int k = i; j - i > 1 && k < j; ++k) locked[sorted[k]] = true;
+		i = j;
+	}
+	
+	/* lock the vertices on the boundaries of groups */
+	std::vector<int> triangle_groups(triangle_count, -1);
+	std::vector<int> vertex_groups(vertex_count, -1);
+	for (int g = 0; g < m.groups.size(); ++g) {
+		auto& group = m.groups[g];
+		for (int i = group.position; i < group.position + group.length; ++i) {
+			uint32_t v = m.indices[i];
+			if (vertex_groups[v] != -1 && vertex_groups[v] != g) locked[v] = true;
+			vertex_groups[v] = g;
+			triangle_groups[i / 3] = g;
+		}
+	}
+	
+	/* lock the vertices on open borders and non-manifold edges */
+	std::unordered_map<uint64_t, int> edge_counts;
+	for (int i = 0; i < triangle_count * 3; ++i) {
+		uint32_t a = m.indices[i];
+		uint32_t b = m.indices[i % 3 == 2 ? i - 2 : i + 1];
+		++edge_counts[uint64_t(std::min(a, b)) << 32 | std::max(a, b)];
+	}
+	for (auto& [edge, count] : edge_counts) {
+		if (count == 2) continue;
+		locked[edge >> 32] = true;
+		locked[edge & 0xffffffff] = true;
+	}
+	
+	/* accumulate the quadrics of planes weighted by area */
+	std::vector<Quadric> quadrics(vertex_count);
+	for (int i = 0; i < triangle_count; ++i) {
+		const uint32_t* t = m.indices.data() + i * 3;
+		Vec3 n = (vertex[t[1]] - vertex[t[0]]).cross(vertex[t[2]] - vertex[t[0]]);
+		float area = n.magnitude();
+		if (area == 0) continue;
+		n = n / area;
+		double d = -n.dot(vertex[t[0]]);
+		for (int k = 0; k < 3; ++k) add_plane(quadrics[t[k]], n, d, area * .5);
+	}
+	
+	/* calculate the bounding radius to scale errors */
+	Vec3 bound_min = vertex.empty() ? Vec3() : vertex[0];
+	Vec3 bound_max = bound_min;
+	for (auto& v : vertex) {
+		bound_min = {std::min(bound_min.x, v.x), std::min(bound_min.y, v.y), std::min(bound_min.z, v.z)};
+		bound_max = {std::max(bound_max.x, v.x), std::max(bound_max.y, v.y), std::max(bound_max.z, v.z)};
+	}
+	Vec3 bound_center = (bound_min + bound_max) * .5f;
+	float radius = 0;
+	for (auto& v : vertex) radius = std::max(radius, (v - bound_center).magnitude());
+	
+	/* collapse edges in passes until the target is reached */
+	std::vector<uint32_t> indices = m.indices;
+	int live_count = triangle_count;
+	int target_count = static_cast<int>(triangle_count * r);
+	double max_error = static_cast<double>(e) * radius * e * radius;
+	double lod_error = 0;
+	std::vector<uint32_t> remap(vertex_count);
+	std::vector<int> offsets(vertex_count + 1);
+	std::vector<int> fill(vertex_count);
+	std::vector<int> adjacency;
+	std::vector<bool> touched(vertex_count);
+	std::vector<std::tuple<double, uint32_t, uint32_t>> collapses;
+	while (live_count > target_count) {
+		int index_count = static_cast<int>(indices.size());
+		
+		/* calculate the costs of collapsing unlocked vertices */
+		collapses.clear();
+		for (int i = 0; i < index_count; ++i) {
+			uint32_t a = indices[i];
+			uint32_t b = indices[i % 3 == 2 ? i - 2 : i + 1];
+			if (!locked[a]) collapses.emplace_back(get_cost(quadrics[a], quadrics[b], vertex[b]), a, b);
+			if (!locked[b]) collapses.emplace_back(get_cost(quadrics[b], quadrics[a], vertex[a]), b, a);
+		}
+		std::sort(collapses.begin(), collapses.end());
+		
+		/* build the triangle list of each vertex */
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (uint32_t v : indices) ++offsets[v + 1];
+		for (int i = 0; i < vertex_count; ++i) offsets[i + 1] += offsets[i];
+		std::copy(offsets.begin(), offsets.end() - 1, fill.begin());
+		adjacency.resize(index_count);
+		for (int i = 0; i < index_count; ++i) adjacency[fill[indices[i]]++] = i / 3;
+		
+		/* collapse the cheapest edges, one for each neighborhood per pass */
+		std::fill(touched.begin(), touched.end(), false);
+		for (int i = 0; i < vertex_count; ++i) remap[i] = i;
+		int collapse_count = 0;
+		for (auto& [cost, u, v] : collapses) {
+			if (cost > max_error || live_count <= target_count) break;
+			if (touched[u] || touched[v]) continue;
+			
+			/* reject the collapse if any remaining triangle flips */
+			int removed = 0;
+			bool flipped = false;
+			for (int k = offsets[u]; k < offsets[u + 1]; ++k) {
+				const uint32_t* t = indices.data() + adjacency[k] * 3;
+				if (t[0] == v || t[1] == v || t[2] == v) {
+					++removed;
+					continue;
+				}
+				Vec3 p0 = vertex[t[0]];
+				Vec3 p1 = vertex[t[1]];
+				Vec3 p2 = vertex[t[2]];
+				Vec3 n0 = (p1 - p0).cross(p2 - p0);
+				if (t[0] == u) p0 = vertex[v];
+				if (t[1] == u) p1 = vertex[v];
+				if (t[2] == u) p2 = vertex[v];
+				Vec3 n1 = (p1 - p0).cross(p2 - p0);
+				if (n0.dot(n0) != 0 && n0.dot(n1) <= 0) {
+					flipped = true;
+					break;
+				}
+			}
+			if (flipped) continue;
+			
+			/* collapse vertex u to vertex v */
+			remap[u] = v;
+			add_quadric(quadrics[v], quadrics[u]);
+			for (int k = offsets[u]; k < offsets[u + 1]; ++k) {
+				const uint32_t* t = indices.data() + adjacency[k] * 3;
+				touched[t[0]] = touched[t[1]] = touched[t[2]] = true;
+			}
+			live_count -= removed;
+			lod_error = std::max(lod_error, cost);
+			++collapse_count;
+		}
+		if (collapse_count == 0) break;
+		
+		/* remap the indices and remove degenerate triangles */
+		int kept = 0;
+		for (int i = 0; i < index_count; i += 3) {
+			uint32_t a = remap[indices[i + 0]];
+			uint32_t b = remap[indices[i + 1]];
+			uint32_t c = remap[indices[i + 2]];
+			if (a == b || b == c || c == a) continue;
+			indices[kept + 0] = a;
+			indices[kept + 1] = b;
+			indices[kept + 2] = c;
+			triangle_groups[kept / 3] = triangle_groups[i / 3];
+			kept += 3;
+		}
+		indices.resize(kept);
+		triangle_groups.resize(kept / 3);
+		live_count = kept / 3;
+	}
+	
+	/* put the remaining triangles in the order of groups */
+	Mesh lod(m.name);
+	std::vector<std::vector<uint32_t>> group_indices(m.groups.size());
+	for (int i = 0; i < indices.size(); i += 3) {
+		int group = triangle_groups[i / 3];
+		if (group == -1) continue;
+		group_indices[group].insert(group_indices[group].end(), indices.begin() + i, indices.begin() + i + 3);
+	}
+	
+	/* compact the vertices used by the remaining triangles */
+	std::vector<int> new_ids(vertex_count, -1);
+	std::vector<uint32_t> old_ids;
+	for (int g = 0; g < m.groups.size(); ++g) {
+		int position = static_cast<int>(lod.indices.size());
+		int length = static_cast<int>(group_indices[g].size());
+		lod.groups.push_back({m.groups[g].name, position, length});
+		for (uint32_t v : group_indices[g]) {
+			if (new_ids[v] == -1) {
+				new_ids[v] = static_cast<int>(old_ids.size());
+				old_ids.emplace_back(v);
+			}
+			lod.indices.emplace_back(new_ids[v]);
+		}
+	}
+	copy_attribute(m.vertex, lod.vertex, old_ids);
+	copy_attribute(m.normal, lod.normal, old_ids);
+	copy_attribute(m.uv, lod.uv, old_ids);
+	copy_attribute(m.tangent, lod.tangent, old_ids);
+	copy_attribute(m.color, lod.color, old_ids);
+	lod.create_bounds();
+	lod.lod_error = radius == 0 ? 0 : static_cast<float>(sqrt(lod_error)) / radius;
+	return lod;
+}
+
+void MeshSimplifier::create_lods(Mesh& m, const std::vector<float>& e) {
+	if (m.indices.empty()) {
+		return Error::set("MeshSimplifier", "Mesh is not indexed");
+	}
+	m.lods.clear();
+	size_t last_count = m.indices.size();
+	for (float error : e) {
+		Mesh lod = simplify(m, 0, error);
+		if (lod.indices.size() >= last_count) continue;
+		last_count = lod.indices.size();
+		m.lods.emplace_back(std::move(lod));
+	}
+}
+
+}
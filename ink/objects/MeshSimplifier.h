@@ -0,0 +1,58 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Mesh.h"
+
+namespace ink {
+
+class MeshSimplifier {
+public:
+	/**
+	 * Simplifies the mesh with quadric error metric by collapsing edges until
+	 * the number of triangles reaches the target ratio or the error exceeds
+	 * the limit. Vertices on UV or normal seams, open borders and boundaries
+	 * of groups are locked, so that the seams and groups are kept. Returns
+	 * the simplified mesh with the same groups and its error. The mesh must
+	 * be indexed.
+	 *
+	 * \param m mesh
+	 * \param r the target ratio of triangles
+	 * \param e the maximum error relative to the bounding radius
+	 */
+	static Mesh simplify(const Mesh& m, float r, float e);
+	
+	/**
+	 * Creates the levels of detail of the mesh, one for each error threshold.
+	 * The LODs are simplified from the mesh as much as the thresholds allow,
+	 * and the LODs which do not reduce triangles are discarded. The mesh must
+	 * be indexed, and should be unloaded from renderers before creating the
+	 * LODs again.
+	 *
+	 * \param m mesh
+	 * \param e the error thresholds relative to the bounding radius
+	 */
+	static void create_lods(Mesh& m, const std::vector<float>& e);
+};
+
+}
@@ -37,7 +37,7 @@ void BlendPass::render() {
 	blend_shader->use_program();
 	blend_shader->set_uniform_i("map_a", map_a->activate(0));
 	blend_shader->set_uniform_i("map_b", map_b->activate(1));
-	RenderPass::render_to(blend_shader, target);
+	RenderPass::render_to(target);
 }
 
 const gpu::Texture* BlendPass::get_texture_a() const {
@@ -76,7 +76,7 @@ void BloomPass::render() {
 	bright_pass_shader->set_uniform_f("threshold", threshold);
 	bright_pass_shader->set_uniform_i("map", map->activate(0));
 	bloom_target->set_texture(*bloom_map_1, 0, 0);
-	RenderPass::render_to(bright_pass_shader, bloom_target.get());
+	RenderPass::render_to(bloom_target.get());
 	
 	/* initialize size lod */
 	Vec2 size_lod = Vec2(width / 2, height / 2);
@@ -96,7 +96,7 @@ void BloomPass::render() {
 		blur_shader->set_uniform_f("sigma_s", sigma);
 		blur_shader->set_uniform_i("map", bloom_map_1->activate(0));
 		bloom_target->set_texture(*bloom_map_2, 0, lod);
-		RenderPass::render_to(blur_shader, bloom_target.get());
+		RenderPass::render_to(bloom_target.get());
 		
 		/* blur texture vertically */
 		blur_shader->use_program();
@@ -106,7 +106,7 @@ void BloomPass::render() {
 		blur_shader->set_uniform_f("sigma_s", sigma);
 		blur_shader->set_uniform_i("map", bloom_map_2->activate(0));
 		bloom_target->set_texture(*bloom_map_1, 0, lod);
-		RenderPass::render_to(blur_shader, bloom_target.get());
+		RenderPass::render_to(bloom_target.get());
 		
 		/* update size lod to lower lod */
 		size_lod.x = fmax(1, floorf(size_lod.x / 2));
@@ -123,7 +123,7 @@ void BloomPass::render() {
 	bloom_shader->set_uniform_f("radius", radius);
 	bloom_shader->set_uniform_i("map", map->activate(0));
 	bloom_shader->set_uniform_i("bloom_map", bloom_map_1->activate(1));
-	RenderPass::render_to(bloom_shader, target);
+	RenderPass::render_to(target);
 }
 
 const gpu::Texture* BloomPass::get_texture() const {
@@ -104,7 +104,7 @@ void BlurPass::render() {
 		blur_shader->set_uniform_f("sigma_r", sigma_r);
 	}
 	blur_shader->set_uniform_i("map", map->activate(0));
-	RenderPass::render_to(blur_shader, blur_target_1.get());
+	RenderPass::render_to(blur_target_1.get());
 	
 	/* 2. blur texture vertically */
 	blur_shader->use_program();
@@ -118,7 +118,7 @@ void BlurPass::render() {
 		blur_shader->set_uniform_f("sigma_r", sigma_r);
 	}
 	blur_shader->set_uniform_i("map", blur_map_1->activate(0));
-	RenderPass::render_to(blur_shader, blur_target_2.get());
+	RenderPass::render_to(blur_target_2.get());
 	
 	/* set back to the initial viewport */
 	RenderPass::set_viewport(viewport);
@@ -126,7 +126,7 @@ void BlurPass::render() {
 	/* 3. render results to render target (up-sampling) */
 	copy_shader->use_program();
 	copy_shader->set_uniform_i("map", blur_map_2->activate(0));
-	RenderPass::render_to(copy_shader, target);
+	RenderPass::render_to(target);
 }
 
 const gpu::Texture* BlurPass::get_texture() const {
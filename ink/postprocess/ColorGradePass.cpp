@@ -37,7 +37,7 @@ void ColorGradePass::render() {
 	color_grade_shader->set_uniform_v3("gain", gain);
 	color_grade_shader->set_uniform_v3("offset", offset);
 	color_grade_shader->set_uniform_i("map", map->activate(0));
-	RenderPass::render_to(color_grade_shader, target);
+	RenderPass::render_to(target);
 }
 
 const gpu::Texture* ColorGradePass::get_texture() const {
@@ -33,7 +33,7 @@ void CopyPass::render() {
 	copy_shader->use_program();
 	copy_shader->set_uniform_f("lod", 0);
 	copy_shader->set_uniform_i("map", map->activate(0));
-	RenderPass::render_to(copy_shader, target);
+	RenderPass::render_to(target);
 }
 
 const gpu::Texture* CopyPass::get_texture() const {
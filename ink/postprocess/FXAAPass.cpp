@@ -35,7 +35,7 @@ void FXAAPass::render() {
 	fxaa_shader->use_program();
 	fxaa_shader->set_uniform_v2("screen_size", screen_size);
 	fxaa_shader->set_uniform_i("map", map->activate(0));
-	RenderPass::render_to(fxaa_shader, target);
+	RenderPass::render_to(target);
 }
 
 const gpu::Texture* FXAAPass::get_texture() const {
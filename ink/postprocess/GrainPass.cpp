@@ -35,7 +35,7 @@ void GrainPass::render() {
 	grain_shader->set_uniform_f("intensity", intensity);
 	grain_shader->set_uniform_f("seed", Random::random_f() + 1);
 	grain_shader->set_uniform_i("map", map->activate(0));
-	RenderPass::render_to(grain_shader, target);
+	RenderPass::render_to(target);
 }
 
 const gpu::Texture* GrainPass::get_texture() const {
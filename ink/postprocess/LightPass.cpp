@@ -49,10 +49,11 @@ void LightPass::render() {
 	light_shader->set_uniform_m4("inv_view_proj", inv_view_proj);
 	
 	/* pass the lights & fogs parameters to shader */
-	Renderer::set_light_uniforms(*scene, *light_shader);
+	Renderer::set_light_buffer(*scene);
+	Renderer::set_light_uniforms(*light_shader);
 	
 	/* render results to render target */
-	RenderPass::render_to(light_shader, target);
+	RenderPass::render_to(target);
 }
 
 const Scene* LightPass::get_scene() const {
@@ -40,7 +40,7 @@ void RenderPass::set_viewport(const gpu::Rect& v) {
 	viewport = v;
 }
 
-void RenderPass::render_to(const gpu::Shader* s, const gpu::RenderTarget* t) {
+void RenderPass::render_to(const gpu::RenderTarget* t) {
 	/* initialize fullscreen plane vertex object */
 	if (!fullscreen_plane) init_fullscreen_plane();
 	
@@ -59,7 +59,6 @@ void RenderPass::render_to(const gpu::Shader* s, const gpu::RenderTarget* t) {
 	gpu::State::set_viewport(viewport);
 	
 	/* draw the fullscreen plane with shader */
-	fullscreen_plane->attach(*s);
 	fullscreen_plane->render();
 	
 	/* set to default render target */
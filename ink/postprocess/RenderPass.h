@@ -73,13 +73,12 @@ public:
 	static void set_viewport(const gpu::Rect& v);
 	
 	/**
-	 * Renders the full screen triangle. The result will be rendered to the
-	 * specified render target.
+	 * Renders the full screen triangle with the shader in use. The result will
+	 * be rendered to the specified render target.
 	 *
-	 * \param s shader
 	 * \param t render target
 	 */
-	static void render_to(const gpu::Shader* s, const gpu::RenderTarget* t);
+	static void render_to(const gpu::RenderTarget* t);
 	
 protected:
 	const gpu::RenderTarget* target = nullptr;
@@ -97,7 +97,7 @@ void SSAOPass::render() {
 	ssao_shader->set_uniform_m4("inv_proj", inv_proj);
 	ssao_shader->set_uniform_i("g_normal", g_normal->activate(0));
 	ssao_shader->set_uniform_i("z_buffer", z_buffer->activate(1));
-	RenderPass::render_to(ssao_shader, blur_target_1.get());
+	RenderPass::render_to(blur_target_1.get());
 	
 	/* 2. blur texture for two times */
 	for (int i = 0; i < 2; ++i) {
@@ -110,7 +110,7 @@ void SSAOPass::render() {
 		blur_shader->set_uniform_f("sigma_s", 2);
 		blur_shader->set_uniform_f("sigma_r", 0.25);
 		blur_shader->set_uniform_i("map", blur_map_1->activate(0));
-		RenderPass::render_to(blur_shader, blur_target_2.get());
+		RenderPass::render_to(blur_target_2.get());
 		
 		/* blur texture vertically */
 		blur_shader->use_program();
@@ -120,7 +120,7 @@ void SSAOPass::render() {
 		blur_shader->set_uniform_f("sigma_s", 2);
 		blur_shader->set_uniform_f("sigma_r", 0.25);
 		blur_shader->set_uniform_i("map", blur_map_2->activate(0));
-		RenderPass::render_to(blur_shader, blur_target_1.get());
+		RenderPass::render_to(blur_target_1.get());
 	}
 	
 	/* set back to the initial viewport */
@@ -130,7 +130,7 @@ void SSAOPass::render() {
 	blend_shader->use_program();
 	blend_shader->set_uniform_i("map_a", map->activate(1));
 	blend_shader->set_uniform_i("map_b", blur_map_1->activate(0));
-	RenderPass::render_to(blend_shader, target);
+	RenderPass::render_to(target);
 }
 
 const Camera* SSAOPass::get_camera() const {
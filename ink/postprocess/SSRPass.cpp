@@ -55,7 +55,7 @@ void SSRPass::render() {
 	ssr_shader->set_uniform_i("g_normal", g_normal->activate(1));
 	ssr_shader->set_uniform_i("g_material", g_material->activate(2));
 	ssr_shader->set_uniform_i("z_buffer", z_buffer->activate(3));
-	RenderPass::render_to(ssr_shader, target);
+	RenderPass::render_to(target);
 }
 
 const Camera* SSRPass::get_camera() const {
@@ -47,7 +47,7 @@ void ToneMapPass::render() {
 	tone_map_shader->use_program();
 	tone_map_shader->set_uniform_f("exposure", exposure);
 	tone_map_shader->set_uniform_i("map", map->activate(0));
-	RenderPass::render_to(tone_map_shader, target);
+	RenderPass::render_to(target);
 }
 
 const gpu::Texture* ToneMapPass::get_texture() const {
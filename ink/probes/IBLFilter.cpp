@@ -107,7 +107,6 @@ void IBLFilter::load_texture(const gpu::Texture& t, gpu::Texture& m, int s) {
 		cubemap_shader->use_program();
 		cubemap_shader->set_uniform_i("face", i);
 		cubemap_shader->set_uniform_i("map", t.activate(0));
-		fullscreen_plane->attach(*cubemap_shader);
 		fullscreen_plane->render();
 	}
 	
@@ -159,7 +158,6 @@ void IBLFilter::load_texture(const gpu::Texture& t, gpu::Texture& m, int s) {
 				std::string weights_i = std::format("weights[{}]", w);
 				blur_shader->set_uniform_f(weights_i, weights[w]);
 			}
-			fullscreen_plane->attach(*blur_shader);
 			fullscreen_plane->render();
 		}
 		
@@ -187,7 +185,6 @@ void IBLFilter::load_texture(const gpu::Texture& t, gpu::Texture& m, int s) {
 				std::string weights_i = std::format("weights[{}]", w);
 				blur_shader->set_uniform_f(weights_i, weights[w]);
 			}
-			fullscreen_plane->attach(*blur_shader);
 			fullscreen_plane->render();
 		}
 	}
@@ -0,0 +1,49 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "CompiledMaterial.h"
+
+namespace ink {
+
+int CompiledMaterial::activate(unsigned int b, int l, const void** t) const {
+	/* bind the textures to their units if changed */
+	int switches = 0;
+	for (auto& [unit, texture] : textures) {
+		if (t[unit] == texture) continue;
+		texture->activate(unit);
+		t[unit] = texture;
+		++switches;
+	}
+	
+	/* bind the reflection probe if changed */
+	if (reflection_probe != nullptr && t[l] != reflection_probe) {
+		reflection_probe->activate(l);
+		t[l] = reflection_probe;
+		++switches;
+	}
+	
+	/* bind the parameter block */
+	parameters.activate(b);
+	return switches;
+}
+
+}
@@ -0,0 +1,71 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "../graphics/Gpu.h"
+#include "../probes/ReflectionProbe.h"
+
+namespace ink {
+
+class CompiledMaterial {
+public:
+	size_t stamp = 0;                                    /**< the pass in which the material was last checked */
+	
+	uint32_t features = 0;                               /**< the features of the material that select the program */
+	
+	const void* custom_shader = nullptr;                 /**< the custom shader of the material when compiled */
+	
+	const gpu::Shader* shader = nullptr;                 /**< the program used by the material */
+	
+	const gpu::Shader* instanced_shader = nullptr;       /**< the program used by instanced draws if fetched */
+	
+	const gpu::Shader* shadow_shader = nullptr;          /**< the program used by shadow draws if fetched */
+	
+	const gpu::Shader* instanced_shadow_shader = nullptr; /**< the program used by instanced shadow draws if fetched */
+	
+	std::vector<std::pair<int, const gpu::Texture*>> textures; /**< the textures and their units */
+	
+	const ReflectionProbe* reflection_probe = nullptr;   /**< the reflection probe of the material */
+	
+	float parameter_values[16] = {};                     /**< the packed parameters in the parameter block */
+	
+	gpu::UniformBuffer parameters;                       /**< the packed parameter block of the material */
+	
+	/**
+	 * Creates a new CompiledMaterial object.
+	 */
+	CompiledMaterial() = default;
+	
+	/**
+	 * Binds the textures, the reflection probe and the parameter block of the
+	 * compiled material. The textures already bound to their units are
+	 * skipped. Returns the number of units whose textures are changed.
+	 *
+	 * \param b the binding point of the parameter block
+	 * \param l the texture unit of the reflection probe
+	 * \param t the textures bound to units, updated by this function
+	 */
+	int activate(unsigned int b, int l, const void** t) const;
+};
+
+}
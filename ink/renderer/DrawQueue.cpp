@@ -0,0 +1,182 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "DrawQueue.h"
+
+#include <algorithm>
+
+namespace ink {
+
+constexpr int KEY_SHADER_BITS = 10;
+constexpr int KEY_MATERIAL_BITS = 14;
+constexpr int KEY_VERTEX_OBJECT_BITS = 14;
+constexpr int KEY_DEPTH_BITS = 17;
+constexpr int KEY_BITS = KEY_SHADER_BITS + KEY_MATERIAL_BITS + KEY_VERTEX_OBJECT_BITS + KEY_DEPTH_BITS;
+constexpr int KEY_PRIORITY_BITS = 63 - KEY_BITS;
+
+void DrawQueue::clear() {
+	packets.clear();
+	shader_ids.clear();
+	material_ids.clear();
+	vertex_object_ids.clear();
+}
+
+void DrawQueue::set_depth_range(float n, float f) {
+	depth_near = n;
+	depth_far = f;
+}
+
+void DrawQueue::add(const Instance* i, const Material* m, const gpu::Shader* s,
+					const gpu::VertexObject* v, int g, float d, const CompiledMaterial* c) {
+	/* quantize the depth in depth range */
+	float depth_scale = depth_far > depth_near ? 1 / (depth_far - depth_near) : 0;
+	float depth_norm = std::clamp((d - depth_near) * depth_scale, 0.f, 1.f);
+	uint64_t depth_max = (uint64_t(1) << KEY_DEPTH_BITS) - 1;
+	uint64_t depth = static_cast<uint64_t>(depth_norm * depth_max);
+	
+	/* get the layer and the biased priority */
+	uint64_t layer = m->blending ? 1 : 0;
+	uint64_t priority = static_cast<uint32_t>(i->priority) ^ 0x80000000u;
+	
+	/* get the state ids of shader, material and vertex object */
+	uint64_t shader = get_id(shader_ids, s) & ((uint64_t(1) << KEY_SHADER_BITS) - 1);
+	uint64_t material = get_id(material_ids, m) & ((uint64_t(1) << KEY_MATERIAL_BITS) - 1);
+	uint64_t vertex_object = get_id(vertex_object_ids, v) & ((uint64_t(1) << KEY_VERTEX_OBJECT_BITS) - 1);
+	uint64_t state = shader;
+	state = (state << KEY_MATERIAL_BITS) | material;
+	state = (state << KEY_VERTEX_OBJECT_BITS) | vertex_object;
+	
+	/* opaque: states then front to back, transparent: back to front then states */
+	uint64_t key = 0;
+	if (layer == 0) {
+		key = (state << KEY_DEPTH_BITS) | depth;
+	} else {
+		key = ((depth_max - depth) << (KEY_SHADER_BITS + KEY_MATERIAL_BITS + KEY_VERTEX_OBJECT_BITS)) | state;
+	}
+	
+	/* add the packet to the queue */
+	auto& packet = packets.emplace_back();
+	packet.order = (layer << 32) | priority;
+	packet.key = key;
+	packet.group = g;
+	packet.instance = i;
+	packet.material = m;
+	packet.shader = s;
+	packet.vertex_object = v;
+	packet.compiled_material = c;
+}
+
+void DrawQueue::sort() {
+	size_t packet_count = packets.size();
+	if (packet_count == 0) return;
+	
+	/* find the range of priorities to fold them into keys */
+	uint32_t min_priority = UINT32_MAX;
+	uint32_t max_priority = 0;
+	for (auto& packet : packets) {
+		uint32_t priority = static_cast<uint32_t>(packet.order);
+		min_priority = std::min(min_priority, priority);
+		max_priority = std::max(max_priority, priority);
+	}
+	bool folded = max_priority - min_priority < (uint32_t(1) << KEY_PRIORITY_BITS);
+	
+	/* build the sort entries and find the bits that differ */
+	entries.resize(packet_count);
+	uint64_t key_bits = 0;
+	uint64_t order_bits = 0;
+	for (int i = 0; i < packet_count; ++i) {
+		auto& packet = packets[i];
+		auto& entry = entries[i];
+		if (folded) {
+			uint64_t layer = packet.order >> 32;
+			uint64_t priority = static_cast<uint32_t>(packet.order) - min_priority;
+			entry.key = (((layer << KEY_PRIORITY_BITS) | priority) << KEY_BITS) | packet.key;
+			entry.order = 0;
+		} else {
+			entry.key = packet.key;
+			entry.order = packet.order;
+		}
+		entry.index = i;
+		key_bits |= entry.key ^ entries[0].key;
+		order_bits |= entry.order ^ entries[0].order;
+	}
+	
+	/* sort by keys first, then by the layers and priorities (LSD radix sort) */
+	sorted_entries.resize(packet_count);
+	for (int shift = 0; shift < 128; shift += 8) {
+		/* skip the pass if all the digits are the same */
+		uint64_t bits = shift < 64 ? key_bits >> shift : order_bits >> (shift - 64);
+		if ((bits & 0xFF) == 0) continue;
+		
+		auto digit = [shift](const SortEntry& e) -> size_t {
+			return (shift < 64 ? e.key >> shift : e.order >> (shift - 64)) & 0xFF;
+		};
+		
+		/* count the number of each digit */
+		size_t offsets[256] = {};
+		for (auto& entry : entries) ++offsets[digit(entry)];
+		
+		/* calculate the offset of each digit */
+		size_t sum = 0;
+		for (int i = 0; i < 256; ++i) {
+			size_t count = offsets[i];
+			offsets[i] = sum;
+			sum += count;
+		}
+		
+		/* scatter the entries to the sorted places */
+		for (auto& entry : entries) sorted_entries[offsets[digit(entry)]++] = entry;
+		entries.swap(sorted_entries);
+	}
+	
+	/* move the packets to the sorted places at once */
+	sorted_packets.resize(packet_count);
+	for (int i = 0; i < packet_count; ++i) {
+		sorted_packets[i] = packets[entries[i].index];
+	}
+	packets.swap(sorted_packets);
+}
+
+size_t DrawQueue::get_packet_count() const {
+	return packets.size();
+}
+
+const DrawPacket& DrawQueue::get_packet(int i) const {
+	return packets[i];
+}
+
+int DrawQueue::get_run_length(int i) const {
+	auto& first = packets[i];
+	int packet_count = static_cast<int>(packets.size());
+	int j = i + 1;
+	while (j < packet_count &&
+		   packets[j].shader == first.shader &&
+		   packets[j].material == first.material &&
+		   packets[j].vertex_object == first.vertex_object) ++j;
+	return j - i;
+}
+
+uint64_t DrawQueue::get_id(std::unordered_map<const void*, uint64_t>& m, const void* p) {
+	return m.try_emplace(p, m.size()).first->second;
+}
+
+}
@@ -0,0 +1,162 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "CompiledMaterial.h"
+
+#include "../graphics/Gpu.h"
+#include "../objects/Instance.h"
+#include "../objects/Material.h"
+
+#include <unordered_map>
+
+namespace ink {
+
+class DrawPacket {
+public:
+	uint64_t order = 0;                             /**< the layer and priority of the packet, sorted before key */
+	
+	uint64_t key = 0;                               /**< the sort key of the packet */
+	
+	int group = 0;                                  /**< the index of the mesh group */
+	
+	const Instance* instance = nullptr;             /**< the instance to be rendered */
+	
+	const Material* material = nullptr;             /**< the material of the group */
+	
+	const gpu::Shader* shader = nullptr;            /**< the shader of the material */
+	
+	const gpu::VertexObject* vertex_object = nullptr; /**< the vertex object of the group */
+	
+	const CompiledMaterial* compiled_material = nullptr; /**< the compiled material if there is one */
+};
+
+class DrawStats {
+public:
+	size_t draw_calls = 0;                          /**< the number of draw calls */
+	
+	size_t program_switches = 0;                    /**< the number of program switches */
+	
+	size_t texture_switches = 0;                    /**< the number of texture units whose textures are changed */
+	
+	size_t vertex_object_switches = 0;              /**< the number of vertex object switches */
+	
+	size_t instances = 0;                           /**< the number of groups drawn by instanced draws */
+	
+	size_t culled_meshlets = 0;                     /**< the number of meshlets culled by frustum or normal cone */
+	
+	size_t occluded_instances = 0;                  /**< the number of instances rejected by occlusion callback */
+};
+
+class DrawQueue {
+public:
+	/**
+	 * Creates a new DrawQueue object.
+	 */
+	DrawQueue() = default;
+	
+	/**
+	 * Removes all the packets from the queue.
+	 */
+	void clear();
+	
+	/**
+	 * Sets the depth range to quantize the depths of packets. The depths out
+	 * of range will be clamped.
+	 *
+	 * \param n the nearest depth
+	 * \param f the farthest depth
+	 */
+	void set_depth_range(float n, float f);
+	
+	/**
+	 * Adds a packet to the queue. The packets are sorted by layer (opaque or
+	 * transparent) and the full range of priority first, then by the sort key
+	 * built from shader, material, vertex object and quantized depth. Opaque
+	 * packets are sorted by states then from front to back, transparent
+	 * packets are sorted from back to front then by states.
+	 *
+	 * \param i instance
+	 * \param m material
+	 * \param s shader
+	 * \param v vertex object
+	 * \param g the index of the mesh group
+	 * \param d the depth of the instance from the camera
+	 * \param c compiled material
+	 */
+	void add(const Instance* i, const Material* m, const gpu::Shader* s,
+			 const gpu::VertexObject* v, int g, float d, const CompiledMaterial* c = nullptr);
+	
+	/**
+	 * Sorts the packets by layers, priorities and sort keys with radix sort.
+	 * Packets with the same layer, priority and key keep the order they were
+	 * added in. The keys are sorted with the indices of packets, and the
+	 * packets are moved once at the end. If the priorities span less than 256
+	 * values, they are folded into the spare bits of keys with the layers.
+	 */
+	void sort();
+	
+	/**
+	 * Returns the number of packets in the queue.
+	 */
+	size_t get_packet_count() const;
+	
+	/**
+	 * Returns the packet at the specified index in the queue.
+	 *
+	 * \param i the index of the packet
+	 */
+	const DrawPacket& get_packet(int i) const;
+	
+	/**
+	 * Returns the number of consecutive packets starting at the specified
+	 * index which share the same shader, material and vertex object.
+	 *
+	 * \param i the index of the first packet
+	 */
+	int get_run_length(int i) const;
+	
+private:
+	struct SortEntry {
+		uint64_t key = 0;                         /**< the sort key, with the folded layer and priority */
+		uint64_t order = 0;                       /**< the layer and priority if they are not folded */
+		int index = 0;                            /**< the index of the packet */
+	};
+	
+	float depth_near = 0;
+	float depth_far = 1;
+	
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> sorted_packets;
+	
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> sorted_entries;
+	
+	std::unordered_map<const void*, uint64_t> shader_ids;
+	std::unordered_map<const void*, uint64_t> material_ids;
+	std::unordered_map<const void*, uint64_t> vertex_object_ids;
+	
+	static uint64_t get_id(std::unordered_map<const void*, uint64_t>& m, const void* p);
+};
+
+}
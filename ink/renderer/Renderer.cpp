@@ -27,7 +27,8 @@
 #include "../shaders/ShaderLib.h"
 
 #include <algorithm>
-#include <format>
+#include <bit>
+#include <cstring>
 
 namespace ink {
 
@@ -39,6 +40,62 @@ constexpr Vec3 CUBE_UPS[] = {
 	{0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0},
 };
 
+constexpr unsigned int LIGHT_BLOCK_BINDING = 0;
+
+constexpr unsigned int MATERIAL_BLOCK_BINDING = 1;
+
+constexpr int SHADOW_TEXTURE_UNIT = 26;
+
+constexpr float LOD_SCREEN_ERROR = 1.f / 512;
+
+constexpr float MESHLET_SCALE_TOLERANCE = 1.f / 1024;
+
+constexpr size_t COMPILED_MATERIAL_LIFETIME = 256;
+
+constexpr int UPLOAD_RING_FRAMES = 3;
+
+constexpr int PLACEHOLDER_SAMPLES = 16;
+
+constexpr gpu::UniformKey UNIFORM_LIGHT_BLOCK("LightBlock");
+constexpr gpu::UniformKey UNIFORM_MATERIAL_BLOCK("MaterialBlock");
+constexpr gpu::UniformKey UNIFORM_GLOBAL_SHADOW_MAP("global_shadow.map");
+constexpr gpu::UniformKey UNIFORM_GLOBAL_SHADOW_SIZE("global_shadow.size");
+constexpr gpu::UniformKey UNIFORM_VIEW_PROJ("view_proj");
+constexpr gpu::UniformKey UNIFORM_INTENSITY("intensity");
+constexpr gpu::UniformKey UNIFORM_MAP("map");
+constexpr gpu::UniformKey UNIFORM_INV_VIEW_PROJ("inv_view_proj");
+constexpr gpu::UniformKey UNIFORM_MODEL("model");
+constexpr gpu::UniformKey UNIFORM_VIEW("view");
+constexpr gpu::UniformKey UNIFORM_PROJ("proj");
+constexpr gpu::UniformKey UNIFORM_MODEL_VIEW("model_view");
+constexpr gpu::UniformKey UNIFORM_MODEL_VIEW_PROJ("model_view_proj");
+constexpr gpu::UniformKey UNIFORM_NORMAL_MAT("normal_mat");
+constexpr gpu::UniformKey UNIFORM_CAMERA_POS("camera_pos");
+constexpr gpu::UniformKey UNIFORM_VERTEX_OFFSET("vertex_offset");
+constexpr gpu::UniformKey UNIFORM_VERTEX_SCALE("vertex_scale");
+constexpr gpu::UniformKey UNIFORM_COLOR("color");
+constexpr gpu::UniformKey UNIFORM_ALPHA_TEST("alpha_test");
+constexpr gpu::UniformKey UNIFORM_ALPHA("alpha");
+constexpr gpu::UniformKey UNIFORM_AO_INTENSITY("ao_intensity");
+constexpr gpu::UniformKey UNIFORM_SPECULAR("specular");
+constexpr gpu::UniformKey UNIFORM_METALNESS("metalness");
+constexpr gpu::UniformKey UNIFORM_ROUGHNESS("roughness");
+constexpr gpu::UniformKey UNIFORM_EMISSIVE("emissive");
+constexpr gpu::UniformKey UNIFORM_NORMAL_SCALE("normal_scale");
+constexpr gpu::UniformKey UNIFORM_DISPLACEMENT_SCALE("displacement_scale");
+constexpr gpu::UniformKey UNIFORM_NORMAL_MAP("normal_map");
+constexpr gpu::UniformKey UNIFORM_DISPLACEMENT_MAP("displacement_map");
+constexpr gpu::UniformKey UNIFORM_COLOR_MAP("color_map");
+constexpr gpu::UniformKey UNIFORM_ALPHA_MAP("alpha_map");
+constexpr gpu::UniformKey UNIFORM_EMISSIVE_MAP("emissive_map");
+constexpr gpu::UniformKey UNIFORM_AO_MAP("ao_map");
+constexpr gpu::UniformKey UNIFORM_ROUGHNESS_MAP("roughness_map");
+constexpr gpu::UniformKey UNIFORM_METALNESS_MAP("metalness_map");
+constexpr gpu::UniformKey UNIFORM_SPECULAR_MAP("specular_map");
+constexpr gpu::UniformKey UNIFORM_REF_MAP("ref_map");
+constexpr gpu::UniformKey UNIFORM_REF_LOD("ref_lod");
+constexpr gpu::UniformKey UNIFORM_REF_INTENSITY("ref_intensity");
+
 Vec4 Renderer::get_clear_color() const {
 	return clear_color;
 }
@@ -86,6 +143,46 @@ void Renderer::set_rendering_mode(RenderingMode m) {
 	rendering_mode = m;
 }
 
+bool Renderer::get_instancing() const {
+	return instancing;
+}
+
+void Renderer::set_instancing(bool i) {
+	instancing = i;
+}
+
+bool Renderer::get_vertex_quantization() const {
+	return vertex_quantization;
+}
+
+void Renderer::set_vertex_quantization(bool q) {
+	vertex_quantization = q;
+}
+
+float Renderer::get_lod_bias() const {
+	return lod_bias;
+}
+
+void Renderer::set_lod_bias(float b) {
+	lod_bias = b;
+}
+
+float Renderer::get_shadow_lod_bias() const {
+	return shadow_lod_bias;
+}
+
+void Renderer::set_shadow_lod_bias(float b) {
+	shadow_lod_bias = b;
+}
+
+bool Renderer::get_meshlet_culling() const {
+	return meshlet_culling;
+}
+
+void Renderer::set_meshlet_culling(bool c) {
+	meshlet_culling = c;
+}
+
 const gpu::RenderTarget* Renderer::get_target() const {
 	return target;
 }
@@ -98,6 +195,10 @@ void Renderer::set_texture_callback(const TextureCallback& f) {
 	texture_callback = f;
 }
 
+void Renderer::set_occlusion_callback(const OcclusionCallback& f) {
+	occlusion_callback = f;
+}
+
 float Renderer::get_skybox_intensity() const {
 	return skybox_intensity;
 }
@@ -145,11 +246,21 @@ void Renderer::render_skybox(const Camera& c) const {
 
 void Renderer::load_mesh(const Mesh& m) {
 	if (mesh_cache.count(&m) != 0) return;
-	size_t size = m.groups.size();
-	auto p = mesh_cache.insert({&m, std::make_unique<gpu::VertexObject[]>(size)});
-	auto* vertex_object = p.first->second.get();
-	for (int i = 0; i < size; ++i) {
-		vertex_object[i].load(m, m.groups[i]);
+	auto& levels = mesh_cache[&m];
+	
+	/* load the mesh and its levels of detail under the same key */
+	for (int l = 0; l <= m.lods.size(); ++l) {
+		const Mesh& mesh = l == 0 ? m : m.lods[l - 1];
+		size_t size = mesh.groups.size();
+		auto* vertex_object = levels.emplace_back(std::make_unique<gpu::VertexObject[]>(size)).get();
+		
+		/* load the groups to the shared arena of vertex format */
+		int attributes = gpu::GeometryArena::get_attributes(mesh);
+		auto& arena = geometry_arenas[attributes << 1 | (vertex_quantization ? 1 : 0)];
+		if (!arena) arena = std::make_unique<gpu::GeometryArena>(vertex_quantization, attributes);
+		for (int i = 0; i < size; ++i) {
+			vertex_object[i].load(mesh, mesh.groups[i], *arena);
+		}
 	}
 }
 
@@ -165,18 +276,163 @@ void Renderer::load_image(const Image& i) {
 	if (image_cache.count(&i) != 0) return;
 	auto p = image_cache.insert({&i, std::make_unique<gpu::Texture>()});
 	auto* texture = p.first->second.get();
-	texture->init_2d(i, gpu::Texture::default_format(i));
+	auto format = gpu::Texture::default_format(i);
+	
+	/* allocate the storage and queue the pixels if streaming */
+	if (texture_streaming && !i.data.empty()) {
+		auto type = i.bytes == 1 ? IMAGE_UBYTE : IMAGE_FLOAT;
+		int levels = std::bit_width(static_cast<unsigned int>(std::max(i.width, i.height)));
+		texture->init_2d_storage(i.width, i.height, levels, format, type);
+		
+		/* create a placeholder of the average color */
+		Image average = Image(1, 1, i.channel, i.bytes);
+		int sample_x = std::min(i.width, PLACEHOLDER_SAMPLES);
+		int sample_y = std::min(i.height, PLACEHOLDER_SAMPLES);
+		for (int c = 0; c < i.channel; ++c) {
+			double sum = 0;
+			for (int y = 0; y < sample_y; ++y) {
+				for (int x = 0; x < sample_x; ++x) {
+					size_t px = (x * 2 + 1) * i.width / (sample_x * 2);
+					size_t py = (y * 2 + 1) * i.height / (sample_y * 2);
+					size_t index = (py * i.width + px) * i.channel + c;
+					if (i.bytes == 1) {
+						sum += i.data[index];
+					} else {
+						sum += reinterpret_cast<const float*>(i.data.data())[index];
+					}
+				}
+			}
+			sum /= sample_x * sample_y;
+			if (i.bytes == 1) {
+				average.data[c] = static_cast<uint8_t>(sum + 0.5);
+			} else {
+				reinterpret_cast<float*>(average.data.data())[c] = static_cast<float>(sum);
+			}
+		}
+		auto placeholder = std::make_unique<gpu::Texture>();
+		placeholder->init_2d(average, format);
+		image_placeholders.insert_or_assign(&i, std::move(placeholder));
+		image_uploads.push_back({&i, 0});
+		return;
+	}
+	
+	texture->init_2d(i, format);
 	if (texture_callback) {
 		std::invoke(texture_callback, *texture);
 	}
 }
 
 void Renderer::unload_image(const Image& i) {
+	cancel_image_upload(&i);
 	image_cache.erase(&i);
+	compiled_materials.clear();
 }
 
 void Renderer::clear_image_caches() {
+	for (auto& [image, texture] : image_cache) {
+		cancel_image_upload(image);
+	}
 	image_cache.clear();
+	compiled_materials.clear();
+}
+
+bool Renderer::get_texture_streaming() const {
+	return texture_streaming;
+}
+
+void Renderer::set_texture_streaming(bool s) {
+	texture_streaming = s;
+}
+
+size_t Renderer::get_texture_upload_budget() const {
+	return texture_upload_budget;
+}
+
+void Renderer::set_texture_upload_budget(size_t b) {
+	texture_upload_budget = b;
+}
+
+size_t Renderer::get_pending_image_count() const {
+	return image_placeholders.size();
+}
+
+void Renderer::update_textures() {
+	/* retire the chunks whose uploads are completed by GPU */
+	while (!upload_chunks.empty() && upload_chunks.front().fence->is_signaled()) {
+		auto& chunk = upload_chunks.front();
+		if (chunk.last && chunk.texture != nullptr) {
+			
+			/* make the texture resident and invoke the callback */
+			image_placeholders.erase(chunk.image);
+			if (texture_callback) {
+				std::invoke(texture_callback, *image_cache.at(chunk.image));
+			}
+		}
+		upload_chunks.pop_front();
+	}
+	if (upload_chunks.empty()) upload_head = 0;
+	if (image_uploads.empty()) return;
+	
+	/* resize the upload buffer when no chunk is in flight */
+	size_t ring_size = std::max<size_t>(texture_upload_budget, 1) * UPLOAD_RING_FRAMES;
+	for (auto& upload : image_uploads) {
+		auto& image = *upload.image;
+		size_t row_size = static_cast<size_t>(image.width) * image.channel * image.bytes;
+		ring_size = std::max(ring_size, row_size);
+	}
+	if (!upload_buffer || (upload_chunks.empty() && upload_buffer->get_size() != ring_size)) {
+		upload_buffer = std::make_unique<gpu::PixelBuffer>();
+		upload_buffer->init(ring_size);
+	}
+	ring_size = upload_buffer->get_size();
+	
+	/* upload the rows of the queued images within the budget */
+	size_t budget = texture_upload_budget;
+	bool first_chunk = true;
+	while (!image_uploads.empty()) {
+		auto& upload = image_uploads.front();
+		auto& image = *upload.image;
+		size_t row_size = static_cast<size_t>(image.width) * image.channel * image.bytes;
+		if (row_size > ring_size) break;
+		
+		/* at least one row is uploaded in each update */
+		size_t rows = std::min<size_t>(budget / row_size, image.height - upload.row);
+		if (first_chunk) rows = std::max<size_t>(rows, 1);
+		if (rows == 0) break;
+		
+		/* find the free space in the ring, never overtake the tail */
+		size_t offset = upload_head;
+		size_t space = ring_size - upload_head;
+		if (!upload_chunks.empty()) {
+			size_t tail = upload_chunks.front().offset;
+			if (upload_head < tail) {
+				space = tail - upload_head - 1;
+			} else if (space < row_size) {
+				offset = 0;
+				space = tail == 0 ? 0 : tail - 1;
+			}
+		}
+		rows = std::min(rows, space / row_size);
+		if (rows == 0) break;
+		
+		/* copy the rows to the ring and upload them to texture */
+		size_t size = rows * row_size;
+		void* pointer = upload_buffer->map(offset, size);
+		if (pointer == nullptr) break;
+		std::memcpy(pointer, image.data.data() + upload.row * row_size, size);
+		upload_buffer->unmap();
+		auto* texture = image_cache.at(&image).get();
+		texture->update_2d(*upload_buffer, offset, image, upload.row, static_cast<int>(rows));
+		upload.row += static_cast<int>(rows);
+		upload_head = offset + size;
+		budget -= std::min(budget, size);
+		first_chunk = false;
+		
+		/* track the completion of the chunk with a fence */
+		bool last = upload.row == image.height;
+		upload_chunks.push_back({&image, texture, offset, last, std::make_unique<gpu::Fence>()});
+		if (last) image_uploads.pop_front();
+	}
 }
 
 void Renderer::load_scene(const Scene& s) {
@@ -229,6 +485,13 @@ void Renderer::unload_scene(const Scene& s) {
 		if (mesh != nullptr) unload_mesh(*mesh);
 	}
 	
+	/* remove the compiled materials of the scene */
+	for (auto& material : s.get_materials()) {
+		auto first = compiled_materials.lower_bound({material, 0});
+		auto last = compiled_materials.upper_bound({material, SIZE_MAX});
+		compiled_materials.erase(first, last);
+	}
+	
 	/* unload the images linked with instance */
 	for (auto& material : s.get_materials()) {
 		if (material->normal_map != nullptr) {
@@ -267,7 +530,15 @@ void Renderer::unload_scene(const Scene& s) {
 
 void Renderer::clear_scene_caches() {
 	mesh_cache.clear();
+	for (auto& [image, texture] : image_cache) {
+		cancel_image_upload(image);
+	}
 	image_cache.clear();
+	compiled_materials.clear();
+}
+
+void Renderer::clear_material_caches() {
+	compiled_materials.clear();
 }
 
 void Renderer::render(const Scene& s, const Camera& c) const {
@@ -413,6 +684,14 @@ void Renderer::update_probe(const Scene& s, ReflectionProbe& r) const {
 	r.load_texture(*probe_map);
 }
 
+DrawStats Renderer::get_draw_stats() const {
+	return draw_stats;
+}
+
+void Renderer::reset_draw_stats() {
+	draw_stats = DrawStats();
+}
+
 void Renderer::update_scene(Scene& s) {
 	s.update_instances();
 }
@@ -488,129 +767,132 @@ void Renderer::set_scene_defines(const Scene& s, Defines& d) {
 	d.set_if("USE_EXP2_FOG", s.get_exp2_fog() != nullptr);
 }
 
-void Renderer::set_light_uniforms(const Scene& s, const gpu::Shader& shader) {
+void Renderer::set_light_buffer(const Scene& s) {
 	/* determines whether to enable shadow */
 	bool enable_shadow = false;
 	
-	/* apply point lights in lighting */
+	/* pack the data in std140 layout of light block */
+	std::vector<float> data;
+	auto pack_f = [&data](float v) -> void {
+		data.emplace_back(v);
+	};
+	auto pack_i = [&data](int v) -> void {
+		data.emplace_back(std::bit_cast<float>(v));
+	};
+	auto pack_v3 = [&data](const Vec3& v) -> void {
+		data.insert(data.end(), {v.x, v.y, v.z});
+	};
+	auto pack_shadow = [&](const Shadow& shadow) -> void {
+		Mat4 view_proj = shadow.camera.projection * shadow.camera.viewing;
+		data.insert(data.end(), view_proj[0], view_proj[0] + 16);
+		pack_i(shadow.type);
+		pack_i(shadow.map_id);
+		pack_f(shadow.bias);
+		pack_f(shadow.normal_bias);
+		pack_f(shadow.radius);
+		data.resize(data.size() + 3); /* padding */
+	};
+	
+	/* pack point lights to buffer */
 	size_t point_light_count = s.get_point_light_count();
 	for (int i = 0; i < point_light_count; ++i) {
-		
-		/* pass the light information to shader */
 		auto& light = *s.get_point_light(i);
-		auto lights_i = std::format("point_lights[{}]", i);
 		Vec3 light_color = light.color * light.intensity * PI;
-		shader.set_uniform_i(lights_i + ".visible", light.visible);
-		shader.set_uniform_v3(lights_i + ".position", light.position);
-		shader.set_uniform_v3(lights_i + ".color", light_color);
-		shader.set_uniform_f(lights_i + ".distance", light.distance);
-		shader.set_uniform_f(lights_i + ".decay", light.decay);
+		pack_v3(light.position);
+		pack_f(light.distance);
+		pack_v3(light_color);
+		pack_f(light.decay);
+		pack_i(light.visible);
+		data.resize(data.size() + 3); /* padding */
 	}
 	
-	/* apply spot lights in lighting */
+	/* pack spot lights to buffer */
 	size_t spot_light_count = s.get_spot_light_count();
 	for (int i = 0; i < spot_light_count; ++i) {
-		
-		/* pass the light information to shader */
 		auto& light = *s.get_spot_light(i);
-		std::string lights_i = std::format("spot_lights[{}]", i);
 		Vec3 light_direction = -light.direction.normalize();
 		Vec3 light_color = light.color * light.intensity * PI;
 		float light_angle = cosf(light.angle);
 		float light_penumbra = cosf(light.angle * (1 - light.penumbra));
-		shader.set_uniform_i(lights_i + ".visible", light.visible);
-		shader.set_uniform_v3(lights_i + ".position", light.position);
-		shader.set_uniform_v3(lights_i + ".direction", light_direction);
-		shader.set_uniform_v3(lights_i + ".color", light_color);
-		shader.set_uniform_f(lights_i + ".distance", light.distance);
-		shader.set_uniform_f(lights_i + ".decay", light.decay);
-		shader.set_uniform_f(lights_i + ".angle", light_angle);
-		shader.set_uniform_f(lights_i + ".penumbra", light_penumbra);
-		shader.set_uniform_i(lights_i + ".cast_shadow", light.cast_shadow);
-		
-		/* check whether the light cast shadow */
-		if (!light.cast_shadow) continue;
-		enable_shadow = true;
-		
-		/* pass the shadow information to shader */
-		auto& shadow = light.shadow;
-		std::string shadows_i = std::format("spot_lights[{}].shadow", i);
-		Mat4 view_proj = shadow.camera.projection * shadow.camera.viewing;
-		shader.set_uniform_i(shadows_i + ".type", shadow.type);
-		shader.set_uniform_i(shadows_i + ".map_id", shadow.map_id);
-		shader.set_uniform_f(shadows_i + ".bias", shadow.bias);
-		shader.set_uniform_f(shadows_i + ".normal_bias", shadow.normal_bias);
-		shader.set_uniform_f(shadows_i + ".radius", shadow.radius);
-		shader.set_uniform_m4(shadows_i + ".view_proj", view_proj);
+		pack_v3(light.position);
+		pack_f(light.distance);
+		pack_v3(light_direction);
+		pack_f(light.decay);
+		pack_v3(light_color);
+		pack_f(light_angle);
+		pack_f(light_penumbra);
+		pack_i(light.visible);
+		pack_i(light.cast_shadow);
+		data.resize(data.size() + 1); /* padding */
+		pack_shadow(light.shadow);
+		enable_shadow |= light.cast_shadow;
 	}
 	
-	/* apply directional lights in lighting */
+	/* pack directional lights to buffer */
 	size_t directional_light_count = s.get_directional_light_count();
 	for (int i = 0; i < directional_light_count; ++i) {
-		
-		/* pass the light information to shader */
 		auto& light = *s.get_directional_light(i);
-		std::string lights_i = std::format("directional_lights[{}]", i);
 		Vec3 light_direction = -light.direction.normalize();
 		Vec3 light_color = light.color * light.intensity * PI;
-		shader.set_uniform_i(lights_i + ".visible", light.visible);
-		shader.set_uniform_v3(lights_i + ".direction", light_direction);
-		shader.set_uniform_v3(lights_i + ".color", light_color);
-		shader.set_uniform_i(lights_i + ".cast_shadow", light.cast_shadow);
-		
-		/* check whether the light cast shadow */
-		if (!light.cast_shadow) continue;
-		enable_shadow = true;
-		
-		/* pass the shadow information to shader */
-		auto& shadow = light.shadow;
-		std::string shadows_i = std::format("directional_lights[{}].shadow", i);
-		Mat4 view_proj = shadow.camera.projection * shadow.camera.viewing;
-		shader.set_uniform_i(shadows_i + ".type", shadow.type);
-		shader.set_uniform_i(shadows_i + ".map_id", shadow.map_id);
-		shader.set_uniform_f(shadows_i + ".bias", shadow.bias);
-		shader.set_uniform_f(shadows_i + ".normal_bias", shadow.normal_bias);
-		shader.set_uniform_f(shadows_i + ".radius", shadow.radius);
-		shader.set_uniform_m4(shadows_i + ".view_proj", view_proj);
+		pack_v3(light_direction);
+		pack_i(light.visible);
+		pack_v3(light_color);
+		pack_i(light.cast_shadow);
+		pack_shadow(light.shadow);
+		enable_shadow |= light.cast_shadow;
 	}
 	
-	/* apply hemisphere lights in lighting */
+	/* pack hemisphere lights to buffer */
 	size_t hemisphere_light_count = s.get_hemisphere_light_count();
 	for (int i = 0; i < hemisphere_light_count; ++i) {
-		
-		/* pass the light information to shader */
 		auto& light = *s.get_hemisphere_light(i);
-		std::string lights_i = std::format("hemisphere_lights[{}]", i);
 		Vec3 light_sky_color = light.color * light.intensity * PI;
 		Vec3 light_ground_color = light.ground_color * light.intensity * PI;
-		shader.set_uniform_i(lights_i + ".visible", light.visible);
-		shader.set_uniform_v3(lights_i + ".direction", light.direction);
-		shader.set_uniform_v3(lights_i + ".sky_color", light_sky_color);
-		shader.set_uniform_v3(lights_i + ".ground_color", light_ground_color);
+		pack_v3(light.direction);
+		pack_i(light.visible);
+		pack_v3(light_sky_color);
+		data.resize(data.size() + 1); /* padding */
+		pack_v3(light_ground_color);
+		data.resize(data.size() + 1); /* padding */
 	}
 	
-	/* pass the shadow parameters to shader */
-	if (enable_shadow) Shadow::activate_texture(26);
-	shader.set_uniform_i("global_shadow.map", 26);
-	shader.set_uniform_v2("global_shadow.size", Shadow::get_resolution());
-	
-	/* pass the linear fog parameters to shader */
+	/* pack linear fog to buffer */
 	auto* linear_fog = s.get_linear_fog();
 	if (linear_fog != nullptr) {
-		shader.set_uniform_i("fog.visible", linear_fog->visible);
-		shader.set_uniform_v3("fog.color", linear_fog->color);
-		shader.set_uniform_f("fog.near", linear_fog->near);
-		shader.set_uniform_f("fog.far", linear_fog->far);
+		pack_v3(linear_fog->color);
+		pack_i(linear_fog->visible);
+		pack_f(linear_fog->near);
+		pack_f(linear_fog->far);
+		data.resize(data.size() + 2); /* padding */
 	}
 	
-	/* pass the exp square fog parameters to shader */
+	/* pack exp square fog to buffer */
 	auto* exp2_fog = s.get_exp2_fog();
 	if (exp2_fog != nullptr) {
-		shader.set_uniform_i("fog.visible", exp2_fog->visible);
-		shader.set_uniform_v3("fog.color", exp2_fog->color);
-		shader.set_uniform_f("fog.near", exp2_fog->near);
-		shader.set_uniform_f("fog.density", exp2_fog->density);
+		pack_v3(exp2_fog->color);
+		pack_i(exp2_fog->visible);
+		pack_f(exp2_fog->near);
+		pack_f(exp2_fog->density);
+		data.resize(data.size() + 2); /* padding */
 	}
+	
+	/* activate the shadow map if any light cast shadow */
+	if (enable_shadow) Shadow::activate_texture(SHADOW_TEXTURE_UNIT);
+	
+	/* upload the data and bind the light buffer */
+	if (data.empty()) return;
+	if (!light_buffer) light_buffer = std::make_unique<gpu::UniformBuffer>();
+	light_buffer->load(data.data(), data.size() * sizeof(float));
+	light_buffer->activate(LIGHT_BLOCK_BINDING);
+}
+
+void Renderer::set_light_uniforms(const gpu::Shader& shader) {
+	/* bind the light block to the light buffer */
+	shader.set_uniform_block(UNIFORM_LIGHT_BLOCK, LIGHT_BLOCK_BINDING);
+	
+	/* pass the shadow parameters to shader */
+	shader.set_uniform_i(UNIFORM_GLOBAL_SHADOW_MAP, SHADOW_TEXTURE_UNIT);
+	shader.set_uniform_v2(UNIFORM_GLOBAL_SHADOW_SIZE, Shadow::get_resolution());
 }
 
 void Renderer::render_skybox_to_buffer(const Camera& c, RenderingMode r) const {
@@ -645,10 +927,9 @@ void Renderer::render_skybox_to_buffer(const Camera& c, RenderingMode r) const {
 	
 	/* render to the render target */
 	cube_shader->use_program();
-	cube_shader->set_uniform_m4("view_proj", view_proj);
-	cube_shader->set_uniform_f("intensity", skybox_intensity);
-	cube_shader->set_uniform_i("map", skybox_map->activate(0));
-	cube->attach(*cube_shader);
+	cube_shader->set_uniform_m4(UNIFORM_VIEW_PROJ, view_proj);
+	cube_shader->set_uniform_f(UNIFORM_INTENSITY, skybox_intensity);
+	cube_shader->set_uniform_i(UNIFORM_MAP, skybox_map->activate(0));
 	cube->render();
 }
 
@@ -661,45 +942,63 @@ void Renderer::render_to_buffer(const Scene& s, const Camera& c, RenderingMode r
 	Mat4 model_view_proj;
 	Mat3 normal_mat;
 	Vec3 camera_pos = c.position;
+	Mat4 inv_view_proj = inverse_4x4(c.projection * c.viewing);
+	Frustum frustum = c.get_frustum();
+	
+	/* upload the lights & fogs parameters once per pass */
+	if (t || r == FORWARD_RENDERING) set_light_buffer(s);
+	
+	/* get the configuration of scene once per pass */
+	Defines scene_defines;
+	if (!t && r == DEFERRED_RENDERING) {
+		scene_defines.set("DEFERRED_RENDERING");
+	} else {
+		scene_defines.set("FORWARD_RENDERING");
+		set_scene_defines(s, scene_defines);
+	}
+	sweep_compiled_materials();
+	size_t config_id = get_config_id(scene_defines);
 	
-	/* render all the visible instances in sorted order */
-	auto visible_instances = s.to_visible_instances();
-	sort_instances(c, visible_instances, t);
+	/* get the configuration of quantized vertex objects */
+	Defines quantized_defines = scene_defines;
+	quantized_defines.set("USE_VERTEX_QUANTIZATION");
+	size_t quantized_config_id = get_config_id(quantized_defines);
+	
+	/* add all the visible groups to draw queue */
+	draw_queue.clear();
+	draw_queue.set_depth_range(c.near, c.far);
+	s.to_visible_instances(c, visible_instances);
 	for (auto& instance : visible_instances) {
 		
-		/* get matrices from instance */
-		model = instance->matrix_global;
-		model_view = view * model;
-		model_view_proj = proj * model_view;
-		normal_mat = inverse_3x3(Mat3{
-			model[0][0], model[1][0], model[2][0],
-			model[0][1], model[1][1], model[2][1],
-			model[0][2], model[1][2], model[2][2],
-		});
-		
-		/* get mesh from instance */
-		auto* mesh = instance->mesh;
+		/* skip the instance if it is occluded */
+		if (occlusion_callback && !std::invoke(occlusion_callback, *instance)) {
+			++draw_stats.occluded_instances;
+			continue;
+		}
+		
+		/* get mesh from instance with the LOD of projected size */
+		int level = select_lod(*instance, c, lod_bias);
+		auto* mesh = level == 0 ? instance->mesh : &instance->mesh->lods[level - 1];
 		
 		/* check whether the scene is loaded */
-		if (mesh_cache.count(mesh) == 0) {
+		auto levels = mesh_cache.find(instance->mesh);
+		if (levels == mesh_cache.end() || level >= levels->second.size()) {
 			Error::set("Renderer", "Scene is not loaded");
 			continue;
 		}
 		
 		/* get vertex objects from mesh cache */
-		auto* vertex_object = mesh_cache.at(mesh).get();
+		auto* vertex_object = levels->second[level].get();
+		Vec3 position = instance->local_to_global({});
+		float depth = (c.position - position).dot(c.direction);
 		size_t group_size = mesh->groups.size();
 		for (int i = 0; i < group_size; ++i) {
 			
+			/* skip the group if it is removed from the LOD */
+			if (mesh->groups[i].length == 0) continue;
+			
 			/* get material from material groups */
-			auto& group = mesh->groups[i];
-			auto* material = s.get_material(group.name, *instance);
-			if (material == nullptr) {
-				material = s.get_material(group.name, *mesh);
-			}
-			if (material == nullptr) {
-				material = s.get_material(group.name);
-			}
+			auto* material = s.get_material(*instance, i);
 			if (material == nullptr) {
 				Error::set("Renderer", "Material is not linked");
 				continue;
@@ -709,117 +1008,116 @@ void Renderer::render_to_buffer(const Scene& s, const Camera& c, RenderingMode r
 			if (!material->visible) continue;
 			
 			/* check whether the material is transparent */
-			bool is_transparent = material->blending;
-			if (is_transparent != t) continue;
+			if (material->blending != t) continue;
 			
-			/* fetch the standard shader from shader lib */
-			auto* standard_shader = static_cast<const gpu::Shader*>(material->shader);
-			if (standard_shader == nullptr) {
-				Defines standard_defines;
-				set_material_defines(*material, standard_defines);
-				if (!t && r == DEFERRED_RENDERING) {
-					standard_defines.set("DEFERRED_RENDERING");
-				} else {
-					standard_defines.set("FORWARD_RENDERING");
-					set_scene_defines(s, standard_defines);
-				}
-				standard_shader = ShaderLib::fetch("Standard", standard_defines);
-			}
+			/* get the compiled material with shader and textures */
+			bool quantized = vertex_object[i].is_quantized();
+			auto& defines = quantized ? quantized_defines : scene_defines;
+			auto* compiled = compile_material(*material, defines, quantized ? quantized_config_id : config_id);
 			
-			/* render vertex object with shader */
+			/* add the group to draw queue */
+			draw_queue.add(instance, material, compiled->shader, vertex_object + i, i, depth, compiled);
+		}
+	}
+	
+	/* sort the packets and batch the runs sharing states */
+	draw_queue.sort();
+	batch_instances(false);
+	
+	/* render all the runs in sorted order */
+	const gpu::Shader* current_shader = nullptr;
+	const Material* current_material = nullptr;
+	const Instance* current_instance = nullptr;
+	const gpu::VertexObject* current_vertex_object = nullptr;
+	const void* bound_textures[32] = {};
+	int p = 0;
+	for (auto& [run_length, first_instance] : draw_runs) {
+		auto& packet = draw_queue.get_packet(p);
+		auto* standard_shader = packet.shader;
+		auto* material = packet.material;
+		auto* instance = packet.instance;
+		bool is_transparent = material->blending;
+		bool is_instanced = first_instance != -1;
+		p += run_length;
+		
+		/* switch to the instanced variant of the standard shader */
+		if (is_instanced && packet.vertex_object->is_quantized()) {
+			standard_shader = compile_instancing(*material, quantized_defines, quantized_config_id);
+		} else if (is_instanced) {
+			standard_shader = compile_instancing(*material, scene_defines, config_id);
+		}
+		
+		/* use program if the shader is switched */
+		bool shader_changed = standard_shader != current_shader;
+		if (shader_changed) {
 			standard_shader->use_program();
-			vertex_object[i].attach(*standard_shader);
+			++draw_stats.program_switches;
 			
 			if (is_transparent || r == FORWARD_RENDERING) {
 				/* pass the camera parameters to shader */
-				Mat4 inv_view_proj = inverse_4x4(c.projection * c.viewing);
-				standard_shader->set_uniform_m4("inv_view_proj", inv_view_proj);
+				standard_shader->set_uniform_m4(UNIFORM_INV_VIEW_PROJ, inv_view_proj);
 				
-				/* pass the lights & fogs parameters to shader */
-				set_light_uniforms(s, *standard_shader);
+				/* bind the lights & fogs parameters to shader */
+				set_light_uniforms(*standard_shader);
 			}
 			
-			/* pass the renderer parameters to shader */
-			standard_shader->set_uniform_m4("model"          , model          );
-			standard_shader->set_uniform_m4("view"           , view           );
-			standard_shader->set_uniform_m4("proj"           , proj           );
-			standard_shader->set_uniform_m4("model_view"     , model_view     );
-			standard_shader->set_uniform_m4("model_view_proj", model_view_proj);
-			standard_shader->set_uniform_m3("normal_mat"     , normal_mat     );
-			standard_shader->set_uniform_v3("camera_pos"     , camera_pos     );
-			
-			/* pass the material parameters to shader */
-			standard_shader->set_uniform_v3("color"      , material->color       );
-			standard_shader->set_uniform_f("alpha_test"  , material->alpha_test  );
-			standard_shader->set_uniform_f("alpha"       , material->alpha       );
-			standard_shader->set_uniform_f("ao_intensity", material->ao_intensity);
-			standard_shader->set_uniform_f("specular"    , material->specular    );
-			standard_shader->set_uniform_f("metalness"   , material->metalness   );
-			standard_shader->set_uniform_f("roughness"   , material->roughness   );
-			
-			/* pass the emissive parameter to shader */
-			Vec3 emissive = material->emissive * material->emissive_intensity;
-			standard_shader->set_uniform_v3("emissive", emissive);
+			/* bind the material block to shader */
+			standard_shader->set_uniform_block(UNIFORM_MATERIAL_BLOCK, MATERIAL_BLOCK_BINDING);
 			
-			/* pass the normal scale if use normal map */
-			if (material->normal_map != nullptr) {
-				standard_shader->set_uniform_f("normal_scale", material->normal_scale);
-			}
+			/* pass the camera parameters to shader */
+			standard_shader->set_uniform_m4(UNIFORM_VIEW      , view      );
+			standard_shader->set_uniform_m4(UNIFORM_PROJ      , proj      );
+			standard_shader->set_uniform_v3(UNIFORM_CAMERA_POS, camera_pos);
+		}
+		
+		/* count the switches of vertex array */
+		auto* vertex_object = packet.vertex_object;
+		if (current_vertex_object == nullptr || !vertex_object->shares_layout(*current_vertex_object)) {
+			++draw_stats.vertex_object_switches;
+		}
+		
+		/* pass the parameters to decode the quantized vertices */
+		if (vertex_object->is_quantized() && (shader_changed || vertex_object != current_vertex_object)) {
+			standard_shader->set_uniform_v3(UNIFORM_VERTEX_OFFSET, vertex_object->get_vertex_offset());
+			standard_shader->set_uniform_v3(UNIFORM_VERTEX_SCALE, vertex_object->get_vertex_scale());
+		}
+		
+		/* attach the instance buffer from the first instance of run */
+		if (is_instanced) {
+			instance_buffer->attach(*vertex_object, first_instance);
+			instance = nullptr;
+		}
+		
+		/* pass the renderer parameters if the instance is switched */
+		if (!is_instanced && (shader_changed || instance != current_instance)) {
+			model = instance->matrix_global;
+			model_view = view * model;
+			model_view_proj = proj * model_view;
+			normal_mat = inverse_3x3(Mat3{
+				model[0][0], model[1][0], model[2][0],
+				model[0][1], model[1][1], model[2][1],
+				model[0][2], model[1][2], model[2][2],
+			});
+			standard_shader->set_uniform_m4(UNIFORM_MODEL          , model          );
+			standard_shader->set_uniform_m4(UNIFORM_MODEL_VIEW     , model_view     );
+			standard_shader->set_uniform_m4(UNIFORM_MODEL_VIEW_PROJ, model_view_proj);
+			standard_shader->set_uniform_m3(UNIFORM_NORMAL_MAT     , normal_mat     );
+		}
+		
+		/* pass the material parameters if the material is switched */
+		if (shader_changed || material != current_material) {
+			auto* compiled = packet.compiled_material;
+			int texture_count = compiled->activate(MATERIAL_BLOCK_BINDING, 25, bound_textures);
+			draw_stats.texture_switches += texture_count;
 			
 			/* pass the displacement scale if use displacement map */
 			if (material->displacement_map != nullptr) {
-				standard_shader->set_uniform_f("displacement_scale", material->displacement_scale);
-			}
-			
-			/* pass the images linked with material */
-			for (int j = 0; j < 16; ++j) {
-				auto* image = material->custom_maps[j];
-				if (image != nullptr) image_cache.at(image)->activate(j);
-			}
-			if (material->normal_map != nullptr) {
-				auto& map = image_cache.at(material->normal_map);
-				standard_shader->set_uniform_i("normal_map", map->activate(16));
-			}
-			if (material->displacement_map != nullptr) {
-				auto& map = image_cache.at(material->displacement_map);
-				standard_shader->set_uniform_i("displacement_map", map->activate(17));
-			}
-			if (material->color_map != nullptr) {
-				auto& map = image_cache.at(material->color_map);
-				standard_shader->set_uniform_i("color_map", map->activate(18));
-			}
-			if (material->alpha_map != nullptr) {
-				auto& map = image_cache.at(material->alpha_map);
-				standard_shader->set_uniform_i("alpha_map", map->activate(19));
-			}
-			if (material->emissive_map != nullptr) {
-				auto& map = image_cache.at(material->emissive_map);
-				standard_shader->set_uniform_i("emissive_map", map->activate(20));
-			}
-			if (material->ao_map != nullptr) {
-				auto& map = image_cache.at(material->ao_map);
-				standard_shader->set_uniform_i("ao_map", map->activate(21));
-			}
-			if (material->roughness_map != nullptr) {
-				auto& map = image_cache.at(material->roughness_map);
-				standard_shader->set_uniform_i("roughness_map", map->activate(22));
-			}
-			if (material->metalness_map != nullptr) {
-				auto& map = image_cache.at(material->metalness_map);
-				standard_shader->set_uniform_i("metalness_map", map->activate(23));
-			}
-			if (material->specular_map != nullptr) {
-				auto& map = image_cache.at(material->specular_map);
-				standard_shader->set_uniform_i("specular_map", map->activate(24));
+				standard_shader->set_uniform_f(UNIFORM_DISPLACEMENT_SCALE, material->displacement_scale);
 			}
 			
-			/* pass the reflection probe linked with material */
-			auto* ref_probe = static_cast<const ReflectionProbe*>(material->reflection_probe);
-			if (ref_probe != nullptr) {
-				float ref_lod = log2f(ref_probe->resolution);
-				standard_shader->set_uniform_i("ref_map", ref_probe->activate(25));
-				standard_shader->set_uniform_f("ref_lod", ref_lod);
-				standard_shader->set_uniform_f("ref_intensity", ref_probe->intensity);
+			/* pass the material parameters to custom shader */
+			if (material->shader != nullptr) {
+				set_material_uniforms(*material, *standard_shader);
 			}
 			
 			/* pass the custom uniforms linked with material */
@@ -839,10 +1137,35 @@ void Renderer::render_to_buffer(const Scene& s, const Camera& c, RenderingMode r
 				gpu::State::enable_culling();
 				gpu::State::set_cull_side(BACK_SIDE);
 			}
-			
-			/* render the vertex object at group i */
-			vertex_object[i].render();
 		}
+		
+		/* check whether to cull the meshlets of vertex object */
+		bool use_meshlets = !is_instanced && meshlet_culling &&
+			!vertex_object->get_meshlets().empty() &&
+			material->displacement_map == nullptr;
+		
+		/* render the vertex object of the run */
+		if (is_instanced) {
+			vertex_object->render(run_length);
+			draw_stats.instances += run_length;
+			++draw_stats.draw_calls;
+		} else if (use_meshlets) {
+			bool cone = material->side == FRONT_SIDE;
+			int count = cull_meshlets(*vertex_object, model, normal_mat, c, frustum, cone);
+			if (count != 0) {
+				vertex_object->render(meshlet_firsts.data(), meshlet_counts.data(), count);
+				++draw_stats.draw_calls;
+			}
+		} else {
+			vertex_object->render();
+			++draw_stats.draw_calls;
+		}
+		
+		/* record the current states */
+		current_shader = standard_shader;
+		current_material = material;
+		current_instance = instance;
+		current_vertex_object = vertex_object;
 	}
 }
 
@@ -853,43 +1176,47 @@ void Renderer::render_to_shadow(const Scene& s, const Camera& c) const {
 	Mat4 proj = c.projection;
 	Mat4 model_view;
 	Mat4 model_view_proj;
+	Mat4 view_proj = proj * view;
+	
+	/* get the configurations of shadow shader once per pass */
+	Defines shadow_defines;
+	size_t config_id = get_config_id(shadow_defines);
+	Defines quantized_defines;
+	quantized_defines.set("USE_VERTEX_QUANTIZATION");
+	size_t quantized_config_id = get_config_id(quantized_defines);
 	
-	/* render all the visible instances in sorted order */
-	auto visible_instances = s.to_visible_instances();
-	sort_instances(c, visible_instances, false);
+	/* add all the visible groups casting shadow to draw queue */
+	draw_queue.clear();
+	draw_queue.set_depth_range(c.near, c.far);
+	s.to_visible_instances(c, visible_instances);
 	for (auto& instance : visible_instances) {
 		
 		/* check whether the instance casts shadow */
 		if (!instance->cast_shadow) continue;
 		
-		/* get matrices from instance */
-		model = instance->matrix_global;
-		model_view = view * model;
-		model_view_proj = proj * model_view;
-		
-		/* get mesh from instance */
-		auto* mesh = instance->mesh;
+		/* get mesh from instance with the LOD of projected size */
+		int level = select_lod(*instance, c, shadow_lod_bias);
+		auto* mesh = level == 0 ? instance->mesh : &instance->mesh->lods[level - 1];
 		
 		/* check whether the scene is loaded */
-		if (mesh_cache.count(mesh) == 0) {
+		auto levels = mesh_cache.find(instance->mesh);
+		if (levels == mesh_cache.end() || level >= levels->second.size()) {
 			Error::set("Renderer", "Scene is not loaded");
 			continue;
 		}
 		
 		/* get vertex objects from cache */
-		auto* vertex_object = mesh_cache.at(mesh).get();
+		auto* vertex_object = levels->second[level].get();
+		Vec3 position = instance->local_to_global({});
+		float depth = (c.position - position).dot(c.direction);
 		size_t group_size = mesh->groups.size();
 		for (int i = 0; i < group_size; ++i) {
 			
+			/* skip the group if it is removed from the LOD */
+			if (mesh->groups[i].length == 0) continue;
+			
 			/* get material from material groups */
-			auto& group = mesh->groups[i];
-			auto* material = s.get_material(group.name, *instance);
-			if (material == nullptr) {
-				material = s.get_material(group.name, *mesh);
-			}
-			if (material == nullptr) {
-				material = s.get_material(group.name);
-			}
+			auto* material = s.get_material(*instance, i);
 			if (material == nullptr) {
 				Error::set("Renderer", "Material is not linked");
 				continue;
@@ -901,35 +1228,99 @@ void Renderer::render_to_shadow(const Scene& s, const Camera& c) const {
 			/* check whether the material is transparent */
 			if (material->blending) continue;
 			
-			/* whether to use color map and alpha map */
-			bool use_color_map = material->color_map != nullptr && material->use_map_with_alpha;
-			bool use_alpha_map = material->alpha_map != nullptr;
+			/* get the compiled material with shadow shader */
+			bool quantized = vertex_object[i].is_quantized();
+			auto& defines = quantized ? quantized_defines : shadow_defines;
+			auto* compiled = compile_shadow(*material, defines, quantized ? quantized_config_id : config_id);
 			
-			/* fetch the shadow shader from shader lib */
-			Defines shadow_defines;
-			shadow_defines.set_if("USE_COLOR_MAP", use_color_map);
-			shadow_defines.set_if("USE_ALPHA_MAP", use_alpha_map);
-			auto* shadow_shader = ShaderLib::fetch("Shadow", shadow_defines);
-			
-			/* render vertex object with shader */
+			/* add the group to draw queue */
+			draw_queue.add(instance, material, compiled->shadow_shader, vertex_object + i, i, depth, compiled);
+		}
+	}
+	
+	/* sort the packets and batch the runs sharing states */
+	draw_queue.sort();
+	batch_instances(true);
+	
+	/* render all the runs in sorted order */
+	const gpu::Shader* current_shader = nullptr;
+	const Material* current_material = nullptr;
+	const Instance* current_instance = nullptr;
+	const gpu::VertexObject* current_vertex_object = nullptr;
+	const gpu::Texture* bound_textures[2] = {};
+	int p = 0;
+	for (auto& [run_length, first_instance] : draw_runs) {
+		auto& packet = draw_queue.get_packet(p);
+		auto* shadow_shader = packet.shader;
+		auto* material = packet.material;
+		auto* instance = packet.instance;
+		bool is_instanced = first_instance != -1;
+		p += run_length;
+		
+		/* switch to the instanced variant of the shadow shader */
+		if (is_instanced && packet.vertex_object->is_quantized()) {
+			shadow_shader = compile_shadow_instancing(*material, quantized_defines, quantized_config_id);
+		} else if (is_instanced) {
+			shadow_shader = compile_shadow_instancing(*material, shadow_defines, config_id);
+		}
+		
+		/* use program if the shader is switched */
+		bool shader_changed = shadow_shader != current_shader;
+		if (shader_changed) {
 			shadow_shader->use_program();
-			vertex_object[i].attach(*shadow_shader);
-			
-			/* pass the renderer parameters to shader */
-			shadow_shader->set_uniform_m4("model_view_proj", model_view_proj);
-			
-			/* pass the material parameters to shader */
-			shadow_shader->set_uniform_f("alpha", material->alpha);
-			shadow_shader->set_uniform_f("alpha_test", material->alpha_test);
-			shadow_shader->set_uniform_i("color_map", 0);
-			shadow_shader->set_uniform_i("alpha_map", 1);
+			shadow_shader->set_uniform_i(UNIFORM_COLOR_MAP, 0);
+			shadow_shader->set_uniform_i(UNIFORM_ALPHA_MAP, 1);
+			shadow_shader->set_uniform_m4(UNIFORM_VIEW_PROJ, view_proj);
+			++draw_stats.program_switches;
+		}
+		
+		/* count the switches of vertex array */
+		auto* vertex_object = packet.vertex_object;
+		if (current_vertex_object == nullptr || !vertex_object->shares_layout(*current_vertex_object)) {
+			++draw_stats.vertex_object_switches;
+		}
+		
+		/* pass the parameters to decode the quantized vertices */
+		if (vertex_object->is_quantized() && (shader_changed || vertex_object != current_vertex_object)) {
+			shadow_shader->set_uniform_v3(UNIFORM_VERTEX_OFFSET, vertex_object->get_vertex_offset());
+			shadow_shader->set_uniform_v3(UNIFORM_VERTEX_SCALE, vertex_object->get_vertex_scale());
+		}
+		
+		/* attach the instance buffer from the first instance of run */
+		if (is_instanced) {
+			instance_buffer->attach(*vertex_object, first_instance);
+			instance = nullptr;
+		}
+		
+		/* pass the renderer parameters if the instance is switched */
+		if (!is_instanced && (shader_changed || instance != current_instance)) {
+			model = instance->matrix_global;
+			model_view = view * model;
+			model_view_proj = proj * model_view;
+			shadow_shader->set_uniform_m4(UNIFORM_MODEL_VIEW_PROJ, model_view_proj);
+		}
+		
+		/* pass the material parameters if the material is switched */
+		if (shader_changed || material != current_material) {
+			shadow_shader->set_uniform_f(UNIFORM_ALPHA, material->alpha);
+			shadow_shader->set_uniform_f(UNIFORM_ALPHA_TEST, material->alpha_test);
 			
 			/* activate color map linked with material */
-			if (use_color_map) {
-				image_cache.at(material->color_map)->activate(0);
+			if (material->color_map != nullptr && material->use_map_with_alpha) {
+				auto* texture = get_image_texture(material->color_map);
+				if (bound_textures[0] != texture) {
+					texture->activate(0);
+					bound_textures[0] = texture;
+					++draw_stats.texture_switches;
+				}
 			}
-			if (use_alpha_map) {
-				image_cache.at(material->alpha_map)->activate(1);
+			if (material->alpha_map != nullptr) {
+				auto* texture = get_image_texture(material->alpha_map);
+				if (bound_textures[1] != texture) {
+					texture->activate(1);
+					bound_textures[1] = texture;
+					++draw_stats.texture_switches;
+				}
 			}
 			
 			/* set the states of GPU pipeline by material */
@@ -938,46 +1329,345 @@ void Renderer::render_to_shadow(const Scene& s, const Camera& c) const {
 			gpu::MaterialState::set_blending(*material);
 			gpu::MaterialState::set_shadow_side(*material);
 			gpu::MaterialState::set_wireframe(*material);
-			
-			/* render the vertex object for group i */
-			vertex_object[i].render();
 		}
+		
+		/* render the vertex object of the run */
+		if (is_instanced) {
+			vertex_object->render(run_length);
+			draw_stats.instances += run_length;
+		} else {
+			vertex_object->render();
+		}
+		++draw_stats.draw_calls;
+		
+		/* record the current states */
+		current_shader = shadow_shader;
+		current_material = material;
+		current_instance = instance;
+		current_vertex_object = vertex_object;
 	}
 }
 
-void Renderer::init_cube() {
-	cube = std::make_unique<gpu::VertexObject>();
-	Mesh box = BoxMesh::create();
-	cube->load(box, box.groups[0]);
+void Renderer::batch_instances(bool s) const {
+	draw_runs.clear();
+	instance_data.clear();
+	int instance_count = 0;
+	int packet_count = static_cast<int>(draw_queue.get_packet_count());
+	for (int p = 0; p < packet_count;) {
+		auto& packet = draw_queue.get_packet(p);
+		int run_length = draw_queue.get_run_length(p);
+		
+		/* materials with custom shaders are drawn one by one */
+		bool use_instancing = instancing && run_length > 1;
+		if (!s && packet.material->shader != nullptr) use_instancing = false;
+		if (!use_instancing) {
+			for (int i = 0; i < run_length; ++i) draw_runs.emplace_back(1, -1);
+			p += run_length;
+			continue;
+		}
+		
+		/* pack model & normal matrices in column-major order */
+		draw_runs.emplace_back(run_length, instance_count);
+		for (int i = 0; i < run_length; ++i) {
+			const Mat4& model = draw_queue.get_packet(p + i).instance->matrix_global;
+			Mat3 normal_mat = inverse_3x3(Mat3{
+				model[0][0], model[1][0], model[2][0],
+				model[0][1], model[1][1], model[2][1],
+				model[0][2], model[1][2], model[2][2],
+			});
+			for (int c = 0; c < 4; ++c) {
+				for (int r = 0; r < 4; ++r) instance_data.emplace_back(model[r][c]);
+			}
+			for (int c = 0; c < 3; ++c) {
+				for (int r = 0; r < 3; ++r) instance_data.emplace_back(normal_mat[r][c]);
+			}
+		}
+		instance_count += run_length;
+		p += run_length;
+	}
+	
+	/* upload the instance data once per pass */
+	if (instance_count == 0) return;
+	if (!instance_buffer) instance_buffer = std::make_unique<gpu::InstanceBuffer>();
+	instance_buffer->load(instance_data.data(), instance_count);
 }
 
-void Renderer::sort_instances(const Camera& c, std::vector<const Instance*>& l, bool t) {
-	using InstanceItem = std::pair<const Instance*, float>;
-	std::vector<InstanceItem> sorted_instances;
-	auto instances_size = l.size();
-	sorted_instances.resize(instances_size);
-	for (int i = 0; i < instances_size; ++i) {
-		Vec3 position = l[i]->local_to_global({});
-		sorted_instances[i].first = l[i];
-		sorted_instances[i].second = (c.position - position).dot(c.direction);
-	}
-	auto compare = t ?
-	std::function([](const InstanceItem& a, const InstanceItem& b) -> bool {
-		if (a.first->priority != b.first->priority) {
-			return a.first->priority < b.first->priority;
-		}
-		return a.second > b.second;
-	}) :
-	std::function([](const InstanceItem& a, const InstanceItem& b) -> bool {
-		if (a.first->priority != b.first->priority) {
-			return a.first->priority < b.first->priority;
-		}
-		return a.second < b.second;
+size_t Renderer::get_config_id(const Defines& d) const {
+	auto config = scene_configs.try_emplace(d.get(), config_count, compile_stamp);
+	if (config.second) ++config_count;
+	config.first->second.second = compile_stamp;
+	return config.first->second.first;
+}
+
+void Renderer::sweep_compiled_materials() const {
+	/* remove the caches unused for a while once in a lifetime */
+	if (++compile_stamp % COMPILED_MATERIAL_LIFETIME != 0) return;
+	std::erase_if(compiled_materials, [this](const auto& c) -> bool {
+		return c.second->stamp + COMPILED_MATERIAL_LIFETIME < compile_stamp;
+	});
+	std::erase_if(scene_configs, [this](const auto& c) -> bool {
+		return c.second.second + COMPILED_MATERIAL_LIFETIME < compile_stamp;
 	});
-	std::stable_sort(sorted_instances.begin(), sorted_instances.end(), compare);
-	for (int i = 0; i < instances_size; ++i) {
-		l[i] = sorted_instances[i].first;
+}
+
+const CompiledMaterial* Renderer::compile_material(const Material& m, const Defines& d, size_t c) const {
+	/* return the compiled material if it is checked in this pass */
+	auto& compiled = compiled_materials[{&m, c}];
+	if (compiled && compiled->stamp == compile_stamp) return compiled.get();
+	bool created = !compiled;
+	if (created) compiled = std::make_unique<CompiledMaterial>();
+	compiled->stamp = compile_stamp;
+	
+	/* resolve the textures linked with material */
+	compiled->textures.clear();
+	for (int i = 0; i < 16; ++i) {
+		auto* image = m.custom_maps[i];
+		if (image == nullptr) continue;
+		compiled->textures.emplace_back(i, get_image_texture(image));
+	}
+	const Image* maps[] = {
+		m.normal_map, m.displacement_map, m.color_map, m.alpha_map, m.emissive_map,
+		m.ao_map, m.roughness_map, m.metalness_map, m.specular_map,
+	};
+	uint32_t features = 0;
+	for (int i = 0; i < 9; ++i) {
+		if (maps[i] == nullptr) continue;
+		compiled->textures.emplace_back(16 + i, get_image_texture(maps[i]));
+		features |= 1 << i;
+	}
+	
+	/* resolve the reflection probe linked with material */
+	auto* ref_probe = static_cast<const ReflectionProbe*>(m.reflection_probe);
+	compiled->reflection_probe = ref_probe;
+	float ref_lod = ref_probe == nullptr ? 0 : log2f(ref_probe->resolution);
+	float ref_intensity = ref_probe == nullptr ? 0 : ref_probe->intensity;
+	
+	/* fetch the standard shader again if the features are changed */
+	features |= m.use_vertex_color << 9 | m.use_tangent_space << 10;
+	features |= m.use_map_with_alpha << 11 | (ref_probe != nullptr) << 12;
+	if (created || compiled->features != features || compiled->custom_shader != m.shader) {
+		auto* shader = static_cast<const gpu::Shader*>(m.shader);
+		if (shader == nullptr) {
+			Defines standard_defines = d;
+			set_material_defines(m, standard_defines);
+			shader = ShaderLib::fetch("Standard", standard_defines);
+		}
+		compiled->features = features;
+		compiled->custom_shader = m.shader;
+		compiled->shader = shader;
+		compiled->instanced_shader = nullptr;
+		
+		/* set the texture units of samplers */
+		set_material_samplers(*shader);
+	}
+	
+	/* pack the parameters in std140 layout of material block */
+	Vec3 emissive = m.emissive * m.emissive_intensity;
+	float parameters[] = {
+		m.color.x, m.color.y, m.color.z, m.alpha,
+		emissive.x, emissive.y, emissive.z, m.alpha_test,
+		m.ao_intensity, m.metalness, m.roughness, m.specular,
+		m.normal_scale, ref_lod, ref_intensity, 0,
+	};
+	
+	/* upload the parameters only if they are changed */
+	if (!created && std::equal(parameters, parameters + 16, compiled->parameter_values)) {
+		return compiled.get();
+	}
+	std::copy(parameters, parameters + 16, compiled->parameter_values);
+	compiled->parameters.load(parameters, sizeof(parameters));
+	return compiled.get();
+}
+
+const gpu::Shader* Renderer::compile_instancing(const Material& m, const Defines& d, size_t c) const {
+	/* return the instanced shader if it is fetched */
+	auto& compiled = compiled_materials.at({&m, c});
+	if (compiled->instanced_shader != nullptr) return compiled->instanced_shader;
+	
+	/* fetch the standard shader with instancing from shader lib */
+	Defines instanced_defines = d;
+	set_material_defines(m, instanced_defines);
+	instanced_defines.set("INSTANCING");
+	auto* shader = ShaderLib::fetch("Standard", instanced_defines);
+	compiled->instanced_shader = shader;
+	
+	/* set the texture units of samplers */
+	set_material_samplers(*shader);
+	return shader;
+}
+
+const CompiledMaterial* Renderer::compile_shadow(const Material& m, const Defines& d, size_t c) const {
+	/* return the compiled material if it is checked in this pass */
+	auto& compiled = compiled_materials[{&m, c}];
+	if (compiled && compiled->stamp == compile_stamp) return compiled.get();
+	bool created = !compiled;
+	if (created) compiled = std::make_unique<CompiledMaterial>();
+	compiled->stamp = compile_stamp;
+	
+	/* fetch the shadow shader again if the maps with alpha are changed */
+	bool use_color_map = m.color_map != nullptr && m.use_map_with_alpha;
+	bool use_alpha_map = m.alpha_map != nullptr;
+	uint32_t features = use_color_map | use_alpha_map << 1;
+	if (created || compiled->features != features) {
+		Defines shadow_defines = d;
+		shadow_defines.set_if("USE_COLOR_MAP", use_color_map);
+		shadow_defines.set_if("USE_ALPHA_MAP", use_alpha_map);
+		compiled->features = features;
+		compiled->shadow_shader = ShaderLib::fetch("Shadow", shadow_defines);
+		compiled->instanced_shadow_shader = nullptr;
+	}
+	return compiled.get();
+}
+
+const gpu::Shader* Renderer::compile_shadow_instancing(const Material& m, const Defines& d, size_t c) const {
+	/* return the instanced shadow shader if it is fetched */
+	auto& compiled = compiled_materials.at({&m, c});
+	if (compiled->instanced_shadow_shader != nullptr) return compiled->instanced_shadow_shader;
+	
+	/* fetch the shadow shader with instancing from shader lib */
+	Defines instanced_defines = d;
+	instanced_defines.set_if("USE_COLOR_MAP", (compiled->features & 1) != 0);
+	instanced_defines.set_if("USE_ALPHA_MAP", (compiled->features & 2) != 0);
+	instanced_defines.set("INSTANCING");
+	auto* shader = ShaderLib::fetch("Shadow", instanced_defines);
+	compiled->instanced_shadow_shader = shader;
+	return shader;
+}
+
+int Renderer::select_lod(const Instance& i, const Camera& c, float b) {
+	auto* mesh = i.mesh;
+	if (mesh == nullptr || mesh->lods.empty()) return 0;
+	
+	/* calculate the projected radius of bounding sphere */
+	Vec3 bound_min;
+	Vec3 bound_max;
+	i.get_bounds(bound_min, bound_max);
+	Vec3 center = (bound_min + bound_max) * .5f;
+	float radius = (bound_max - bound_min).magnitude() * .5f;
+	float size = radius * c.projection[1][1];
+	if (c.is_perspective()) {
+		float depth = (c.position - center).dot(c.direction);
+		if (depth <= radius) return 0;
+		size /= depth;
+	}
+	
+	/* select the coarsest LOD whose projected error is acceptable */
+	float tolerance = LOD_SCREEN_ERROR * b;
+	for (int k = static_cast<int>(mesh->lods.size()) - 1; k >= 0; --k) {
+		if (mesh->lods[k].lod_error * size <= tolerance) return k + 1;
+	}
+	return 0;
+}
+
+int Renderer::cull_meshlets(const gpu::VertexObject& v, const Mat4& m, const Mat3& n, const Camera& c, const Frustum& f, bool b) const {
+	meshlet_firsts.clear();
+	meshlet_counts.clear();
+	
+	/* calculate the scale of bounding spheres by model matrix */
+	Vec3 axis_x = {m[0][0], m[1][0], m[2][0]};
+	Vec3 axis_y = {m[0][1], m[1][1], m[2][1]};
+	Vec3 axis_z = {m[0][2], m[1][2], m[2][2]};
+	float scale_x = axis_x.magnitude();
+	float scale_y = axis_y.magnitude();
+	float scale_z = axis_z.magnitude();
+	float max_scale = std::max({scale_x, scale_y, scale_z});
+	float min_scale = std::min({scale_x, scale_y, scale_z});
+	
+	/* the normal cones are only valid for uniform scale without mirroring */
+	bool mirrored = axis_x.cross(axis_y).dot(axis_z) < 0;
+	bool use_cone = b && !mirrored && max_scale - min_scale <= max_scale * MESHLET_SCALE_TOLERANCE;
+	
+	/* cull the meshlets by frustum and normal cones */
+	for (auto& meshlet : v.get_meshlets()) {
+		Vec3 center = m * Vec4(meshlet.center, 1);
+		float radius = meshlet.radius * max_scale;
+		if (!f.intersects_sphere(center, radius)) {
+			++draw_stats.culled_meshlets;
+			continue;
+		}
+		if (use_cone && meshlet.cone_cutoff < 1) {
+			Vec3 cone_axis = Vec3(n * meshlet.cone_axis).normalize();
+			Vec3 view = c.is_perspective() ? center - c.position : -c.direction;
+			float bias = c.is_perspective() ? radius : 0;
+			if (view.dot(cone_axis) >= meshlet.cone_cutoff * view.magnitude() + bias) {
+				++draw_stats.culled_meshlets;
+				continue;
+			}
+		}
+		
+		/* merge the adjacent ranges of surviving meshlets */
+		if (!meshlet_firsts.empty() && meshlet_firsts.back() + meshlet_counts.back() == meshlet.position) {
+			meshlet_counts.back() += meshlet.length;
+		} else {
+			meshlet_firsts.emplace_back(meshlet.position);
+			meshlet_counts.emplace_back(meshlet.length);
+		}
 	}
+	return static_cast<int>(meshlet_firsts.size());
+}
+
+void Renderer::set_material_samplers(const gpu::Shader& shader) {
+	/* set the texture units of samplers */
+	shader.use_program();
+	shader.set_uniform_i(UNIFORM_NORMAL_MAP      , 16);
+	shader.set_uniform_i(UNIFORM_DISPLACEMENT_MAP, 17);
+	shader.set_uniform_i(UNIFORM_COLOR_MAP       , 18);
+	shader.set_uniform_i(UNIFORM_ALPHA_MAP       , 19);
+	shader.set_uniform_i(UNIFORM_EMISSIVE_MAP    , 20);
+	shader.set_uniform_i(UNIFORM_AO_MAP          , 21);
+	shader.set_uniform_i(UNIFORM_ROUGHNESS_MAP   , 22);
+	shader.set_uniform_i(UNIFORM_METALNESS_MAP   , 23);
+	shader.set_uniform_i(UNIFORM_SPECULAR_MAP    , 24);
+	shader.set_uniform_i(UNIFORM_REF_MAP         , 25);
+}
+
+void Renderer::set_material_uniforms(const Material& m, const gpu::Shader& shader) {
+	/* pass the material parameters to shader */
+	shader.set_uniform_v3(UNIFORM_COLOR      , m.color       );
+	shader.set_uniform_f(UNIFORM_ALPHA_TEST  , m.alpha_test  );
+	shader.set_uniform_f(UNIFORM_ALPHA       , m.alpha       );
+	shader.set_uniform_f(UNIFORM_AO_INTENSITY, m.ao_intensity);
+	shader.set_uniform_f(UNIFORM_SPECULAR    , m.specular    );
+	shader.set_uniform_f(UNIFORM_METALNESS   , m.metalness   );
+	shader.set_uniform_f(UNIFORM_ROUGHNESS   , m.roughness   );
+	
+	/* pass the emissive parameter to shader */
+	Vec3 emissive = m.emissive * m.emissive_intensity;
+	shader.set_uniform_v3(UNIFORM_EMISSIVE, emissive);
+	
+	/* pass the normal scale if use normal map */
+	if (m.normal_map != nullptr) {
+		shader.set_uniform_f(UNIFORM_NORMAL_SCALE, m.normal_scale);
+	}
+	
+	/* pass the reflection probe parameters if use reflection probe */
+	auto* ref_probe = static_cast<const ReflectionProbe*>(m.reflection_probe);
+	if (ref_probe != nullptr) {
+		float ref_lod = log2f(ref_probe->resolution);
+		shader.set_uniform_f(UNIFORM_REF_LOD, ref_lod);
+		shader.set_uniform_f(UNIFORM_REF_INTENSITY, ref_probe->intensity);
+	}
+}
+
+const gpu::Texture* Renderer::get_image_texture(const Image* i) const {
+	auto iter = image_placeholders.find(i);
+	if (iter != image_placeholders.end()) return iter->second.get();
+	return image_cache.at(i).get();
+}
+
+void Renderer::cancel_image_upload(const Image* i) {
+	/* the chunks in flight still occupy the ring until retired */
+	for (auto& chunk : upload_chunks) {
+		if (chunk.image == i) chunk.texture = nullptr;
+	}
+	std::erase_if(image_uploads, [i](const ImageUpload& u) { return u.image == i; });
+	image_placeholders.erase(i);
+}
+
+void Renderer::init_cube() {
+	cube = std::make_unique<gpu::VertexObject>();
+	Mesh box = BoxMesh::create();
+	cube->load(box, box.groups[0]);
 }
 
 std::unique_ptr<gpu::VertexObject> Renderer::cube;
@@ -988,4 +1678,8 @@ std::unique_ptr<gpu::Renderbuffer> Renderer::probe_buffer;
 
 std::unique_ptr<gpu::RenderTarget> Renderer::probe_target;
 
+std::unique_ptr<gpu::UniformBuffer> Renderer::light_buffer;
+
+std::unique_ptr<gpu::InstanceBuffer> Renderer::instance_buffer;
+
 }
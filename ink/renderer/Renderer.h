@@ -22,11 +22,16 @@
 
 #pragma once
 
+#include "CompiledMaterial.h"
+#include "DrawQueue.h"
+
 #include "../graphics/Gpu.h"
 #include "../scene/Scene.h"
 #include "../probes/ReflectionProbe.h"
 
+#include <deque>
 #include <functional>
+#include <map>
 
 namespace ink {
 
@@ -39,6 +44,8 @@ class Renderer {
 public:
 	using TextureCallback = std::function<void(gpu::Texture&)>;
 	
+	using OcclusionCallback = std::function<bool(const Instance&)>;
+	
 	/**
 	 * Creates a new Renderer object.
 	 */
@@ -118,6 +125,80 @@ public:
 	 */
 	void set_rendering_mode(RenderingMode m);
 	
+	/**
+	 * Returns true if the renderer draws the runs of groups sharing mesh and
+	 * material with instanced draw calls.
+	 */
+	bool get_instancing() const;
+	
+	/**
+	 * Determines whether to draw the runs of groups sharing mesh and material
+	 * with instanced draw calls. The default is true. Materials with custom
+	 * shaders are always drawn one by one.
+	 *
+	 * \param i whether to enable instancing
+	 */
+	void set_instancing(bool i);
+	
+	/**
+	 * Returns true if the vertex attributes are quantized when loading meshes.
+	 */
+	bool get_vertex_quantization() const;
+	
+	/**
+	 * Determines whether to quantize the vertex attributes when loading meshes
+	 * to reduce the vertex bandwidth and memory. The default is false. Meshes
+	 * loaded before are not affected. Materials with custom shaders must
+	 * decode the quantized attributes themselves.
+	 *
+	 * \param q whether to enable vertex quantization
+	 */
+	void set_vertex_quantization(bool q);
+	
+	/**
+	 * Returns the bias of selecting the levels of detail of meshes.
+	 */
+	float get_lod_bias() const;
+	
+	/**
+	 * Sets the bias of selecting the levels of detail of meshes. The LOD of
+	 * instance is selected by the projected size of its bounding sphere, the
+	 * coarsest LOD whose projected error is acceptable is used. Larger values
+	 * select coarser LODs. The default is 1.
+	 *
+	 * \param b LOD bias
+	 */
+	void set_lod_bias(float b);
+	
+	/**
+	 * Returns the bias of selecting the levels of detail of meshes in shadow
+	 * passes.
+	 */
+	float get_shadow_lod_bias() const;
+	
+	/**
+	 * Sets the bias of selecting the levels of detail of meshes in shadow
+	 * passes. Larger values select coarser LODs. The default is 2.
+	 *
+	 * \param b LOD bias
+	 */
+	void set_shadow_lod_bias(float b);
+	
+	/**
+	 * Returns true if the meshlets are culled when rendering.
+	 */
+	bool get_meshlet_culling() const;
+	
+	/**
+	 * Determines whether to cull the meshlets of meshes by the view frustum
+	 * and their normal cones when rendering. The surviving meshlets of each
+	 * group are rendered in one draw call. Only the groups with meshlets
+	 * created by MeshOptimizer are affected. The default is true.
+	 *
+	 * \param c whether to enable meshlet culling
+	 */
+	void set_meshlet_culling(bool c);
+	
 	/**
 	 * Returns the current render target if there is one, returns nullptr
 	 * otherwise.
@@ -139,6 +220,15 @@ public:
 	 */
 	void set_texture_callback(const TextureCallback& f);
 	
+	/**
+	 * Sets the occlusion callback which will be called for each instance in
+	 * the view frustum before its groups are submitted. The instance will be
+	 * skipped if the callback returns false. Shadow passes are not affected.
+	 *
+	 * \param f occlusion callback function
+	 */
+	void set_occlusion_callback(const OcclusionCallback& f);
+	
 	/**
 	 * Returns the intensity of the skybox.
 	 */
@@ -181,14 +271,18 @@ public:
 	void render_skybox(const Camera& c) const;
 	
 	/**
-	 * Loads the specified mesh and creates corresponding vertex object.
+	 * Loads the specified mesh and creates corresponding vertex object. The
+	 * levels of detail of the mesh are loaded together and cached under the
+	 * mesh. The mesh should be unloaded before loading again if its data or
+	 * levels of detail are changed.
 	 *
 	 * \param m mesh
 	 */
 	void load_mesh(const Mesh& m);
 	
 	/**
-	 * Unloads the specified mesh and deletes corresponding vertex object.
+	 * Unloads the specified mesh and deletes corresponding vertex object. The
+	 * levels of detail of the mesh are unloaded together.
 	 * 
 	 * \param m mesh
 	 */
@@ -202,7 +296,9 @@ public:
 	
 	/**
 	 * Loads the specified image and creates corresponding texture. This
-	 * function will invoke the texture callback.
+	 * function will invoke the texture callback. If texture streaming is
+	 * enabled, the image is queued and the callback is invoked when its texture
+	 * becomes resident in update_textures.
 	 *
 	 * \param i image
 	 */
@@ -221,6 +317,50 @@ public:
 	 */
 	void clear_image_caches();
 	
+	/**
+	 * Returns true if the images are streamed to textures over frames.
+	 */
+	bool get_texture_streaming() const;
+	
+	/**
+	 * Determines whether to stream the images to textures over frames. If
+	 * enabled, loading an image only allocates its texture and queues the
+	 * pixels, which are uploaded by update_textures through a ring of pixel
+	 * buffers. A placeholder of the average color is used until the texture
+	 * becomes resident, and the image must be kept alive until then. Images
+	 * loaded before are not affected. The default is false.
+	 *
+	 * \param s whether to enable texture streaming
+	 */
+	void set_texture_streaming(bool s);
+	
+	/**
+	 * Returns the maximum number of bytes uploaded in each update_textures.
+	 */
+	size_t get_texture_upload_budget() const;
+	
+	/**
+	 * Sets the maximum number of bytes uploaded in each update_textures. At
+	 * least one row of image is uploaded regardless of the budget. The default
+	 * is 4 MiB.
+	 *
+	 * \param b upload budget in bytes
+	 */
+	void set_texture_upload_budget(size_t b);
+	
+	/**
+	 * Returns the number of streamed images whose textures are not resident.
+	 */
+	size_t get_pending_image_count() const;
+	
+	/**
+	 * Uploads the pixels of the queued images within the upload budget, and
+	 * makes the textures resident whose uploads are completed by GPU. This
+	 * function never waits for GPU and should be called once per frame when
+	 * texture streaming is enabled.
+	 */
+	void update_textures();
+	
 	/**
 	 * Loads all the meshes and images in the scene.
 	 *
@@ -241,9 +381,20 @@ public:
 	 */
 	void clear_scene_caches();
 	
+	/**
+	 * Clears the compiled material cache. The caches are generated
+	 * automatically when rendering. The materials are checked once per pass,
+	 * where the changed parameters are uploaded again and the program is
+	 * fetched again if the maps or features are changed. The caches of the
+	 * materials in a scene are removed when unloading the scene, and the
+	 * caches unused for a while are removed automatically.
+	 */
+	void clear_material_caches();
+	
 	/**
 	 * Renders a scene using a camera. The results will be rendered to the
-	 * current render target.
+	 * current render target. The visible instances are prepared by
+	 * update_scene, which should be called after the scene is changed.
 	 *
 	 * \param s scene
 	 * \param c camera
@@ -295,8 +446,22 @@ public:
 	 */
 	void update_probe(const Scene& s, ReflectionProbe& r) const;
 	
+	/**
+	 * Returns the statistics of draw calls and state switches since the last
+	 * reset.
+	 */
+	DrawStats get_draw_stats() const;
+	
+	/**
+	 * Resets the statistics of draw calls and state switches. This is usually
+	 * called at the beginning of every frame.
+	 */
+	void reset_draw_stats();
+	
 	/**
 	 * Updates all the instances in the scene before the scene is rendered.
+	 * The instances added, removed or changed by setters since the last
+	 * update are not rendered correctly until the scene is updated.
 	 *
 	 * \param s scene
 	 */
@@ -319,12 +484,19 @@ public:
 	static void set_scene_defines(const Scene& s, Defines& d);
 	
 	/**
-	 * Sets the uniforms object for the lights.
+	 * Packs the lights and fogs of the scene into the light uniform buffer and
+	 * binds it. This should be called once before the scene is rendered.
 	 *
 	 * \param s scene
+	 */
+	static void set_light_buffer(const Scene& s);
+	
+	/**
+	 * Binds the light uniform buffer and the shadow map to the shader.
+	 *
 	 * \param shader shader
 	 */
-	static void set_light_uniforms(const Scene& s, const gpu::Shader& shader);
+	static void set_light_uniforms(const gpu::Shader& shader);
 	
 private:
 	Vec4 clear_color = {0, 0, 0, 0};
@@ -341,16 +513,79 @@ private:
 		t.generate_mipmap(); /* generate mipmap for every texture */
 	};
 	
+	OcclusionCallback occlusion_callback;
+	
 	RenderingMode rendering_mode = DEFERRED_RENDERING;
 	
+	bool instancing = true;
+	
+	bool vertex_quantization = false;
+	
+	float lod_bias = 1;
+	
+	float shadow_lod_bias = 2;
+	
+	bool meshlet_culling = true;
+	
 	float skybox_intensity = 1;
 	
 	std::unique_ptr<gpu::Texture> skybox_map;
 	
-	std::unordered_map<const Mesh*, std::unique_ptr<gpu::VertexObject[]>> mesh_cache;
+	std::unordered_map<int, std::unique_ptr<gpu::GeometryArena>> geometry_arenas;
+	
+	std::unordered_map<const Mesh*, std::vector<std::unique_ptr<gpu::VertexObject[]>>> mesh_cache;
 	
 	std::unordered_map<const Image*, std::unique_ptr<gpu::Texture>> image_cache;
 	
+	struct ImageUpload {
+		const Image* image = nullptr;             /**< image to upload */
+		int row = 0;                              /**< next row to upload */
+	};
+	
+	struct UploadChunk {
+		const Image* image = nullptr;             /**< image of the rows */
+		const gpu::Texture* texture = nullptr;    /**< texture of the rows, nullptr if unloaded */
+		size_t offset = 0;                        /**< offset in the upload buffer */
+		bool last = false;                        /**< whether this is the last chunk of image */
+		std::unique_ptr<gpu::Fence> fence;        /**< fence of the upload commands */
+	};
+	
+	bool texture_streaming = false;
+	
+	size_t texture_upload_budget = 4 << 20;
+	
+	size_t upload_head = 0;
+	
+	std::unique_ptr<gpu::PixelBuffer> upload_buffer;
+	
+	std::deque<ImageUpload> image_uploads;
+	
+	std::deque<UploadChunk> upload_chunks;
+	
+	std::unordered_map<const Image*, std::unique_ptr<gpu::Texture>> image_placeholders;
+	
+	mutable size_t compile_stamp = 0;
+	
+	mutable size_t config_count = 0;
+	
+	mutable std::unordered_map<std::string, std::pair<size_t, size_t>> scene_configs;
+	
+	mutable std::map<std::pair<const Material*, size_t>, std::unique_ptr<CompiledMaterial>> compiled_materials;
+	
+	mutable std::vector<const Instance*> visible_instances;
+	
+	mutable DrawQueue draw_queue;
+	
+	mutable DrawStats draw_stats;
+	
+	mutable std::vector<std::pair<int, int>> draw_runs;
+	
+	mutable std::vector<float> instance_data;
+	
+	mutable std::vector<int> meshlet_firsts;
+	
+	mutable std::vector<int> meshlet_counts;
+	
 	static std::unique_ptr<gpu::VertexObject> cube;
 	
 	static std::unique_ptr<gpu::Texture> probe_map;
@@ -359,6 +594,10 @@ private:
 	
 	static std::unique_ptr<gpu::RenderTarget> probe_target;
 	
+	static std::unique_ptr<gpu::UniformBuffer> light_buffer;
+	
+	static std::unique_ptr<gpu::InstanceBuffer> instance_buffer;
+	
 	void render_skybox_to_buffer(const Camera& c, RenderingMode r) const;
 	
 	void render_to_buffer(const Scene& s, const Camera& c, RenderingMode r, bool t) const;
@@ -367,7 +606,31 @@ private:
 	
 	static void init_cube();
 	
-	static void sort_instances(const Camera& c, std::vector<const Instance*>& l, bool t);
+	const gpu::Texture* get_image_texture(const Image* i) const;
+	
+	void cancel_image_upload(const Image* i);
+	
+	void batch_instances(bool s) const;
+	
+	size_t get_config_id(const Defines& d) const;
+	
+	void sweep_compiled_materials() const;
+	
+	const CompiledMaterial* compile_material(const Material& m, const Defines& d, size_t c) const;
+	
+	const gpu::Shader* compile_instancing(const Material& m, const Defines& d, size_t c) const;
+	
+	const CompiledMaterial* compile_shadow(const Material& m, const Defines& d, size_t c) const;
+	
+	const gpu::Shader* compile_shadow_instancing(const Material& m, const Defines& d, size_t c) const;
+	
+	static void set_material_samplers(const gpu::Shader& shader);
+	
+	static int select_lod(const Instance& i, const Camera& c, float b);
+	
+	int cull_meshlets(const gpu::VertexObject& v, const Mat4& m, const Mat3& n, const Camera& c, const Frustum& f, bool b) const;
+	
+	static void set_material_uniforms(const Material& m, const gpu::Shader& shader);
 };
 
 }
@@ -0,0 +1,705 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "AABBTree.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace ink {
+
+constexpr float FAT_RATIO = .1f;
+
+constexpr float FAT_MARGIN = .01f;
+
+constexpr int MAX_REINSERTIONS = 64;
+
+constexpr float REBUILD_RATIO = .25f;
+
+constexpr float REBUILD_COST_RATIO = 1.5f;
+
+constexpr int MORTON_BITS = 10;
+
+static Vec3 min_vec3(const Vec3& a, const Vec3& b) {
+	return {std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+}
+
+static Vec3 max_vec3(const Vec3& a, const Vec3& b) {
+	return {std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+}
+
+static bool contains(const Vec3& l1, const Vec3& u1, const Vec3& l2, const Vec3& u2) {
+	return l1.x <= l2.x && l1.y <= l2.y && l1.z <= l2.z &&
+		   u1.x >= u2.x && u1.y >= u2.y && u1.z >= u2.z;
+}
+
+static uint32_t spread_bits(uint32_t v) {
+	v = (v | v << 16) & 0x030000FF;
+	v = (v | v <<  8) & 0x0300F00F;
+	v = (v | v <<  4) & 0x030C30C3;
+	v = (v | v <<  2) & 0x09249249;
+	return v;
+}
+
+static bool overlaps(const Vec3& l1, const Vec3& u1, const Vec3& l2, const Vec3& u2) {
+	return l1.x <= u2.x && l1.y <= u2.y && l1.z <= u2.z &&
+		   u1.x >= l2.x && u1.y >= l2.y && u1.z >= l2.z;
+}
+
+bool AABBTree::Node::is_leaf() const {
+	return left == -1;
+}
+
+int AABBTree::insert(const Instance* i) {
+	int leaf = allocate_node();
+	nodes[leaf].instance = i;
+	nodes[leaf].pending = true;
+	set_fat_box(leaf);
+	inserted_leaves.emplace_back(leaf);
+	++leaf_count;
+	return leaf;
+}
+
+void AABBTree::remove(int n) {
+	if (!nodes[n].pending) remove_leaf(n);
+	nodes[n].pending = false;
+	nodes[n].moved = false;
+	free_node(n);
+	--leaf_count;
+}
+
+bool AABBTree::move(int n) {
+	/* the leaf still contains the box */
+	auto* instance = nodes[n].instance;
+	if (contains(nodes[n].lower, nodes[n].upper, instance->bound_min, instance->bound_max)) return false;
+	
+	/* reinsert the leaf later if it leaves the old box entirely */
+	auto& node = nodes[n];
+	bool far = !overlaps(node.lower, node.upper, instance->bound_min, instance->bound_max);
+	set_fat_box(n);
+	if (node.pending || node.moved) return true;
+	node.moved = true;
+	if (far && far_leaves.size() < MAX_REINSERTIONS) {
+		far_leaves.emplace_back(n);
+	} else {
+		moved_leaves.emplace_back(n);
+	}
+	return true;
+}
+
+void AABBTree::set_visible(int n, bool v) {
+	nodes[n].visible = v;
+}
+
+void AABBTree::set_all_visible(bool v) {
+	for (auto& node : nodes) {
+		if (node.height == 0) node.visible = v;
+	}
+}
+
+void AABBTree::refit() {
+	size_t move_count = moved_leaves.size() + far_leaves.size();
+	if (inserted_leaves.empty() && move_count == 0) return;
+	
+	/* rebuild the tree if too many leaves are inserted */
+	if (inserted_leaves.size() > leaf_count * REBUILD_RATIO) return rebuild();
+	
+	/* link the inserted leaves */
+	for (int leaf : inserted_leaves) {
+		if (!nodes[leaf].pending) continue;
+		nodes[leaf].pending = false;
+		insert_leaf(leaf);
+	}
+	inserted_leaves.clear();
+	
+	/* refit all the nodes at once if too many leaves are moved */
+	if (move_count > leaf_count * REBUILD_RATIO) {
+		moved_leaves.clear();
+		far_leaves.clear();
+		return refit_all();
+	}
+	
+	/* reinsert the leaves moved far away */
+	for (int leaf : far_leaves) {
+		if (!nodes[leaf].moved) continue;
+		nodes[leaf].moved = false;
+		remove_leaf(leaf);
+		insert_leaf(leaf);
+	}
+	far_leaves.clear();
+	
+	/* collect the ancestors of the moved leaves by height */
+	for (int leaf : moved_leaves) {
+		if (!nodes[leaf].moved) continue;
+		nodes[leaf].moved = false;
+		int index = nodes[leaf].parent;
+		while (index != -1 && !nodes[index].refitted) {
+			auto& node = nodes[index];
+			node.refitted = true;
+			if (refit_levels.size() <= node.height) refit_levels.resize(node.height + 1);
+			refit_levels[node.height].emplace_back(index);
+			index = node.parent;
+		}
+	}
+	moved_leaves.clear();
+	
+	/* refit the ancestors from the bottom, each one only once */
+	for (auto& level : refit_levels) {
+		for (int index : level) {
+			auto& node = nodes[index];
+			auto& left = nodes[node.left];
+			auto& right = nodes[node.right];
+			node.lower = min_vec3(left.lower, right.lower);
+			node.upper = max_vec3(left.upper, right.upper);
+			node.refitted = false;
+		}
+		level.clear();
+	}
+}
+
+void AABBTree::rebuild() {
+	inserted_leaves.clear();
+	moved_leaves.clear();
+	far_leaves.clear();
+	
+	/* collect the boxes of leaves and free the other nodes */
+	auto& leaves = build_leaves;
+	leaves.clear();
+	free_list = -1;
+	root = -1;
+	for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; --i) {
+		auto& node = nodes[i];
+		if (node.height != 0) {
+			free_node(i);
+			continue;
+		}
+		node.pending = false;
+		node.moved = false;
+		leaves.push_back({node.lower, node.upper, i});
+	}
+	if (leaves.empty()) return;
+	
+	/* calculate the Morton codes of the centers of leaves */
+	Vec3 lower = leaves[0].lower + leaves[0].upper;
+	Vec3 upper = lower;
+	for (auto& leaf : leaves) {
+		Vec3 center = leaf.lower + leaf.upper;
+		lower = min_vec3(lower, center);
+		upper = max_vec3(upper, center);
+	}
+	uint32_t mask = (1u << MORTON_BITS) - 1;
+	float max_code = static_cast<float>(mask);
+	Vec3 size = upper - lower;
+	Vec3 factor = {
+		size.x > 0 ? max_code / size.x : 0,
+		size.y > 0 ? max_code / size.y : 0,
+		size.z > 0 ? max_code / size.z : 0,
+	};
+	size_t count = leaves.size();
+	std::vector<uint32_t> codes(count);
+	for (int i = 0; i < count; ++i) {
+		Vec3 center = leaves[i].lower + leaves[i].upper;
+		uint32_t x = static_cast<uint32_t>((center.x - lower.x) * factor.x);
+		uint32_t y = static_cast<uint32_t>((center.y - lower.y) * factor.y);
+		uint32_t z = static_cast<uint32_t>((center.z - lower.z) * factor.z);
+		codes[i] = spread_bits(x) << 2 | spread_bits(y) << 1 | spread_bits(z);
+	}
+	
+	/* sort the order of leaves by the codes with radix sort */
+	auto& order = build_order;
+	order.resize(count);
+	for (int i = 0; i < count; ++i) {
+		order[i] = i;
+	}
+	std::vector<uint32_t> sorted_codes(count);
+	std::vector<int> sorted_order(count);
+	std::vector<int> offsets((1 << MORTON_BITS) + 1);
+	for (int shift = 0; shift < MORTON_BITS * 3; shift += MORTON_BITS) {
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (uint32_t code : codes) {
+			++offsets[(code >> shift & mask) + 1];
+		}
+		for (int i = 1; i < offsets.size(); ++i) {
+			offsets[i] += offsets[i - 1];
+		}
+		for (int i = 0; i < count; ++i) {
+			int offset = offsets[codes[i] >> shift & mask]++;
+			sorted_codes[offset] = codes[i];
+			sorted_order[offset] = order[i];
+		}
+		codes.swap(sorted_codes);
+		order.swap(sorted_order);
+	}
+	
+	/* build the tree top-down by splitting the codes */
+	root = build(codes, 0, static_cast<int>(count) - 1);
+	nodes[root].parent = -1;
+	
+	/* link the leaves to their parents in the order of nodes */
+	if (count > 1) {
+		for (auto& leaf : leaves) nodes[leaf.index].parent = leaf.parent;
+	}
+	rebuild_cost = get_cost();
+	sorted = true;
+}
+
+void AABBTree::clear() {
+	inserted_leaves.clear();
+	moved_leaves.clear();
+	far_leaves.clear();
+	root = -1;
+	free_list = -1;
+	leaf_count = 0;
+	sorted = false;
+	nodes.clear();
+}
+
+size_t AABBTree::get_leaf_count() const {
+	return leaf_count;
+}
+
+const Instance* AABBTree::get_instance(int n) const {
+	if (n < 0 || n >= nodes.size() || nodes[n].height != 0) return nullptr;
+	return nodes[n].instance;
+}
+
+int AABBTree::get_height() const {
+	return root == -1 ? 0 : nodes[root].height + 1;
+}
+
+void AABBTree::get_instances(std::vector<const Instance*>& o) const {
+	for (auto& node : nodes) {
+		if (node.height == 0) o.emplace_back(node.instance);
+	}
+}
+
+void AABBTree::query_box(const Vec3& l, const Vec3& u, std::vector<const Instance*>& o) const {
+	if (root == -1) return;
+	std::vector<int> stack = {root};
+	while (!stack.empty()) {
+		auto& node = nodes[stack.back()];
+		stack.pop_back();
+		auto& lower = node.is_leaf() ? node.instance->bound_min : node.lower;
+		auto& upper = node.is_leaf() ? node.instance->bound_max : node.upper;
+		if (!overlaps(lower, upper, l, u)) continue;
+		if (node.is_leaf()) {
+			o.emplace_back(node.instance);
+		} else {
+			stack.emplace_back(node.left);
+			stack.emplace_back(node.right);
+		}
+	}
+}
+
+void AABBTree::query_sphere(const Vec3& c, float r, std::vector<const Instance*>& o) const {
+	if (root == -1) return;
+	std::vector<int> stack = {root};
+	while (!stack.empty()) {
+		auto& node = nodes[stack.back()];
+		stack.pop_back();
+		auto& lower = node.is_leaf() ? node.instance->bound_min : node.lower;
+		auto& upper = node.is_leaf() ? node.instance->bound_max : node.upper;
+		Vec3 d = c - max_vec3(lower, min_vec3(c, upper));
+		if (d.dot(d) > r * r) continue;
+		if (node.is_leaf()) {
+			o.emplace_back(node.instance);
+		} else {
+			stack.emplace_back(node.left);
+			stack.emplace_back(node.right);
+		}
+	}
+}
+
+void AABBTree::query_frustum(const Frustum& f, std::vector<const Instance*>& o, bool v) const {
+	if (root == -1) return;
+	std::vector<int> stack = {root};
+	std::vector<const Instance*> leaves;
+	while (!stack.empty()) {
+		int index = stack.back();
+		auto& node = nodes[index];
+		stack.pop_back();
+		
+		/* test the leaves later in batch */
+		if (node.is_leaf()) {
+			if (!v || node.visible) leaves.emplace_back(node.instance);
+			continue;
+		}
+		
+		/* test the box against each plane of frustum */
+		auto& lower = node.lower;
+		auto& upper = node.upper;
+		Vec3 c = (lower + upper) * .5f;
+		Vec3 e = (upper - lower) * .5f;
+		bool outside = false;
+		bool inside = true;
+		for (auto& p : f.planes) {
+			float d = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+			float r = fabsf(p.x) * e.x + fabsf(p.y) * e.y + fabsf(p.z) * e.z;
+			if (d + r < 0) {
+				outside = true;
+				break;
+			}
+			if (d - r < 0) inside = false;
+		}
+		if (outside) continue;
+		
+		/* accept the subtree inside the frustum */
+		if (inside) {
+			append_leaves(index, v, stack, o);
+		} else {
+			stack.emplace_back(node.left);
+			stack.emplace_back(node.right);
+		}
+	}
+	
+	/* test the boxes of the remaining leaves in batch */
+	cull_instances(f, leaves, o);
+}
+
+void AABBTree::query_ray(const Ray& r, std::vector<const Instance*>& o) const {
+	if (root == -1) return;
+	std::vector<int> stack = {root};
+	while (!stack.empty()) {
+		auto& node = nodes[stack.back()];
+		stack.pop_back();
+		auto& lower = node.is_leaf() ? node.instance->bound_min : node.lower;
+		auto& upper = node.is_leaf() ? node.instance->bound_max : node.upper;
+		if (r.intersect_box(lower, upper) < 0) continue;
+		if (node.is_leaf()) {
+			o.emplace_back(node.instance);
+		} else {
+			stack.emplace_back(node.left);
+			stack.emplace_back(node.right);
+		}
+	}
+}
+
+void AABBTree::cull_instances(const Frustum& f, const std::vector<const Instance*>& i, std::vector<const Instance*>& o) {
+	/* store the centers and half extents of boxes in SoA layout */
+	size_t size = i.size();
+	std::vector<float> boxes(size * 6);
+	std::vector<uint8_t> results(size);
+	for (int k = 0; k < size; ++k) {
+		Vec3 lower;
+		Vec3 upper;
+		i[k]->get_bounds(lower, upper);
+		Vec3 center = (upper + lower) * .5f;
+		Vec3 extent = (upper - lower) * .5f;
+		boxes[k           ] = center.x;
+		boxes[k + size    ] = center.y;
+		boxes[k + size * 2] = center.z;
+		boxes[k + size * 3] = extent.x;
+		boxes[k + size * 4] = extent.y;
+		boxes[k + size * 5] = extent.z;
+	}
+	
+	/* keep the instances intersecting the frustum */
+	f.intersects_boxes(boxes.data(), size, results.data());
+	for (int k = 0; k < size; ++k) {
+		if (results[k] != 0) o.emplace_back(i[k]);
+	}
+}
+
+int AABBTree::allocate_node() {
+	if (free_list == -1) {
+		nodes.emplace_back();
+		return static_cast<int>(nodes.size()) - 1;
+	}
+	int node = free_list;
+	free_list = nodes[node].parent;
+	nodes[node] = Node();
+	return node;
+}
+
+void AABBTree::free_node(int n) {
+	nodes[n].parent = free_list;
+	nodes[n].height = -1;
+	free_list = n;
+}
+
+void AABBTree::insert_leaf(int n) {
+	sorted = false;
+	if (root == -1) {
+		root = n;
+		nodes[n].parent = -1;
+		return;
+	}
+	
+	/* find the best sibling by the cost of surface area */
+	Vec3 leaf_lower = nodes[n].lower;
+	Vec3 leaf_upper = nodes[n].upper;
+	int index = root;
+	while (!nodes[index].is_leaf()) {
+		auto& node = nodes[index];
+		float area = get_area(node.lower, node.upper);
+		float combined_area = get_area(min_vec3(node.lower, leaf_lower), max_vec3(node.upper, leaf_upper));
+		
+		/* cost of creating a new parent for this node and the leaf */
+		float cost = 2 * combined_area;
+		
+		/* minimum cost of pushing the leaf further down the tree */
+		float inheritance_cost = 2 * (combined_area - area);
+		
+		/* cost of descending into each child */
+		float child_costs[2];
+		int children[] = {node.left, node.right};
+		for (int i = 0; i < 2; ++i) {
+			auto& child = nodes[children[i]];
+			Vec3 lower = min_vec3(child.lower, leaf_lower);
+			Vec3 upper = max_vec3(child.upper, leaf_upper);
+			float child_area = get_area(lower, upper);
+			if (!child.is_leaf()) child_area -= get_area(child.lower, child.upper);
+			child_costs[i] = child_area + inheritance_cost;
+		}
+		
+		/* descend according to the minimum cost */
+		if (cost < child_costs[0] && cost < child_costs[1]) break;
+		index = child_costs[0] < child_costs[1] ? node.left : node.right;
+	}
+	
+	/* create a new parent for the sibling and the leaf */
+	int sibling = index;
+	int old_parent = nodes[sibling].parent;
+	int new_parent = allocate_node();
+	nodes[new_parent].parent = old_parent;
+	nodes[new_parent].lower = min_vec3(nodes[sibling].lower, leaf_lower);
+	nodes[new_parent].upper = max_vec3(nodes[sibling].upper, leaf_upper);
+	nodes[new_parent].height = nodes[sibling].height + 1;
+	nodes[new_parent].left = sibling;
+	nodes[new_parent].right = n;
+	nodes[sibling].parent = new_parent;
+	nodes[n].parent = new_parent;
+	if (old_parent == -1) {
+		root = new_parent;
+	} else if (nodes[old_parent].left == sibling) {
+		nodes[old_parent].left = new_parent;
+	} else {
+		nodes[old_parent].right = new_parent;
+	}
+	
+	/* refit the ancestors of the leaf */
+	update_ancestors(nodes[n].parent);
+}
+
+void AABBTree::remove_leaf(int n) {
+	sorted = false;
+	if (n == root) {
+		root = -1;
+		return;
+	}
+	
+	/* replace the parent of leaf with its sibling */
+	int parent = nodes[n].parent;
+	int grand_parent = nodes[parent].parent;
+	int sibling = nodes[parent].left == n ? nodes[parent].right : nodes[parent].left;
+	if (grand_parent == -1) {
+		root = sibling;
+		nodes[sibling].parent = -1;
+		free_node(parent);
+		return;
+	}
+	if (nodes[grand_parent].left == parent) {
+		nodes[grand_parent].left = sibling;
+	} else {
+		nodes[grand_parent].right = sibling;
+	}
+	nodes[sibling].parent = grand_parent;
+	free_node(parent);
+	
+	/* refit the ancestors of the leaf */
+	update_ancestors(grand_parent);
+}
+
+void AABBTree::refit_all() {
+	/* rebuild the tree instead if the nodes are changed since the last rebuild */
+	if (!sorted) return rebuild();
+	
+	/* the rebuild allocates the children before their parents, so refit in order */
+	float area = 0;
+	for (auto& node : nodes) {
+		if (node.height == 0) node.moved = false;
+		if (node.height <= 0) continue;
+		auto& left = nodes[node.left];
+		auto& right = nodes[node.right];
+		node.lower = min_vec3(left.lower, right.lower);
+		node.upper = max_vec3(left.upper, right.upper);
+		area += get_area(node.lower, node.upper);
+	}
+	
+	/* rebuild the tree if the refitted nodes overlap too much */
+	if (root == -1 || nodes[root].is_leaf()) return;
+	float cost = area / get_area(nodes[root].lower, nodes[root].upper) / leaf_count;
+	if (cost > rebuild_cost * REBUILD_COST_RATIO) rebuild();
+}
+
+void AABBTree::update_ancestors(int n) {
+	while (n != -1) {
+		n = balance(n);
+		auto& node = nodes[n];
+		auto& left = nodes[node.left];
+		auto& right = nodes[node.right];
+		node.height = 1 + std::max(left.height, right.height);
+		node.lower = min_vec3(left.lower, right.lower);
+		node.upper = max_vec3(left.upper, right.upper);
+		n = node.parent;
+	}
+}
+
+int AABBTree::balance(int n) {
+	/* rotate the higher child up if the node is unbalanced */
+	auto& a = nodes[n];
+	if (a.is_leaf() || a.height < 2) return n;
+	int b_index = a.left;
+	int c_index = a.right;
+	int height_diff = nodes[c_index].height - nodes[b_index].height;
+	if (height_diff >= -1 && height_diff <= 1) return n;
+	
+	/* the higher child becomes the parent */
+	int up_index = height_diff > 0 ? c_index : b_index;
+	int down_index = height_diff > 0 ? b_index : c_index;
+	auto& up = nodes[up_index];
+	int f_index = up.left;
+	int g_index = up.right;
+	
+	/* swap the node and the higher child */
+	up.left = n;
+	up.parent = a.parent;
+	a.parent = up_index;
+	if (up.parent == -1) {
+		root = up_index;
+	} else if (nodes[up.parent].left == n) {
+		nodes[up.parent].left = up_index;
+	} else {
+		nodes[up.parent].right = up_index;
+	}
+	
+	/* keep the higher grandchild under the child */
+	auto& f = nodes[f_index];
+	auto& g = nodes[g_index];
+	int keep_index = f.height > g.height ? f_index : g_index;
+	int move_index = f.height > g.height ? g_index : f_index;
+	up.right = keep_index;
+	if (height_diff > 0) {
+		a.right = move_index;
+	} else {
+		a.left = move_index;
+	}
+	nodes[move_index].parent = n;
+	
+	/* refit the node and the child */
+	auto& down = nodes[down_index];
+	auto& moved = nodes[move_index];
+	a.lower = min_vec3(down.lower, moved.lower);
+	a.upper = max_vec3(down.upper, moved.upper);
+	a.height = 1 + std::max(down.height, moved.height);
+	auto& kept = nodes[keep_index];
+	up.lower = min_vec3(a.lower, kept.lower);
+	up.upper = max_vec3(a.upper, kept.upper);
+	up.height = 1 + std::max(a.height, kept.height);
+	return up_index;
+}
+
+int AABBTree::build(const std::vector<uint32_t>& c, int f, int e) {
+	if (f == e) return build_leaves[build_order[f]].index;
+	
+	/* split at the highest different bit, or at the middle if all equal */
+	int split = (f + e) / 2;
+	uint32_t diff = c[f] ^ c[e];
+	if (diff != 0) {
+		uint32_t bit = 1u << (31 - std::countl_zero(diff));
+		auto begin = c.begin() + f;
+		auto end = c.begin() + e + 1;
+		split = f + static_cast<int>(std::partition_point(begin, end, [&](uint32_t x) -> bool {
+			return (x & bit) == 0;
+		}) - begin) - 1;
+	}
+	
+	/* create the parent after the children are built */
+	int left = build(c, f, split);
+	int right = build(c, split + 1, e);
+	int index = allocate_node();
+	auto& node = nodes[index];
+	node.left = left;
+	node.right = right;
+	
+	/* read the boxes of leaves from the sorted list, and link them later */
+	auto& left_leaf = build_leaves[build_order[f]];
+	auto& right_leaf = build_leaves[build_order[e]];
+	if (f == split) {
+		left_leaf.parent = index;
+	} else {
+		nodes[left].parent = index;
+	}
+	if (split + 1 == e) {
+		right_leaf.parent = index;
+	} else {
+		nodes[right].parent = index;
+	}
+	auto& left_lower = f == split ? left_leaf.lower : nodes[left].lower;
+	auto& left_upper = f == split ? left_leaf.upper : nodes[left].upper;
+	auto& right_lower = split + 1 == e ? right_leaf.lower : nodes[right].lower;
+	auto& right_upper = split + 1 == e ? right_leaf.upper : nodes[right].upper;
+	node.lower = min_vec3(left_lower, right_lower);
+	node.upper = max_vec3(left_upper, right_upper);
+	node.height = 1 + std::max(f == split ? 0 : nodes[left].height, split + 1 == e ? 0 : nodes[right].height);
+	return index;
+}
+
+void AABBTree::append_leaves(int n, bool v, std::vector<int>& s, std::vector<const Instance*>& o) const {
+	size_t base = s.size();
+	s.emplace_back(n);
+	while (s.size() > base) {
+		auto& node = nodes[s.back()];
+		s.pop_back();
+		if (node.is_leaf()) {
+			if (!v || node.visible) o.emplace_back(node.instance);
+		} else {
+			s.emplace_back(node.left);
+			s.emplace_back(node.right);
+		}
+	}
+}
+
+void AABBTree::set_fat_box(int n) {
+	/* enlarge the box of leaf by the fat margin */
+	auto* instance = nodes[n].instance;
+	Vec3 margin = (instance->bound_max - instance->bound_min) * FAT_RATIO + FAT_MARGIN;
+	nodes[n].lower = instance->bound_min - margin;
+	nodes[n].upper = instance->bound_max + margin;
+}
+
+float AABBTree::get_cost() const {
+	/* the surface area of the nodes relative to the root, per leaf */
+	if (root == -1 || nodes[root].is_leaf()) return 0;
+	float area = 0;
+	for (auto& node : nodes) {
+		if (node.height > 0) area += get_area(node.lower, node.upper);
+	}
+	return area / get_area(nodes[root].lower, nodes[root].upper) / leaf_count;
+}
+
+float AABBTree::get_area(const Vec3& l, const Vec3& u) {
+	Vec3 d = u - l;
+	return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+}
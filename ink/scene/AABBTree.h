@@ -0,0 +1,259 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "../math/Frustum.h"
+#include "../math/Ray.h"
+#include "../objects/Instance.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ink {
+
+class AABBTree {
+public:
+	/**
+	 * Creates a new AABBTree object.
+	 */
+	AABBTree() = default;
+	
+	/**
+	 * Inserts a leaf with the bounding box of the specified instance into the
+	 * tree. The box is enlarged so that small movements need no reinsertion,
+	 * while the queries still test the exact box of instance at leaves. The
+	 * leaf is linked into the tree by the next refit. Returns the index of the
+	 * leaf.
+	 *
+	 * \param i instance
+	 */
+	int insert(const Instance* i);
+	
+	/**
+	 * Removes the specified leaf from the tree.
+	 *
+	 * \param n the index of the leaf
+	 */
+	void remove(int n);
+	
+	/**
+	 * Updates the specified leaf to the current bounding box of its instance.
+	 * Nothing is changed if the box is still inside the enlarged box of the
+	 * leaf, otherwise the leaf is enlarged again and its ancestors are fixed
+	 * by the next refit. Returns true if the leaf is enlarged.
+	 *
+	 * \param n the index of the leaf
+	 */
+	bool move(int n);
+	
+	/**
+	 * Sets whether the specified leaf is visible. The frustum queries of
+	 * visible leaves skip the hidden ones. The leaves are visible when they
+	 * are inserted.
+	 *
+	 * \param n the index of the leaf
+	 * \param v visible
+	 */
+	void set_visible(int n, bool v);
+	
+	/**
+	 * Sets whether all the leaves in the tree are visible.
+	 *
+	 * \param v visible
+	 */
+	void set_all_visible(bool v);
+	
+	/**
+	 * Links the inserted leaves and refits the ancestors of the moved leaves
+	 * bottom-up, visiting each node once. A limited number of leaves moved
+	 * away from their old boxes are reinserted to keep the tree tight. If a
+	 * large fraction of the leaves are moved, all the nodes are refitted in
+	 * one pass over the nodes in the order of the last rebuild, and the tree
+	 * is only rebuilt when the nodes grow much larger than after the last
+	 * rebuild, or when leaves are linked or unlinked since then. The whole
+	 * tree is rebuilt if a large fraction of the leaves are inserted. This
+	 * should be called after changing leaves and before queries.
+	 */
+	void refit();
+	
+	/**
+	 * Rebuilds the tree from all the leaves by sorting them along a Morton
+	 * curve. The indices of the leaves are kept.
+	 */
+	void rebuild();
+	
+	/**
+	 * Removes all the leaves from the tree.
+	 */
+	void clear();
+	
+	/**
+	 * Returns the number of leaves in the tree.
+	 */
+	size_t get_leaf_count() const;
+	
+	/**
+	 * Returns the instance of the specified leaf, or nullptr if the node is
+	 * not a leaf.
+	 *
+	 * \param n the index of the leaf
+	 */
+	const Instance* get_instance(int n) const;
+	
+	/**
+	 * Returns the height of the tree, which is 0 if the tree is empty.
+	 */
+	int get_height() const;
+	
+	/**
+	 * Appends the instances of all the leaves to the list.
+	 *
+	 * \param o the output instance list
+	 */
+	void get_instances(std::vector<const Instance*>& o) const;
+	
+	/**
+	 * Appends the instances whose boxes intersect the specified box to the
+	 * list.
+	 *
+	 * \param l the lower boundary of the box
+	 * \param u the upper boundary of the box
+	 * \param o the output instance list
+	 */
+	void query_box(const Vec3& l, const Vec3& u, std::vector<const Instance*>& o) const;
+	
+	/**
+	 * Appends the instances whose boxes intersect the specified sphere to the
+	 * list.
+	 *
+	 * \param c the center of the sphere
+	 * \param r the radius of the sphere
+	 * \param o the output instance list
+	 */
+	void query_sphere(const Vec3& c, float r, std::vector<const Instance*>& o) const;
+	
+	/**
+	 * Appends the instances whose boxes intersect the specified frustum to the
+	 * list. The subtrees inside the frustum are accepted without more tests,
+	 * and the leaves of the other visited subtrees are tested in batch.
+	 *
+	 * \param f frustum
+	 * \param o the output instance list
+	 * \param v whether to append only the visible leaves
+	 */
+	void query_frustum(const Frustum& f, std::vector<const Instance*>& o, bool v = false) const;
+	
+	/**
+	 * Appends the instances whose boxes intersect the specified ray to the
+	 * list.
+	 *
+	 * \param r ray
+	 * \param o the output instance list
+	 */
+	void query_ray(const Ray& r, std::vector<const Instance*>& o) const;
+	
+	/**
+	 * Appends the instances whose bounding boxes intersect the specified
+	 * frustum to the list. The boxes are tested in batch with SIMD.
+	 *
+	 * \param f frustum
+	 * \param i the input instance list
+	 * \param o the output instance list
+	 */
+	static void cull_instances(const Frustum& f, const std::vector<const Instance*>& i, std::vector<const Instance*>& o);
+	
+private:
+	class Node {
+	public:
+		Vec3 lower;
+		Vec3 upper;
+		int parent = -1;
+		int left = -1;
+		int right = -1;
+		int height = 0;
+		bool pending = false;
+		bool moved = false;
+		bool refitted = false;
+		bool visible = true;
+		const Instance* instance = nullptr;
+		
+		bool is_leaf() const;
+	};
+	
+	class BuildLeaf {
+	public:
+		Vec3 lower;
+		Vec3 upper;
+		int index = -1;
+		int parent = -1;
+	};
+	
+	int root = -1;
+	int free_list = -1;
+	
+	size_t leaf_count = 0;
+	
+	float rebuild_cost = 0;
+	
+	bool sorted = false;
+	
+	std::vector<Node> nodes;
+	
+	std::vector<int> inserted_leaves;
+	
+	std::vector<int> moved_leaves;
+	
+	std::vector<int> far_leaves;
+	
+	std::vector<std::vector<int>> refit_levels;
+	
+	std::vector<BuildLeaf> build_leaves;
+	
+	std::vector<int> build_order;
+	
+	int allocate_node();
+	
+	void free_node(int n);
+	
+	void insert_leaf(int n);
+	
+	void remove_leaf(int n);
+	
+	void refit_all();
+	
+	void update_ancestors(int n);
+	
+	int balance(int n);
+	
+	int build(const std::vector<uint32_t>& c, int f, int e);
+	
+	void append_leaves(int n, bool v, std::vector<int>& s, std::vector<const Instance*>& o) const;
+	
+	void set_fat_box(int n);
+	
+	float get_cost() const;
+	
+	static float get_area(const Vec3& l, const Vec3& u);
+};
+
+}
@@ -22,11 +22,34 @@
 
 #include "Scene.h"
 
+#include "../core/WorkerPool.h"
+
+#include <algorithm>
 #include <format>
 
 namespace ink {
 
-Scene::Scene(const std::string& n) : Instance(n) {}
+constexpr size_t PARALLEL_UPDATE_THRESHOLD = 4096;
+
+size_t Scene::binding_versions = 0;
+
+Scene::Scene(const std::string& n) : Instance(n) {
+	clear_bindings();
+}
+
+Scene::~Scene() {
+	/* the deleted instances have removed their leaves from the tree */
+	std::vector<const Instance*> instances;
+	instance_tree.get_instances(instances);
+	for (auto* instance : instances) {
+		if (tree_leaves.count(instance) != 0) continue;
+		
+		/* the leaves out of the map are kept in the instances */
+		auto* owned_instance = const_cast<Instance*>(instance);
+		owned_instance->tree_scene = nullptr;
+		owned_instance->tree_leaf = -1;
+	}
+}
 
 Material* Scene::get_material(const std::string& n) const {
 	if (material_library.count(n) == 0) {
@@ -51,35 +74,68 @@ Material* Scene::get_material(const std::string& n, const Instance& s) const {
 	return material_library.at(name);
 }
 
+Material* Scene::get_material(const Instance& s, int g) const {
+	/* return the material if the instance is bound by this scene */
+	auto& bindings = s.material_bindings;
+	if (s.binding_scene == this && s.binding_version == binding_version &&
+		s.binding_mesh == s.mesh && bindings.size() == s.mesh->groups.size()) {
+		return bindings[g];
+	}
+	
+	/* resolve the materials of all groups in the instance */
+	bindings.clear();
+	for (auto& group : s.mesh->groups) {
+		auto* material = get_material(group.name, s);
+		if (material == nullptr) {
+			material = get_material(group.name, *s.mesh);
+		}
+		if (material == nullptr) {
+			material = get_material(group.name);
+		}
+		bindings.emplace_back(material);
+	}
+	s.binding_scene = this;
+	s.binding_mesh = s.mesh;
+	s.binding_version = binding_version;
+	return bindings[g];
+}
+
 void Scene::set_material(const std::string& n, Material* m) {
+	clear_bindings(n);
 	material_library.insert_or_assign(n, m);
 }
 
 void Scene::set_material(const std::string& n, const Mesh& s, Material* m) {
+	clear_bindings(n);
 	auto name = std::format("M{}#{}", reinterpret_cast<size_t>(&s), n);
 	material_library.insert_or_assign(name, m);
 }
 
 void Scene::set_material(const std::string& n, const Instance& s, Material* m) {
+	clear_bindings(n);
 	auto name = std::format("I{}#{}", reinterpret_cast<size_t>(&s), n);
 	material_library.insert_or_assign(name, m);
 }
 
 void Scene::remove_material(const std::string& n) {
+	clear_bindings(n);
 	material_library.erase(n);
 }
 
 void Scene::remove_material(const std::string& n, const Mesh& s) {
+	clear_bindings(n);
 	auto name = std::format("M{}#{}", reinterpret_cast<size_t>(&s), n);
 	material_library.erase(name);
 }
 
 void Scene::remove_material(const std::string& n, const Instance& s) {
+	clear_bindings(n);
 	auto name = std::format("I{}#{}", reinterpret_cast<size_t>(&s), n);
 	material_library.erase(name);
 }
 
 void Scene::clear_materials() {
+	clear_bindings();
 	material_library.clear();
 }
 
@@ -180,22 +236,114 @@ void Scene::clear_lights() {
 	hemisphere_lights.clear();
 }
 
+bool Scene::get_flat_transforms() const {
+	return flat_transforms;
+}
+
+void Scene::set_flat_transforms(bool f) {
+	if (flat_transforms == f) return;
+	flat_transforms = f;
+	forced_update = true;
+	transform_system.clear();
+}
+
 void Scene::update_instances() {
-	std::vector<Instance*> unvisited;
-	matrix_local = transform();
-	matrix_global = matrix_local;
-	unvisited.emplace_back(this);
-	while (!unvisited.empty()) {
-		Instance* current = unvisited.back();
-		unvisited.pop_back();
-		size_t count = current->get_child_count();
-		for (int i = 0; i < count; ++i) {
-			Instance* child = current->get_child(i);
-			child->matrix_local = child->transform();
-			child->matrix_global = current->matrix_global * child->matrix_local;
-			unvisited.emplace_back(child);
+	/* check whether some instances are shared if the hierarchies are changed */
+	bool was_shared = shared_hierarchies;
+	if (forced_update || sharing_dirty) shared_hierarchies = has_shared_instances();
+	bool forced = forced_update || shared_hierarchies != was_shared;
+	bool hierarchy_changed = hierarchy_dirty;
+	forced_update = false;
+	hierarchy_dirty = false;
+	sharing_dirty = false;
+	
+	/* update the transforms by flattened arrays or pointer hierarchies */
+	changed_instances.clear();
+	if (flat_transforms && !shared_hierarchies) {
+		update_transforms(forced || hierarchy_changed);
+	} else {
+		transform_system.clear();
+		update_hierarchies(forced || shared_hierarchies);
+	}
+	
+	/* visit all the instances if the added subtrees share instances */
+	bool shared_added = hierarchy_changed && std::any_of(changed_instances.begin(), changed_instances.end(), [](const Instance* i) -> bool {
+		return i->shared;
+	});
+	if (!shared_hierarchies && shared_added) {
+		shared_hierarchies = true;
+		changed_instances.clear();
+		transform_system.clear();
+		update_hierarchies(true);
+	}
+	
+	/* rebuild the tree from all the instances if forced or shared */
+	bool rebuilt = forced || shared_hierarchies;
+	if (rebuilt) {
+		instance_tree.clear();
+		tree_leaves.clear();
+		group_leaves.clear();
+	}
+	
+	/* look up the padding of displacement only if some material displaces */
+	bool displaced = std::any_of(material_library.begin(), material_library.end(), [](const auto& m) -> bool {
+		return m.second != nullptr && m.second->displacement_map != nullptr;
+	});
+	
+	/* refit the leaves of the changed instances */
+	for (auto* instance : changed_instances) {
+		if (rebuilt && instance->tree_scene == this) {
+			instance->tree_scene = nullptr;
+			instance->tree_leaf = -1;
+		}
+		int leaf = find_leaf(*instance);
+		
+		/* resolve the materials of new leaves again, which may be changed */
+		if (leaf == -1 && instance->binding_scene == this) instance->binding_scene = nullptr;
+		instance->bindings_dirty = false;
+		
+		/* inflate the bounds by the displacement of materials */
+		float padding = displaced ? get_displacement_padding(*instance) : 0;
+		
+		/* the bounds of meshes are only created serially */
+		if (instance->bounds_dirty || instance->bound_padding != padding) {
+			instance->bound_padding = padding;
+			instance->update_bounds();
+			instance->bounds_dirty = false;
+		}
+		
+		/* rebuild the visible list if visibility is changed */
+		if (instance->visible != instance->cached_visible) {
+			instance->cached_visible = instance->visible;
+			visible_dirty = true;
+		}
+		
+		/* insert, refit or remove the leaf of instance */
+		if (instance->mesh == nullptr) {
+			/* the visible list only keeps the instances with mesh */
+			if (leaf != -1) remove_leaf(*instance, leaf);
+		} else if (leaf == -1) {
+			insert_leaf(*instance);
+		} else {
+			if (instance->indexed_mesh != instance->mesh) index_leaf(*instance, leaf);
+			instance_tree.move(leaf);
 		}
 	}
+	
+	/* refit the ancestors of the changed leaves together */
+	instance_tree.refit();
+	
+	/* mark the leaves of visible instances in the tree of this scene */
+	if (rebuilt || visible_dirty) {
+		visible_instances.clear();
+		collect_visible_instances(visible_instances);
+		instance_tree.set_all_visible(false);
+		for (auto* instance : visible_instances) {
+			int leaf = find_leaf(*instance);
+			if (leaf != -1) instance_tree.set_visible(leaf, true);
+		}
+	}
+	visible_dirty = false;
 }
 
 std::vector<const Instance*> Scene::to_instances() const {
@@ -215,9 +363,51 @@ std::vector<const Instance*> Scene::to_instances() const {
 }
 
 std::vector<const Instance*> Scene::to_visible_instances() const {
-	std::vector<const Instance*> unvisited;
+	return get_visible_instances();
+}
+
+const std::vector<const Instance*>& Scene::get_visible_instances() const {
+	return visible_instances;
+}
+
+std::vector<const Instance*> Scene::to_visible_instances(const Camera& c) const {
 	std::vector<const Instance*> instances;
-	unvisited.emplace_back(this);
+	to_visible_instances(c, instances);
+	return instances;
+}
+
+void Scene::to_visible_instances(const Camera& c, std::vector<const Instance*>& o) const {
+	/* query the visible leaves intersecting the frustum from tree */
+	o.clear();
+	instance_tree.query_frustum(c.get_frustum(), o, true);
+}
+
+std::vector<const Instance*> Scene::query_box(const Vec3& l, const Vec3& u) const {
+	std::vector<const Instance*> instances;
+	instance_tree.query_box(l, u, instances);
+	return instances;
+}
+
+std::vector<const Instance*> Scene::query_sphere(const Vec3& c, float r) const {
+	std::vector<const Instance*> instances;
+	instance_tree.query_sphere(c, r, instances);
+	return instances;
+}
+
+std::vector<const Instance*> Scene::query_frustum(const Frustum& f) const {
+	std::vector<const Instance*> instances;
+	instance_tree.query_frustum(f, instances);
+	return instances;
+}
+
+std::vector<const Instance*> Scene::query_ray(const Ray& r) const {
+	std::vector<const Instance*> instances;
+	instance_tree.query_ray(r, instances);
+	return instances;
+}
+
+void Scene::collect_visible_instances(std::vector<const Instance*>& o) const {
+	std::vector<const Instance*> unvisited = {this};
 	while (!unvisited.empty()) {
 		const Instance* current = unvisited.back();
 		unvisited.pop_back();
@@ -226,11 +416,185 @@ std::vector<const Instance*> Scene::to_visible_instances() const {
 		for (int i = 0; i < count; ++i) {
 			unvisited.emplace_back(current->get_child(i));
 		}
-		if (current->mesh != nullptr) {
-			instances.emplace_back(current);
+		if (current->mesh != nullptr) o.emplace_back(current);
+	}
+}
+
+bool Scene::has_shared_instances() const {
+	if (parent != nullptr) return true;
+	std::vector<const Instance*> unvisited = {this};
+	while (!unvisited.empty()) {
+		const Instance* current = unvisited.back();
+		unvisited.pop_back();
+		for (auto* child : current->children) {
+			if (child->shared) return true;
+			unvisited.emplace_back(child);
+		}
+	}
+	return false;
+}
+
+void Scene::update_hierarchies(bool f) {
+	/* nothing is changed if the scene has no dirty subtrees */
+	if (!f && !subtree_dirty) return;
+	
+	/* update the scene itself as the root of hierarchies */
+	bool root_changed = update_instance(*this, nullptr, f, changed_instances);
+	std::vector<std::pair<Instance*, bool>> subtrees = {{this, root_changed}};
+	
+	/* split the hierarchies into independent subtrees for large scenes */
+	int task_count = WorkerPool::get_thread_count();
+	bool parallel = task_count > 1 && instance_tree.get_leaf_count() >= PARALLEL_UPDATE_THRESHOLD;
+	while (parallel && subtrees.size() < task_count * 4) {
+		std::vector<std::pair<Instance*, bool>> next_subtrees;
+		for (auto& [instance, changed] : subtrees) {
+			for (auto* child : instance->children) {
+				if (!changed && !child->subtree_dirty) continue;
+				bool child_changed = update_instance(*child, &instance->matrix_global, changed, changed_instances);
+				next_subtrees.emplace_back(child, child_changed);
+			}
 		}
+		if (next_subtrees.empty()) break;
+		subtrees.swap(next_subtrees);
 	}
-	return instances;
+	
+	/* update the descendants of subtrees in parallel */
+	if (!parallel || subtrees.size() < 2) {
+		update_subtrees(subtrees, 0, 1, changed_instances);
+	} else {
+		std::vector<std::vector<Instance*>> task_changes(task_count);
+		WorkerPool::run(task_count, [&](int i) -> void {
+			update_subtrees(subtrees, i, task_count, task_changes[i]);
+		});
+		for (int i = 0; i < task_count; ++i) {
+			changed_instances.insert(changed_instances.end(), task_changes[i].begin(), task_changes[i].end());
+		}
+	}
+}
+
+void Scene::update_transforms(bool f) {
+	/* flatten the hierarchies again if they are changed */
+	bool rebuilt = f || transform_system.get_root() != this;
+	if (rebuilt) transform_system.build(*this);
+	
+	/* sweep the changed subtrees from the scene as the root */
+	bool root_changed = update_instance(*this, nullptr, rebuilt, changed_instances);
+	transform_system.update(matrix_global, rebuilt || root_changed, changed_instances);
+}
+
+bool Scene::update_instance(Instance& i, const Mat4* m, bool p, std::vector<Instance*>& c) {
+	/* check whether the transform, the mesh, the visibility or the materials are changed */
+	i.subtree_dirty = false;
+	bool transform_changed = i.transform_dirty;
+	bool mesh_changed = i.mesh != i.cached_mesh || (i.mesh != nullptr && i.mesh->bound_radius < 0);
+	bool visible_changed = i.visible != i.cached_visible;
+	if (!p && !transform_changed && !mesh_changed && !visible_changed && !i.bindings_dirty) return false;
+	
+	/* recalculate the local matrix only if the transform is changed */
+	if (transform_changed) {
+		i.matrix_local = i.transform();
+		i.transform_dirty = false;
+	}
+	bool global_changed = p || transform_changed;
+	if (global_changed) {
+		i.matrix_global = m == nullptr ? i.matrix_local : *m * i.matrix_local;
+	}
+	i.prepare_bounds();
+	c.emplace_back(&i);
+	return global_changed;
+}
+
+void Scene::update_subtrees(const std::vector<std::pair<Instance*, bool>>& s, int f, int n, std::vector<Instance*>& c) {
+	std::vector<std::pair<Instance*, bool>> unvisited;
+	for (int i = f; i < s.size(); i += n) {
+		unvisited.emplace_back(s[i]);
+		while (!unvisited.empty()) {
+			auto [current, changed] = unvisited.back();
+			unvisited.pop_back();
+			for (auto* child : current->children) {
+				if (!changed && !child->subtree_dirty) continue;
+				bool child_changed = update_instance(*child, &current->matrix_global, changed, c);
+				unvisited.emplace_back(child, child_changed);
+			}
+		}
+	}
+}
+
+float Scene::get_displacement_padding(const Instance& i) const {
+	float padding = 0;
+	if (i.mesh == nullptr) return padding;
+	size_t group_size = i.mesh->groups.size();
+	for (int g = 0; g < group_size; ++g) {
+		auto* material = get_material(i, g);
+		if (material == nullptr || material->displacement_map == nullptr) continue;
+		padding = std::max(padding, fabsf(material->displacement_scale));
+	}
+	return padding;
+}
+
+int Scene::find_leaf(const Instance& i) const {
+	if (i.tree_scene == this) return i.tree_leaf;
+	auto leaf = tree_leaves.find(&i);
+	return leaf == tree_leaves.end() ? -1 : leaf->second;
+}
+
+void Scene::insert_leaf(Instance& i) {
+	/* the scene owning the instance keeps the leaf in it, shared scenes use the map */
+	int leaf = instance_tree.insert(&i);
+	visible_dirty = true;
+	if (!shared_hierarchies && (i.tree_scene == nullptr || i.tree_scene == this)) {
+		i.tree_scene = this;
+		i.tree_leaf = leaf;
+		index_leaf(i, leaf);
+	} else {
+		tree_leaves.insert_or_assign(&i, leaf);
+	}
+}
+
+void Scene::remove_leaf(Instance& i, int l) {
+	instance_tree.remove(l);
+	visible_dirty = true;
+	if (i.tree_scene == this) {
+		i.tree_scene = nullptr;
+		i.tree_leaf = -1;
+	} else {
+		tree_leaves.erase(&i);
+	}
+}
+
+void Scene::index_leaf(Instance& i, int l) {
+	/* find the leaves by the group names when the materials are changed */
+	for (auto& group : i.mesh->groups) {
+		group_leaves[group.name].insert_or_assign(l, &i);
+	}
+	i.indexed_mesh = i.mesh;
+}
+
+void Scene::clear_bindings() {
+	binding_version = ++binding_versions;
+	for (auto& [name, leaves] : group_leaves) mark_bindings_dirty(leaves);
+}
+
+void Scene::clear_bindings(const std::string& n) {
+	/* the shared scenes update all the instances every time */
+	if (shared_hierarchies) {
+		binding_version = ++binding_versions;
+		return;
+	}
+	auto leaves = group_leaves.find(n);
+	if (leaves != group_leaves.end()) mark_bindings_dirty(leaves->second);
+}
+
+void Scene::mark_bindings_dirty(std::unordered_map<int, Instance*>& l) {
+	std::erase_if(l, [this](const auto& leaf) -> bool {
+		/* drop the leaves removed from the tree since they are indexed */
+		auto [index, instance] = leaf;
+		if (instance_tree.get_instance(index) != instance) return true;
+		instance->binding_scene = nullptr;
+		instance->bindings_dirty = true;
+		instance->mark_subtree_dirty();
+		return false;
+	});
 }
 
 }
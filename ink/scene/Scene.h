@@ -22,6 +22,10 @@
 
 #pragma once
 
+#include "AABBTree.h"
+#include "TransformSystem.h"
+
+#include "../camera/Camera.h"
 #include "../lights/DirectionalLight.h"
 #include "../lights/Exp2Fog.h"
 #include "../lights/HemisphereLight.h"
@@ -46,6 +50,12 @@ public:
 	 */
 	Scene(const std::string& n = "");
 	
+	/**
+	 * Detaches the instances from the instance tree and deletes this Scene
+	 * object.
+	 */
+	~Scene();
+	
 	/**
 	 * Returns the material that matches the specified name.
 	 *
@@ -71,6 +81,18 @@ public:
 	 */
 	Material* get_material(const std::string& n, const Instance& s) const;
 	
+	/**
+	 * Returns the material linked to the group at the specified index of the
+	 * instance's mesh. The materials of all groups are resolved in the order of
+	 * instance, mesh and scene, then stored in the instance. They are resolved
+	 * again when the materials named after the groups of the instance, the
+	 * mesh of the instance or its group count are changed.
+	 *
+	 * \param s instance
+	 * \param g the index of the mesh group
+	 */
+	Material* get_material(const Instance& s, int g) const;
+	
 	/**
 	 * Sets the specified material with name to the scene.
 	 *
@@ -277,7 +299,42 @@ public:
 	void clear_lights();
 	
 	/**
-	 * Updates the local and global matrices of all the instances in the scene.
+	 * Returns true if the transforms of instances are stored in the flattened
+	 * transform system of scene.
+	 */
+	bool get_flat_transforms() const;
+	
+	/**
+	 * Determines whether to store the transforms of instances in the
+	 * flattened transform system of scene. The transforms are copied into
+	 * contiguous depth-ordered arrays in the next update. The changed subtrees
+	 * are then updated by linear sweeps instead of walking the pointer
+	 * hierarchies, and the matrices are written back to the instances. Scenes whose
+	 * instances are shared with other scenes always use the hierarchies. The
+	 * default is false.
+	 *
+	 * \param f whether to use flattened transforms
+	 */
+	void set_flat_transforms(bool f);
+	
+	/**
+	 * Updates the local and global matrices and the bounding boxes of all the
+	 * instances in the scene. Only the subtrees marked by the setters or
+	 * mark_dirty of instances and by adding children are visited, so mark_dirty
+	 * should be called after writing the fields of instances directly. The
+	 * changed instances and their descendants are recalculated, and large
+	 * scenes are updated with independent subtrees in parallel. All the
+	 * instances are visited if some are shared with other scenes. The bounding
+	 * boxes are inflated by the displacement scales of the materials with
+	 * displacement maps, the instances with groups named after the changed
+	 * materials of scene are updated, and mark_dirty should be called after
+	 * changing the displacement of a material in place. The instance tree is
+	 * synchronized with the scene, where the added instances are inserted, the
+	 * moved leaves are refitted together and the tree is rebuilt if a large
+	 * fraction of leaves are changed. The leaves of removed instances are
+	 * removed from the tree at once. Scenes sharing instances with others
+	 * rebuild the tree in every update. The visible list is rebuilt if the
+	 * visibilities are changed.
 	 */
 	void update_instances();
 	
@@ -288,10 +345,81 @@ public:
 	
 	/**
 	 * Returns an instance list of all the instances in the scene, excluding
-	 * invisible ones.
+	 * invisible ones. The list is prepared by update_instances and is not
+	 * collected again here, so update_instances should be called after adding,
+	 * removing or changing instances, otherwise the list of the last update
+	 * is returned.
 	 */
 	std::vector<const Instance*> to_visible_instances() const;
 	
+	/**
+	 * Returns the list of visible instances without copying it. The list is
+	 * prepared by update_instances, which should be called after adding,
+	 * removing or changing instances, the changes since then are not
+	 * included. The reference is valid until the next call of
+	 * update_instances.
+	 */
+	const std::vector<const Instance*>& get_visible_instances() const;
+	
+	/**
+	 * Returns an instance list of all the instances in the scene, excluding
+	 * invisible ones and ones outside the view frustum of the camera. The
+	 * instance tree and the visibilities of its leaves are prepared by
+	 * update_instances, the changes since then are not included.
+	 *
+	 * \param c camera
+	 */
+	std::vector<const Instance*> to_visible_instances(const Camera& c) const;
+	
+	/**
+	 * Collects all the instances in the scene, excluding invisible ones and
+	 * ones outside the view frustum of the camera, into the specified list.
+	 * The list is cleared first, so the same list can be reused for every
+	 * frame without allocation.
+	 *
+	 * \param c camera
+	 * \param o the output instance list
+	 */
+	void to_visible_instances(const Camera& c, std::vector<const Instance*>& o) const;
+	
+	/**
+	 * Returns an instance list of the instances with mesh whose bounding boxes
+	 * intersect the specified box. The instance tree is prepared by
+	 * update_instances, the instances added since then are not included.
+	 *
+	 * \param l the lower boundary of the box
+	 * \param u the upper boundary of the box
+	 */
+	std::vector<const Instance*> query_box(const Vec3& l, const Vec3& u) const;
+	
+	/**
+	 * Returns an instance list of the instances with mesh whose bounding boxes
+	 * intersect the specified sphere. The instance tree is prepared by
+	 * update_instances, the instances added since then are not included.
+	 *
+	 * \param c the center of the sphere
+	 * \param r the radius of the sphere
+	 */
+	std::vector<const Instance*> query_sphere(const Vec3& c, float r) const;
+	
+	/**
+	 * Returns an instance list of the instances with mesh whose bounding boxes
+	 * intersect the specified frustum. The instance tree is prepared by
+	 * update_instances, the instances added since then are not included.
+	 *
+	 * \param f frustum
+	 */
+	std::vector<const Instance*> query_frustum(const Frustum& f) const;
+	
+	/**
+	 * Returns an instance list of the instances with mesh whose bounding boxes
+	 * intersect the specified ray. The instance tree is prepared by
+	 * update_instances, the instances added since then are not included.
+	 *
+	 * \param r ray
+	 */
+	std::vector<const Instance*> query_ray(const Ray& r) const;
+	
 private:
 	LinearFog* linear_fog = nullptr;
 	Exp2Fog* exp2_fog = nullptr;
@@ -302,6 +430,60 @@ private:
 	std::vector<HemisphereLight*> hemisphere_lights;
 	
 	std::unordered_map<std::string, Material*> material_library;
+	
+	size_t binding_version = 0;
+	
+	AABBTree instance_tree;
+	
+	std::unordered_map<const Instance*, int> tree_leaves;
+	
+	std::vector<Instance*> changed_instances;
+	
+	std::unordered_map<std::string, std::unordered_map<int, Instance*>> group_leaves;
+	
+	bool forced_update = true;
+	
+	bool visible_dirty = false;
+	
+	bool shared_hierarchies = false;
+	
+	bool flat_transforms = false;
+	
+	TransformSystem transform_system;
+	
+	std::vector<const Instance*> visible_instances;
+	
+	static size_t binding_versions;
+	
+	float get_displacement_padding(const Instance& i) const;
+	
+	int find_leaf(const Instance& i) const;
+	
+	void insert_leaf(Instance& i);
+	
+	void remove_leaf(Instance& i, int l);
+	
+	void index_leaf(Instance& i, int l);
+	
+	void clear_bindings();
+	
+	void clear_bindings(const std::string& n);
+	
+	void mark_bindings_dirty(std::unordered_map<int, Instance*>& l);
+	
+	void collect_visible_instances(std::vector<const Instance*>& o) const;
+	
+	bool has_shared_instances() const;
+	
+	void update_hierarchies(bool f);
+	
+	void update_transforms(bool f);
+	
+	static bool update_instance(Instance& i, const Mat4* m, bool p, std::vector<Instance*>& c);
+	
+	static void update_subtrees(const std::vector<std::pair<Instance*, bool>>& s, int f, int n, std::vector<Instance*>& c);
+	
+	friend class Instance;
 };
 
 }
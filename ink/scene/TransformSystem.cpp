@@ -0,0 +1,227 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "TransformSystem.h"
+
+#include "../core/WorkerPool.h"
+
+#include <algorithm>
+
+namespace ink {
+
+constexpr size_t PARALLEL_SWEEP_THRESHOLD = 4096;
+
+constexpr uint8_t TRANSFORM_CHANGED = 1;
+
+constexpr uint8_t INSTANCE_CHANGED = 2;
+
+TransformSystem::~TransformSystem() {
+	clear();
+}
+
+void TransformSystem::build(Instance& r) {
+	clear();
+	root = &r;
+	
+	/* flatten the descendants in depth-first order */
+	std::vector<std::pair<Instance*, int>> unvisited;
+	for (auto child = r.children.rbegin(); child != r.children.rend(); ++child) {
+		unvisited.emplace_back(*child, -1);
+	}
+	while (!unvisited.empty()) {
+		auto [current, parent] = unvisited.back();
+		unvisited.pop_back();
+		int slot = static_cast<int>(instances.size());
+		instances.emplace_back(current);
+		parents.emplace_back(parent);
+		for (auto child = current->children.rbegin(); child != current->children.rend(); ++child) {
+			unvisited.emplace_back(*child, slot);
+		}
+	}
+	
+	/* find the end of every subtree from the leaves up */
+	int size = static_cast<int>(instances.size());
+	subtree_ends.resize(size);
+	for (int i = 0; i < size; ++i) subtree_ends[i] = i + 1;
+	for (int i = size - 1; i >= 0; --i) {
+		int parent = parents[i];
+		if (parent != -1) subtree_ends[parent] = std::max(subtree_ends[parent], subtree_ends[i]);
+	}
+	
+	/* copy the transforms into the arrays */
+	positions.resize(size);
+	rotations.resize(size);
+	scales.resize(size);
+	matrices_local.resize(size);
+	matrices_global.resize(size);
+	changes.resize(size);
+	for (int i = 0; i < size; ++i) {
+		auto& instance = *instances[i];
+		positions[i] = instance.position;
+		rotations[i] = instance.rotation;
+		scales[i] = instance.scale;
+		matrices_local[i] = instance.matrix_local;
+		matrices_global[i] = instance.matrix_global;
+		changes[i] = instance.transform_dirty ? TRANSFORM_CHANGED : 0;
+		instance.transform_dirty = false;
+		instance.transform_system = this;
+		instance.transform_index = i;
+	}
+}
+
+void TransformSystem::clear() {
+	/* the transforms are kept in the instances as well */
+	size_t size = instances.size();
+	for (int i = 0; i < size; ++i) {
+		if (instances[i] == nullptr) continue;
+		auto& instance = *instances[i];
+		instance.transform_system = nullptr;
+		instance.transform_index = -1;
+		
+		/* let the pointer hierarchies visit the instance next time */
+		instance.transform_dirty = true;
+		instance.subtree_dirty = true;
+	}
+	root = nullptr;
+	instances.clear();
+	parents.clear();
+	subtree_ends.clear();
+	positions.clear();
+	rotations.clear();
+	scales.clear();
+	matrices_local.clear();
+	matrices_global.clear();
+	changes.clear();
+	changed_slots.clear();
+}
+
+void TransformSystem::update(const Mat4& m, bool f, std::vector<Instance*>& c) {
+	/* collect the subtrees of changed transforms in depth order */
+	ranges.clear();
+	int size = static_cast<int>(instances.size());
+	if (f) {
+		for (int i = 0; i < size; i = subtree_ends[i]) {
+			ranges.emplace_back(i, subtree_ends[i]);
+		}
+	} else {
+		std::sort(changed_slots.begin(), changed_slots.end());
+		int end = 0;
+		for (int slot : changed_slots) {
+			if (slot < end) continue;
+			
+			/* only the bounds are updated if the transform is not changed */
+			if ((changes[slot] & TRANSFORM_CHANGED) == 0) {
+				changes[slot] = 0;
+				if (instances[slot] == nullptr) continue;
+				instances[slot]->prepare_bounds();
+				c.emplace_back(instances[slot]);
+				continue;
+			}
+			end = subtree_ends[slot];
+			ranges.emplace_back(slot, end);
+		}
+	}
+	changed_slots.clear();
+	if (ranges.empty()) return;
+	
+	/* split the subtrees into their children for large sweeps */
+	size_t count = 0;
+	for (auto [first, end] : ranges) count += end - first;
+	int task_count = WorkerPool::get_thread_count();
+	bool parallel = task_count > 1 && count >= PARALLEL_SWEEP_THRESHOLD;
+	std::vector<std::pair<int, int>> next_ranges;
+	while (parallel && ranges.size() < task_count * 4) {
+		next_ranges.clear();
+		for (auto [first, end] : ranges) {
+			sweep(m, first, first + 1, c);
+			for (int child = first + 1; child < end; child = subtree_ends[child]) {
+				next_ranges.emplace_back(child, subtree_ends[child]);
+			}
+		}
+		if (next_ranges.empty()) break;
+		ranges.swap(next_ranges);
+	}
+	
+	/* sweep the subtrees in parallel */
+	if (!parallel || ranges.size() < 2) {
+		for (auto [first, end] : ranges) sweep(m, first, end, c);
+	} else {
+		std::vector<std::vector<Instance*>> task_changes(task_count);
+		WorkerPool::run(task_count, [&](int i) -> void {
+			for (int r = i; r < ranges.size(); r += task_count) {
+				sweep(m, ranges[r].first, ranges[r].second, task_changes[i]);
+			}
+		});
+		for (int i = 0; i < task_count; ++i) {
+			c.insert(c.end(), task_changes[i].begin(), task_changes[i].end());
+		}
+	}
+}
+
+const Instance* TransformSystem::get_root() const {
+	return root;
+}
+
+size_t TransformSystem::get_size() const {
+	return instances.size();
+}
+
+void TransformSystem::mark_changed(int s, bool t) {
+	if (changes[s] == 0) changed_slots.emplace_back(s);
+	changes[s] |= t ? TRANSFORM_CHANGED : INSTANCE_CHANGED;
+	
+	/* copy the transform written to the instance */
+	if (t) {
+		auto& instance = *instances[s];
+		positions[s] = instance.position;
+		rotations[s] = instance.rotation;
+		scales[s] = instance.scale;
+	}
+}
+
+void TransformSystem::release(int s) {
+	instances[s] = nullptr;
+}
+
+void TransformSystem::sweep(const Mat4& m, int f, int e, std::vector<Instance*>& c) {
+	/* the parents are always updated before their children */
+	for (int i = f; i < e; ++i) {
+		if ((changes[i] & TRANSFORM_CHANGED) != 0) {
+			matrices_local[i] = Instance::transform(positions[i], rotations[i], scales[i]);
+		}
+		int parent = parents[i];
+		matrices_global[i] = (parent == -1 ? m : matrices_global[parent]) * matrices_local[i];
+		changes[i] = 0;
+	}
+	
+	/* write back the matrices and update the bounds */
+	for (int i = f; i < e; ++i) {
+		if (instances[i] == nullptr) continue;
+		auto& instance = *instances[i];
+		instance.matrix_local = matrices_local[i];
+		instance.matrix_global = matrices_global[i];
+		instance.prepare_bounds();
+		c.emplace_back(&instance);
+	}
+}
+
+}
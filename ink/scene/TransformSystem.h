@@ -0,0 +1,125 @@
+/**
+ * Copyright (C) 2021-2023 HYPERTHEORY
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "../objects/Instance.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ink {
+
+class TransformSystem {
+public:
+	/**
+	 * Creates a new TransformSystem object.
+	 */
+	TransformSystem() = default;
+	
+	/**
+	 * Detaches all the instances and deletes this TransformSystem object.
+	 */
+	~TransformSystem();
+	
+	/**
+	 * TransformSystem is non-copyable. The copy constructor is deleted.
+	 */
+	TransformSystem(const TransformSystem&) = delete;
+	
+	/**
+	 * TransformSystem is non-copyable. The copy assignment operator is
+	 * deleted.
+	 */
+	TransformSystem& operator=(const TransformSystem&) = delete;
+	
+	/**
+	 * Flattens the descendants of the specified root into contiguous arrays in
+	 * depth-first order, so that every parent is stored before its children
+	 * and every subtree is a range of the arrays. The transforms are copied
+	 * into the arrays, and the instances marked as changed copy their
+	 * transforms again, so the fields of instances stay readable.
+	 *
+	 * \param r the root instance
+	 */
+	void build(Instance& r);
+	
+	/**
+	 * Detaches all the instances from the transform system, which are updated
+	 * through the pointer hierarchies next time. This is called when the
+	 * hierarchies of attached instances are changed.
+	 */
+	void clear();
+	
+	/**
+	 * Updates the local and global matrices of the changed instances and their
+	 * descendants. The changed subtrees are swept linearly in depth order, and
+	 * independent subtrees are swept in parallel when there are many of them.
+	 * The matrices are written back to the updated instances, whose bounding
+	 * boxes are also updated.
+	 *
+	 * \param m the global matrix of root
+	 * \param f whether to update all the instances
+	 * \param c the output list of changed instances
+	 */
+	void update(const Mat4& m, bool f, std::vector<Instance*>& c);
+	
+	/**
+	 * Returns the root of the flattened hierarchies, or nullptr if the
+	 * transform system is not built.
+	 */
+	const Instance* get_root() const;
+	
+	/**
+	 * Returns the number of instances in the transform system.
+	 */
+	size_t get_size() const;
+	
+private:
+	const Instance* root = nullptr;
+	
+	std::vector<Instance*> instances;
+	std::vector<int> parents;
+	std::vector<int> subtree_ends;
+	
+	std::vector<Vec3> positions;
+	std::vector<Euler> rotations;
+	std::vector<Vec3> scales;
+	
+	std::vector<Mat4> matrices_local;
+	std::vector<Mat4> matrices_global;
+	
+	std::vector<uint8_t> changes;
+	std::vector<int> changed_slots;
+	
+	std::vector<std::pair<int, int>> ranges;
+	
+	void mark_changed(int s, bool t);
+	
+	void release(int s);
+	
+	void sweep(const Mat4& m, int f, int e, std::vector<Instance*>& c);
+	
+	friend class Instance;
+};
+
+}
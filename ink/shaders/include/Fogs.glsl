@@ -4,15 +4,15 @@
 #include <common>
 
 struct LinearFog {
-	bool visible;
 	vec3 color;
+	bool visible;
 	float near;
 	float far;
 };
 
 struct Exp2Fog {
-	bool visible;
 	vec3 color;
+	bool visible;
 	float near;
 	float density;
 };
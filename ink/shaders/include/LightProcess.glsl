@@ -4,28 +4,33 @@
 #include <lights>
 #include <fogs>
 
-#if NUM_POINT_LIGHT > 0
-uniform PointLight point_lights[NUM_POINT_LIGHT];
+#if NUM_POINT_LIGHT > 0 || NUM_SPOT_LIGHT > 0 || NUM_DIRECTIONAL_LIGHT > 0
+#define USE_LIGHT_BLOCK
+#elif NUM_HEMISPHERE_LIGHT > 0 || defined(USE_LINEAR_FOG) || defined(USE_EXP2_FOG)
+#define USE_LIGHT_BLOCK
 #endif
 
-#if NUM_SPOT_LIGHT > 0
-uniform SpotLight spot_lights[NUM_SPOT_LIGHT];
-#endif
-
-#if NUM_DIRECTIONAL_LIGHT > 0
-uniform DirectionalLight directional_lights[NUM_DIRECTIONAL_LIGHT];
-#endif
-
-#if NUM_HEMISPHERE_LIGHT > 0
-uniform HemisphereLight hemisphere_lights[NUM_HEMISPHERE_LIGHT];
-#endif
-
-#ifdef USE_LINEAR_FOG
-uniform LinearFog fog;
-#endif
-
-#ifdef USE_EXP2_FOG
-uniform Exp2Fog fog;
+#ifdef USE_LIGHT_BLOCK
+layout(std140, row_major) uniform LightBlock {
+	#if NUM_POINT_LIGHT > 0
+		PointLight point_lights[NUM_POINT_LIGHT];
+	#endif
+	#if NUM_SPOT_LIGHT > 0
+		SpotLight spot_lights[NUM_SPOT_LIGHT];
+	#endif
+	#if NUM_DIRECTIONAL_LIGHT > 0
+		DirectionalLight directional_lights[NUM_DIRECTIONAL_LIGHT];
+	#endif
+	#if NUM_HEMISPHERE_LIGHT > 0
+		HemisphereLight hemisphere_lights[NUM_HEMISPHERE_LIGHT];
+	#endif
+	#ifdef USE_LINEAR_FOG
+		LinearFog fog;
+	#endif
+	#ifdef USE_EXP2_FOG
+		Exp2Fog fog;
+	#endif
+};
 #endif
 
 vec3 light_process(Material mat, Geometry geom, vec3 light, float occlusion) {
@@ -17,38 +17,40 @@ struct Geometry {
 	vec3 normal;
 };
 
+/* The members are ordered to match the std140 layout of the light block. */
+
 struct PointLight {
-	bool visible;
 	vec3 position;
-	vec3 color;
 	float distance;
+	vec3 color;
 	float decay;
+	bool visible;
 };
 
 struct SpotLight {
-	bool visible;
 	vec3 position;
-	vec3 direction;
-	vec3 color;
 	float distance;
+	vec3 direction;
 	float decay;
+	vec3 color;
 	float angle;
 	float penumbra;
+	bool visible;
 	bool cast_shadow;
 	Shadow shadow;
 };
 
 struct DirectionalLight {
-	bool visible;
 	vec3 direction;
+	bool visible;
 	vec3 color;
 	bool cast_shadow;
 	Shadow shadow;
 };
 
 struct HemisphereLight {
-	bool visible;
 	vec3 direction;
+	bool visible;
 	vec3 sky_color;
 	vec3 ground_color;
 };
@@ -22,4 +22,11 @@ vec2 unpack_vec2(vec4 v) {
 	return vec2(v.x + (v.y / 255.), v.z + (v.w / 255.));
 }
 
+/* Decodes octahedron to normalized vector. */
+vec3 decode_octahedron(vec2 e) {
+	vec3 v = vec3(e, 1. - abs(e.x) - abs(e.y));
+	if (v.z < 0.) v.xy = (1. - abs(v.yx)) * vec2(v.x >= 0. ? 1. : -1., v.y >= 0. ? 1. : -1.);
+	return normalize(v);
+}
+
 #endif
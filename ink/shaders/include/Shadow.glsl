@@ -21,12 +21,12 @@ struct GlobalShadow {
 };
 
 struct Shadow {
+	mat4 view_proj;
 	int type;
 	int map_id;
 	float bias;
 	float normal_bias;
 	float radius;
-	mat4 view_proj;
 };
 
 uniform GlobalShadow global_shadow;
@@ -1,13 +1,32 @@
 #include <common>
 
 uniform mat4 model_view_proj;
+uniform mat4 view_proj;
+
+#ifdef USE_VERTEX_QUANTIZATION
+uniform vec3 vertex_offset;
+uniform vec3 vertex_scale;
+#endif
 
 in vec3 vertex;
 in vec2 uv;
 
+#ifdef INSTANCING
+in mat4 instance_model;
+#endif
+
 out vec2 v_uv;
 
 void main() {
+	#ifdef USE_VERTEX_QUANTIZATION
+		vec3 t_vertex = vertex_offset + vertex * vertex_scale;
+	#else
+		vec3 t_vertex = vertex;
+	#endif
 	v_uv = uv;
-	gl_Position = model_view_proj * vec4(vertex, 1.);
+	#ifdef INSTANCING
+		gl_Position = view_proj * instance_model * vec4(t_vertex, 1.);
+	#else
+		gl_Position = model_view_proj * vec4(t_vertex, 1.);
+	#endif
 }
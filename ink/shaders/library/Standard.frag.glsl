@@ -15,58 +15,54 @@ uniform vec3 camera_pos;
 #include <lightprocess>
 #endif
 
-uniform float alpha_test;
+layout(std140) uniform MaterialBlock {
+	vec3 color;
+	float alpha;
+	vec3 emissive;
+	float alpha_test;
+	float ao_intensity;
+	float metalness;
+	float roughness;
+	float specular;
+	float normal_scale;
+	float ref_lod;
+	float ref_intensity;
+};
 
 #ifdef USE_NORMAL_MAP
 uniform sampler2D normal_map;
-uniform float normal_scale;
 #endif
 
-uniform vec3 color;
-
 #if defined(USE_COLOR_MAP) || defined(USE_COLOR_ALPHA_MAP)
 uniform sampler2D color_map;
 #endif
 
-uniform float alpha;
-
 #ifdef USE_ALPHA_MAP
 uniform sampler2D alpha_map;
 #endif
 
-uniform vec3 emissive;
-
 #ifdef USE_EMISSIVE_MAP
 uniform sampler2D emissive_map;
 #endif
 
 #ifdef USE_AO_MAP
 uniform sampler2D ao_map;
-uniform float ao_intensity;
 #endif
 
-uniform float metalness;
-
 #ifdef USE_METALNESS_MAP
 uniform sampler2D metalness_map;
 #endif
 
-uniform float roughness;
-
 #ifdef USE_ROUGHNESS_MAP
 uniform sampler2D roughness_map;
 #endif
 
-uniform float specular;
-
 #ifdef USE_SPECULAR_MAP
 uniform sampler2D specular_map;
 #endif
 
 #ifdef USE_REFLECTION_PROBE
 uniform samplerCube ref_map;
-uniform float ref_lod;
-uniform float ref_intensity;
 #endif
 
 in vec3 v_normal;
@@ -82,6 +78,10 @@ in vec3 v_bitangent;
 in vec3 v_color;
 #endif
 
+#if defined(INSTANCING) && defined(USE_OBJECT_SPACE)
+flat in mat3 v_normal_mat;
+#endif
+
 #ifdef FORWARD_RENDERING
 layout(location = 0) out vec4 out_color;
 #endif
@@ -125,7 +125,9 @@ void main() {
 			mat3 tbn_mat = mat3(tangent, bitangent, t_normal);
 			t_normal = normalize(tbn_mat * normal);
 		#endif
-		#ifdef USE_OBJECT_SPACE
+		#if defined(INSTANCING) && defined(USE_OBJECT_SPACE)
+			t_normal = normalize(v_normal_mat * normal);
+		#elif defined(USE_OBJECT_SPACE)
 			t_normal = normalize(normal_mat * normal);
 		#endif
 	#endif
@@ -1,4 +1,5 @@
 #include <common>
+#include <packing>
 
 uniform mat4 model;
 uniform mat4 view;
@@ -13,10 +14,20 @@ uniform sampler2D displacement_map;
 uniform float displacement_scale;
 #endif
 
+#ifdef USE_VERTEX_QUANTIZATION
+uniform vec3 vertex_offset;
+uniform vec3 vertex_scale;
+#endif
+
 in vec3 vertex;
-in vec3 normal;
 in vec2 uv;
 
+#ifdef USE_VERTEX_QUANTIZATION
+in vec2 normal;
+#else
+in vec3 normal;
+#endif
+
 out vec3 v_normal;
 out vec2 v_uv;
 out vec3 v_world_pos;
@@ -32,11 +43,28 @@ in vec3 color;
 out vec3 v_color;
 #endif
 
+#ifdef INSTANCING
+in mat4 instance_model;
+in mat3 instance_normal;
+#endif
+
+#if defined(INSTANCING) && defined(USE_OBJECT_SPACE)
+flat out mat3 v_normal_mat;
+#endif
+
 void main() {
-	vec3 t_vertex = vertex;
-	vec3 t_normal = normal;
+	#ifdef USE_VERTEX_QUANTIZATION
+		vec3 t_vertex = vertex_offset + vertex * vertex_scale;
+		vec3 t_normal = decode_octahedron(normal);
+	#else
+		vec3 t_vertex = vertex;
+		vec3 t_normal = normal;
+	#endif
 	vec2 t_uv = uv;
-	#ifdef USE_TANGENT_SPACE
+	#if defined(USE_TANGENT_SPACE) && defined(USE_VERTEX_QUANTIZATION)
+		vec3 t_tangent = decode_octahedron(tangent.xy);
+		vec3 t_bitangent;
+	#elif defined(USE_TANGENT_SPACE)
 		vec3 t_tangent = tangent.xyz;
 		vec3 t_bitangent;
 	#endif
@@ -44,17 +72,26 @@ void main() {
 		vec3 t_color = color;
 	#endif
 	
+	/* get model and normal matrices of the instance */
+	#ifdef INSTANCING
+		mat4 t_model = instance_model;
+		mat3 t_normal_mat = instance_normal;
+	#else
+		mat4 t_model = model;
+		mat3 t_normal_mat = normal_mat;
+	#endif
+	
 	#ifdef USE_DISPLACEMENT_MAP
 		/* reposition the vertex by displacement map */
 		t_vertex += t_normal * texture(displacement_map, t_uv).x * displacement_scale;
 	#endif
 	
 	/* transform normal from object space to world space */
-	t_normal = normalize(normal_mat * t_normal);
+	t_normal = normalize(t_normal_mat * t_normal);
 	
 	#ifdef USE_TANGENT_SPACE
 		/* transform tangent from object space to world space */
-		t_tangent = normalize((model * vec4(t_tangent, 0.)).xyz);
+		t_tangent = normalize((t_model * vec4(t_tangent, 0.)).xyz);
 		
 		/* calculate bitangent with normal and tangent */
 		t_bitangent = normalize(cross(t_normal, t_tangent) * tangent.w);
@@ -63,7 +100,7 @@ void main() {
 	/* pass parameters to fragment shader */
 	v_normal = t_normal;
 	v_uv = t_uv;
-	v_world_pos = (model * vec4(t_vertex, 1.)).xyz;
+	v_world_pos = (t_model * vec4(t_vertex, 1.)).xyz;
 	#ifdef USE_TANGENT_SPACE
 		v_tangent = t_tangent;
 		v_bitangent = t_bitangent;
@@ -71,5 +108,12 @@ void main() {
 	#ifdef USE_VERTEX_COLOR
 		v_color = t_color;
 	#endif
-	gl_Position = model_view_proj * vec4(t_vertex, 1.);
+	#if defined(INSTANCING) && defined(USE_OBJECT_SPACE)
+		v_normal_mat = t_normal_mat;
+	#endif
+	#ifdef INSTANCING
+		gl_Position = proj * view * vec4(v_world_pos, 1.);
+	#else
+		gl_Position = model_view_proj * vec4(t_vertex, 1.);
+	#endif
 }
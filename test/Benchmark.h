@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+/**
+ * Returns the average time in milliseconds of calling the function for the
+ * specified times. The index of each call is passed to the function. The
+ * warm-up calls are made before timing and are not counted.
+ *
+ * \param n the number of calls
+ * \param f function
+ * \param w the number of warm-up calls
+ */
+template <typename F>
+double measure(int n, F f, int w = 0) {
+	for (int i = 0; i < w; ++i) f(i);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < n; ++i) f(i);
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count() / n;
+}
+
+/**
+ * Exits the process with failure if the result of the fast path differs from
+ * the result of the reference path.
+ *
+ * \param n the name of the comparison
+ * \param a the result of the fast path
+ * \param b the result of the reference path
+ */
+template <typename T>
+void expect_same(const char* n, const T& a, const T& b) {
+	if (a == b) return;
+	std::cerr << n << ": mismatch\n";
+	std::exit(EXIT_FAILURE);
+}
+
+/**
+ * Exits the process with failure if the result of the fast path differs from
+ * the result of the reference path by more than the tolerance.
+ *
+ * \param n the name of the comparison
+ * \param a the result of the fast path
+ * \param b the result of the reference path
+ * \param e tolerance
+ */
+inline void expect_near(const char* n, double a, double b, double e) {
+	if (a - b <= e && b - a <= e) return;
+	std::cerr << n << ": " << a << " differs from " << b << '\n';
+	std::exit(EXIT_FAILURE);
+}
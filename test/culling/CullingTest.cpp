@@ -0,0 +1,84 @@
+#include "ink/Ink.h"
+#include "test/Benchmark.h"
+
+#include <iostream>
+
+#define INSTANCE_COUNT 100000
+#define REPEAT_COUNT 100
+
+ink::Mesh box;
+ink::Scene scene;
+ink::PerspCamera camera;
+
+std::vector<const ink::Instance*> instances;
+std::vector<float> boxes;
+std::vector<uint8_t> results;
+
+void load() {
+	box = ink::BoxMesh::create();
+	
+	for (int i = 0; i < INSTANCE_COUNT; ++i) {
+		ink::Instance* instance = new ink::Instance();
+		float x = ink::Random::random_f() * 200 - 100;
+		float y = ink::Random::random_f() * 200 - 100;
+		float z = ink::Random::random_f() * 200 - 100;
+		instance->set_position(ink::Vec3(x, y, z));
+		instance->set_mesh(&box);
+		scene.add(instance);
+	}
+	scene.update_instances();
+	
+	camera = ink::PerspCamera(75 * ink::DEG_TO_RAD, 1.77, 0.05, 1000);
+	camera.lookat(ink::Vec3(0, 0, 0), ink::Vec3(0, 0, 1), ink::Vec3(0, 1, 0));
+	
+	/* store the world bounds in SoA layout */
+	instances = scene.to_visible_instances();
+	size_t size = instances.size();
+	boxes.resize(size * 6);
+	results.resize(size);
+	for (int i = 0; i < size; ++i) {
+		ink::Vec3 center = (instances[i]->bound_max + instances[i]->bound_min) * 0.5;
+		ink::Vec3 extent = (instances[i]->bound_max - instances[i]->bound_min) * 0.5;
+		boxes[i           ] = center.x;
+		boxes[i + size    ] = center.y;
+		boxes[i + size * 2] = center.z;
+		boxes[i + size * 3] = extent.x;
+		boxes[i + size * 4] = extent.y;
+		boxes[i + size * 5] = extent.z;
+	}
+}
+
+int main(int argc, char** argv) {
+	load();
+	ink::Frustum frustum = camera.get_frustum();
+	
+	/* test the boxes one by one */
+	size_t scalar_count = 0;
+	double scalar_ms = measure(REPEAT_COUNT, [&](int) -> void {
+		scalar_count = 0;
+		for (auto* instance : instances) {
+			scalar_count += frustum.intersects_box(instance->bound_min, instance->bound_max);
+		}
+	});
+	
+	/* test the SoA boxes in batch */
+	size_t batch_count = 0;
+	double batch_ms = measure(REPEAT_COUNT, [&](int) -> void {
+		frustum.intersects_boxes(boxes.data(), instances.size(), results.data());
+		batch_count = 0;
+		for (auto result : results) batch_count += result;
+	});
+	
+	/* cull the scene through the instance tree */
+	size_t scene_count = 0;
+	double scene_ms = measure(REPEAT_COUNT, [&](int) -> void {
+		scene_count = scene.to_visible_instances(camera).size();
+	});
+	
+	std::cout << "Instances: " << instances.size() << '\n';
+	std::cout << "Scalar: " << scalar_ms << " ms, " << scalar_count << " visible\n";
+	std::cout << "Batch: " << batch_ms << " ms, " << batch_count << " visible\n";
+	std::cout << "Scene: " << scene_ms << " ms, " << scene_count << " visible\n";
+	expect_same("Batch", batch_count, scalar_count);
+	return 0;
+}
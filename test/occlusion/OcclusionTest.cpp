@@ -0,0 +1,56 @@
+#include "ink/Ink.h"
+#include "addons/software/Software.h"
+
+#include <cmath>
+#include <iostream>
+
+#define BUFFER_WIDTH 256
+#define BUFFER_HEIGHT 128
+
+ink::Mesh box;
+ink::Scene scene;
+ink::PerspCamera camera;
+
+bool check(const char* name, const ink::Vec3& c, float s, bool v, const ink::soft::OcclusionBuffer& b) {
+	bool visible = b.test(c - s, c + s, camera);
+	std::cout << name << ": " << (visible ? "visible" : "occluded") << '\n';
+	return visible == v;
+}
+
+int main(int argc, char** argv) {
+	box = ink::BoxMesh::create();
+	
+	/* place a wall filling the view in front of the camera */
+	ink::Instance* wall = new ink::Instance();
+	wall->set_mesh(&box);
+	wall->occluder = true;
+	wall->set_position(ink::Vec3(0, 0, -5));
+	wall->set_scale(ink::Vec3(100, 100, 1));
+	scene.add(wall);
+	scene.update_instances();
+	
+	float aspect = static_cast<float>(BUFFER_WIDTH) / BUFFER_HEIGHT;
+	camera = ink::PerspCamera(75 * ink::DEG_TO_RAD, aspect, 0.05, 1000);
+	camera.lookat(ink::Vec3(0, 0, 0), ink::Vec3(0, 0, 1), ink::Vec3(0, 1, 0));
+	
+	ink::soft::OcclusionBuffer buffer = ink::soft::OcclusionBuffer(BUFFER_WIDTH, BUFFER_HEIGHT);
+	buffer.clear();
+	buffer.render(scene, camera);
+	
+	/* the corner of view at the depth of 20 */
+	float half_height = 20 * tanf(37.5f * ink::DEG_TO_RAD);
+	float half_width = half_height * aspect;
+	ink::Vec3 corner = ink::Vec3(-half_width, -half_height, -20);
+	
+	/* test the boxes crossing the left and bottom edges */
+	bool passed = true;
+	passed &= check("Behind wall", corner, 2, false, buffer);
+	passed &= check("In front of wall", corner * 0.15f, 0.3f, true, buffer);
+	
+	/* test the boxes outside of the view */
+	passed &= check("Left of view", corner * ink::Vec3(3, 0, 1), 2, true, buffer);
+	passed &= check("Below view", corner * ink::Vec3(0, 3, 1), 2, true, buffer);
+	
+	delete wall;
+	return passed ? 0 : 1;
+}
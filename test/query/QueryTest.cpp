@@ -0,0 +1,112 @@
+#include "ink/Ink.h"
+#include "test/Benchmark.h"
+
+#include <cmath>
+#include <iostream>
+
+#define QUERY_COUNT 1000
+
+ink::Mesh box;
+
+struct QueryResult {
+	double tree_ms = 0;
+	double scan_ms = 0;
+	size_t tree_count = 0;
+	size_t scan_count = 0;
+};
+
+ink::Vec3 random_vec3(float s) {
+	float x = ink::Random::random_f() * 2 - 1;
+	float y = ink::Random::random_f() * 2 - 1;
+	float z = ink::Random::random_f() * 2 - 1;
+	return ink::Vec3(x, y, z) * s;
+}
+
+void run(int n) {
+	/* keep the density of instances when the scene grows */
+	float size = 10 * cbrtf(n);
+	ink::Scene scene;
+	for (int i = 0; i < n; ++i) {
+		ink::Instance* instance = new ink::Instance();
+		instance->set_position(random_vec3(size));
+		instance->set_mesh(&box);
+		scene.add(instance);
+	}
+	scene.update_instances();
+	std::vector<const ink::Instance*> instances = scene.to_visible_instances();
+	
+	/* prepare the same queries for tree and linear scan */
+	std::vector<ink::Vec3> centers;
+	std::vector<ink::Ray> rays;
+	std::vector<ink::Frustum> frustums;
+	for (int i = 0; i < QUERY_COUNT; ++i) {
+		centers.emplace_back(random_vec3(size));
+		rays.emplace_back(random_vec3(size), random_vec3(1).normalize());
+		ink::PerspCamera camera = ink::PerspCamera(75 * ink::DEG_TO_RAD, 1.77, 0.05, size * 0.5);
+		camera.lookat(centers.back(), random_vec3(1).normalize(), ink::Vec3(0, 1, 0));
+		frustums.emplace_back(camera.get_frustum());
+	}
+	
+	/* box queries of 10 x 10 x 10 */
+	QueryResult box_result;
+	box_result.tree_ms = measure(QUERY_COUNT, [&](int i) -> void {
+		box_result.tree_count += scene.query_box(centers[i] - 5, centers[i] + 5).size();
+	});
+	box_result.scan_ms = measure(QUERY_COUNT, [&](int i) -> void {
+		ink::Vec3 l = centers[i] - 5;
+		ink::Vec3 u = centers[i] + 5;
+		for (auto* instance : instances) {
+			auto& lower = instance->bound_min;
+			auto& upper = instance->bound_max;
+			if (lower.x > u.x || lower.y > u.y || lower.z > u.z) continue;
+			if (upper.x < l.x || upper.y < l.y || upper.z < l.z) continue;
+			++box_result.scan_count;
+		}
+	});
+	
+	/* ray queries */
+	QueryResult ray_result;
+	ray_result.tree_ms = measure(QUERY_COUNT, [&](int i) -> void {
+		ray_result.tree_count += scene.query_ray(rays[i]).size();
+	});
+	ray_result.scan_ms = measure(QUERY_COUNT, [&](int i) -> void {
+		for (auto* instance : instances) {
+			if (rays[i].intersect_box(instance->bound_min, instance->bound_max) < 0) continue;
+			++ray_result.scan_count;
+		}
+	});
+	
+	/* frustum queries */
+	QueryResult frustum_result;
+	frustum_result.tree_ms = measure(QUERY_COUNT, [&](int i) -> void {
+		frustum_result.tree_count += scene.query_frustum(frustums[i]).size();
+	});
+	frustum_result.scan_ms = measure(QUERY_COUNT, [&](int i) -> void {
+		for (auto* instance : instances) {
+			if (!frustums[i].intersects_box(instance->bound_min, instance->bound_max)) continue;
+			++frustum_result.scan_count;
+		}
+	});
+	
+	/* print the average time of each query */
+	auto print = [](const char* name, const QueryResult& r) -> void {
+		std::cout << "  " << name << ": tree " << r.tree_ms << " ms, scan " << r.scan_ms << " ms\n";
+		expect_same(name, r.tree_count, r.scan_count);
+	};
+	std::cout << "Instances: " << n << '\n';
+	print("Box", box_result);
+	print("Ray", ray_result);
+	print("Frustum", frustum_result);
+	
+	for (int i = 0; i < n; ++i) {
+		delete scene.get_child(i);
+	}
+}
+
+int main(int argc, char** argv) {
+	box = ink::BoxMesh::create();
+	run(1000);
+	run(10000);
+	run(100000);
+	return 0;
+}
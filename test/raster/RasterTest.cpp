@@ -0,0 +1,183 @@
+#include "ink/Ink.h"
+#include "addons/software/Software.h"
+#include "test/Benchmark.h"
+
+#include <iostream>
+#include <utility>
+
+#define VP_WIDTH 1920
+#define VP_HEIGHT 1080
+#define REPEAT_COUNT 10
+#define COVERAGE_TOLERANCE 0.001
+
+#define PATH "test/shading/DamagedHelmet/"
+
+std::unordered_map<std::string, ink::Mesh> meshes;
+std::unordered_map<std::string, ink::Image> images;
+std::unordered_map<std::string, ink::Material> materials;
+
+ink::Scene sphere_scene;
+ink::Scene helmet_scene;
+ink::PerspCamera camera;
+
+ink::DirectionalLight light;
+ink::HemisphereLight ambient;
+
+void load() {
+	meshes["Sphere"] = ink::SphereMesh::create();
+	
+	meshes["Helmet"] = ink::Loader::load_obj(PATH "Helmet.obj").mesh[0];
+	meshes["Helmet"].create_tangents();
+	
+	images["Helmet_A"] = ink::Loader::load_image(PATH "Default_albedo.jpg");
+	images["Helmet_A"].flip_vertical();
+	
+	images["Helmet_N"] = ink::Loader::load_image(PATH "Default_normal.jpg");
+	images["Helmet_N"].flip_vertical();
+	
+	images["Helmet_AO"] = ink::Loader::load_image(PATH "Default_AO.jpg");
+	images["Helmet_AO"].flip_vertical();
+	
+	images["Helmet_E"] = ink::Loader::load_image(PATH "Default_emissive.jpg");
+	images["Helmet_E"].flip_vertical();
+	
+	images["Helmet_MR"] = ink::Loader::load_image(PATH "Default_metalRoughness.jpg");
+	images["Helmet_MR"].flip_vertical();
+	
+	auto helmet_mr = images["Helmet_MR"].split();
+	images["Helmet_M"] = helmet_mr[2];
+	images["Helmet_R"] = helmet_mr[1];
+	
+	materials["Material_MR"] = ink::Loader::load_mtl(PATH "Helmet.mtl").material[0];
+	materials["Material_MR"].emissive = ink::Vec3(1, 1, 1);
+	materials["Material_MR"].emissive_intensity = 2;
+	materials["Material_MR"].roughness = 1;
+	materials["Material_MR"].metalness = 1;
+	materials["Material_MR"].color_map = &images["Helmet_A"];
+	materials["Material_MR"].normal_map = &images["Helmet_N"];
+	materials["Material_MR"].ao_map = &images["Helmet_AO"];
+	materials["Material_MR"].emissive_map = &images["Helmet_E"];
+	materials["Material_MR"].metalness_map = &images["Helmet_M"];
+	materials["Material_MR"].roughness_map = &images["Helmet_R"];
+	
+	materials["Sphere"] = ink::Material("Sphere");
+	materials["Sphere"].color = ink::Vec3(0.8, 0.8, 0.8);
+	materials["Sphere"].roughness = 0.5;
+	
+	light = ink::DirectionalLight(ink::Vec3(1, 1, 1), 1.5);
+	light.direction = ink::Vec3(-1, -1, -1);
+	ambient = ink::HemisphereLight(ink::Vec3(0.4, 0.5, 0.7), ink::Vec3(0.2, 0.15, 0.1), 1);
+	
+	/* the sphere fills most of the screen */
+	sphere_scene.set_material("default", &materials["Sphere"]);
+	sphere_scene.add_light(&light);
+	sphere_scene.add_light(&ambient);
+	ink::Instance* sphere = new ink::Instance();
+	sphere->set_mesh(&meshes["Sphere"]);
+	sphere_scene.add(sphere);
+	sphere_scene.update_instances();
+	
+	helmet_scene.set_material("Material_MR", &materials["Material_MR"]);
+	helmet_scene.add_light(&light);
+	helmet_scene.add_light(&ambient);
+	ink::Instance* helmet = new ink::Instance();
+	helmet->set_mesh(&meshes["Helmet"]);
+	helmet_scene.add(helmet);
+	helmet_scene.update_instances();
+	
+	camera = ink::PerspCamera(75 * ink::DEG_TO_RAD, 1.77, 0.05, 1000);
+	camera.lookat(ink::Vec3(0, 0, 2), ink::Vec3(0, 0, 1), ink::Vec3(0, 1, 0));
+}
+
+std::vector<ink::Vec3> project(const ink::Mesh& m) {
+	/* project the triangles to screen space once, the rasterizers share them */
+	ink::Mat4 model_view_proj = camera.projection * camera.viewing;
+	std::vector<ink::Vec3> triangles;
+	size_t vertex_count = m.indices.empty() ? m.vertex.size() : m.indices.size();
+	for (size_t i = 0; i < vertex_count; ++i) {
+		size_t index = m.indices.empty() ? i : m.indices[i];
+		ink::Vec4 vertex = model_view_proj * ink::Vec4(m.vertex[index], 1);
+		float x = (vertex.x / vertex.w * 0.5f + 0.5f) * VP_WIDTH;
+		float y = (vertex.y / vertex.w * 0.5f + 0.5f) * VP_HEIGHT;
+		float z = vertex.z / vertex.w * 0.5f + 0.5f;
+		triangles.emplace_back(x, y, z);
+	}
+	return triangles;
+}
+
+size_t count_covered(const ink::Image& b) {
+	/* the depth buffer is cleared to 1 */
+	size_t count = 0;
+	auto* depths = reinterpret_cast<const float*>(b.data.data());
+	for (int i = 0; i < b.width * b.height; ++i) count += depths[i] < 1;
+	return count;
+}
+
+void run_depth(const char* name, const ink::Mesh& m) {
+	std::vector<ink::Vec3> triangles = project(m);
+	ink::soft::State state;
+	state.viewport_width = VP_WIDTH;
+	state.viewport_height = VP_HEIGHT;
+	
+	/* rasterize only depth with each rasterizer */
+	std::pair<ink::soft::RasterizerType, const char*> rasterizers[] = {
+		{ink::soft::RASTERIZER_SCANLINE, "scanline"},
+		{ink::soft::RASTERIZER_SCALAR, "scalar tiles"},
+		{ink::soft::RASTERIZER_SSE2, "SSE2 tiles"},
+		{ink::soft::RASTERIZER_AVX2, "AVX2 tiles"},
+	};
+	ink::Image tile_result;
+	size_t scanline_covered = 0;
+	double scanline_ms = 0;
+	for (auto& [type, type_name] : rasterizers) {
+		if (!ink::soft::is_supported(type)) continue;
+		state.rasterizer = type;
+		ink::Image buffer = ink::Image(VP_WIDTH, VP_HEIGHT, 1, 4);
+		double depth_ms = measure(REPEAT_COUNT, [&](int) -> void {
+			ink::soft::clear(buffer);
+			for (size_t i = 0; i < triangles.size(); i += 3) {
+				ink::soft::rasterize(state, triangles.data() + i, 3, buffer);
+			}
+		}, 1);
+		std::cout << name << ", depth, " << type_name << ": " << depth_ms << " ms";
+		
+		if (type == ink::soft::RASTERIZER_SCANLINE) {
+			scanline_ms = depth_ms;
+			scanline_covered = count_covered(buffer);
+			std::cout << '\n';
+			continue;
+		}
+		std::cout << " (" << scanline_ms / depth_ms << "x)\n";
+		
+		/* the tile rasterizers must write the same depths */
+		if (tile_result.data.empty()) tile_result = buffer;
+		expect_same(type_name, buffer.data, tile_result.data);
+		
+		/* the tiles cover the pixels of scanlines except on shared edges */
+		size_t covered = count_covered(buffer);
+		expect_near(type_name, covered, scanline_covered, scanline_covered * COVERAGE_TOLERANCE);
+	}
+}
+
+void run(const char* name, const ink::Scene& s, int t) {
+	ink::soft::Renderer renderer;
+	renderer.set_thread_count(t);
+	ink::Image image = ink::Image(VP_WIDTH, VP_HEIGHT, 4, 1);
+	
+	/* warm up the caches of textures */
+	double render_ms = measure(REPEAT_COUNT, [&](int) -> void {
+		renderer.render(s, camera, image);
+	}, 1);
+	std::cout << name << ", " << (t == 0 ? "all threads" : "1 thread") << ": " << render_ms << " ms\n";
+}
+
+int main(int argc, char** argv) {
+	load();
+	run_depth("Sphere", meshes["Sphere"]);
+	run_depth("Helmet", meshes["Helmet"]);
+	run("Sphere", sphere_scene, 1);
+	run("Sphere", sphere_scene, 0);
+	run("Helmet", helmet_scene, 1);
+	run("Helmet", helmet_scene, 0);
+	return 0;
+}
@@ -61,7 +61,7 @@ void load() {
 	
 	materials["Box_Red"] = ink::Material();
 	materials["Box_Red"].color = ink::Vec3(1, 0.5, 0.5);
-
+	
 	materials["Box_Wire"] = ink::Material();
 	materials["Box_Wire"].depth_test = false;
 	materials["Box_Wire"].blending = true;
@@ -90,10 +90,11 @@ void load() {
 		materials[name].shader = shader;
 		
 		instances[name] = new ink::Instance(name);
-		instances[name]->position.x = ink::Random::random_f() * 10 - 5;
-		instances[name]->position.y = ink::Random::random_f() * 10 - 5;
-		instances[name]->position.z = ink::Random::random_f() * 10 - 5;
-		instances[name]->mesh = &meshes["Box"];
+		float x = ink::Random::random_f() * 10 - 5;
+		float y = ink::Random::random_f() * 10 - 5;
+		float z = ink::Random::random_f() * 10 - 5;
+		instances[name]->set_position(ink::Vec3(x, y, z));
+		instances[name]->set_mesh(&meshes["Box"]);
 		
 		scene.add(instances[name]);
 		scene.set_material("default", *instances[name], &materials["Box_Red"]);
@@ -136,10 +137,11 @@ void load() {
 void update(float dt) {
 	for (int i = 0; i < 100; ++i) {
 		std::string name = "Box_" + std::to_string(i);
-		ink::Euler& rotation = instances[name]->rotation;
+		ink::Euler rotation = instances[name]->get_rotation();
 		rotation.x += objects[i].direction.x;
 		rotation.y += objects[i].direction.y;
 		rotation.z += objects[i].direction.z;
+		instances[name]->set_rotation(rotation);
 	}
 	
 	ink::Renderer::update_scene(scene);
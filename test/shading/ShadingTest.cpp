@@ -94,7 +94,7 @@ void load() {
 	scene.set_material("Material_MR", &materials["Material_MR"]);
 	
 	ink::Instance* helmet = new ink::Instance();
-	helmet->mesh = &meshes["Helmet"];
+	helmet->set_mesh(&meshes["Helmet"]);
 	scene.add(helmet);
 	
 	viewer = ink::Viewer(new ink::PerspCamera(75 * ink::DEG_TO_RAD, 1.77, 0.05, 1000));
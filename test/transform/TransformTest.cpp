@@ -0,0 +1,70 @@
+#include "ink/Ink.h"
+#include "test/Benchmark.h"
+
+#include <iostream>
+
+#define REPEAT_COUNT 20
+
+ink::Mesh box;
+
+void create_hierarchy(ink::Instance& p, int d, int c, std::vector<ink::Instance*>& o) {
+	if (d == 0) return;
+	for (int i = 0; i < c; ++i) {
+		ink::Instance* instance = new ink::Instance();
+		float x = ink::Random::random_f() * 2 - 1;
+		float y = ink::Random::random_f() * 2 - 1;
+		float z = ink::Random::random_f() * 2 - 1;
+		instance->set_position(ink::Vec3(x, y, z));
+		instance->set_mesh(&box);
+		p.add(instance);
+		o.emplace_back(instance);
+		create_hierarchy(*instance, d - 1, c, o);
+	}
+}
+
+void rotate(ink::Instance& i) {
+	ink::Euler rotation = i.get_rotation();
+	rotation.y += 0.01;
+	i.set_rotation(rotation);
+}
+
+void run(int d, int c, bool f) {
+	ink::Scene scene;
+	scene.set_flat_transforms(f);
+	std::vector<ink::Instance*> instances;
+	create_hierarchy(scene, d, c, instances);
+	scene.update_instances();
+	
+	/* update the hierarchies without changes */
+	double still_ms = measure(REPEAT_COUNT, [&](int) -> void {
+		scene.update_instances();
+	});
+	
+	/* change the transforms of the top level instances */
+	double root_ms = measure(REPEAT_COUNT, [&](int) -> void {
+		for (int i = 0; i < c; ++i) rotate(*scene.get_child(i));
+		scene.update_instances();
+	});
+	
+	/* change the transforms of all the instances */
+	double all_ms = measure(REPEAT_COUNT, [&](int) -> void {
+		for (auto* instance : instances) rotate(*instance);
+		scene.update_instances();
+	});
+	
+	std::cout << "Instances: " << instances.size() << ", depth: " << d;
+	std::cout << (f ? ", flat transforms\n" : ", pointer hierarchies\n");
+	std::cout << "  Still: " << still_ms << " ms\n";
+	std::cout << "  Roots moved: " << root_ms << " ms\n";
+	std::cout << "  All moved: " << all_ms << " ms\n";
+	for (auto* instance : instances) delete instance;
+}
+
+int main(int argc, char** argv) {
+	box = ink::BoxMesh::create();
+	run(5, 10, false);
+	run(5, 10, true);
+	run(17, 2, false);
+	run(17, 2, true);
+	return 0;
+}